@@ -0,0 +1,44 @@
+/*******************************************************************************************
+*
+*   tetris42 - board state capture
+*
+*   Plain copy of everything on screen for one board, taken once per tick and handed to
+*   other processes: no pointers, fixed sizes, the same layout on both sides.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef BOARDSTATE_H
+#define BOARDSTATE_H
+
+#include "tetris42.h"
+#include "pieces.h"
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define BOARD_NAME_SIZE         20
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct BoardState {
+    unsigned int tick;                                          // Game frame the state was taken at
+    int lines;
+    int level;
+    unsigned char gameOver;
+    unsigned char paused;
+    signed char pieceType;                                      // -1 without a falling piece
+    signed char pieceRotation;
+    signed char pieceX;                                         // Piece bounding box on the grid
+    signed char pieceY;
+    signed char incomingType;                                   // -1 before the first piece
+    unsigned char incomingSize;                                 // Incoming piece box side
+    unsigned short incomingRows[PIECE_MAX_SIZE];                // Incoming squares, bit i is column i
+    unsigned long long hash;                                    // Zobrist hash of the position
+    char name[BOARD_NAME_SIZE];
+    unsigned char grid[GRID_VERTICAL_SIZE][GRID_HORIZONTAL_SIZE];   // GridSquare by row, then column
+} BoardState;
+
+#endif // BOARDSTATE_H
@@ -0,0 +1,175 @@
+/*******************************************************************************************
+*
+*   tetris42 - placement search
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "bot.h"
+
+#include <stdlib.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+// Weights of the score terms, lines are added per placement
+#define WEIGHT_LINES            760
+#define WEIGHT_HEIGHT           510
+#define WEIGHT_HOLES            356
+#define WEIGHT_BUMPINESS        184
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct Search {
+    const PieceSet *set;
+    PositionCache *cache;
+    BotAbort abort;
+    void *data;
+    bool aborted;
+} Search;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static int PlacementScore(Search *search, const Board *board, PiecePosition position, const int *queue, int depth);
+static int BestScore(Search *search, const Board *board, const int *queue, int depth);
+static int AverageScore(Search *search, const Board *board, const int *queue, int depth);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// Score of the stack, higher is better
+int EvaluateBoard(const Board *board)
+{
+    if (IsBoardOver(board)) return BOT_LOST;
+
+    int height[GRID_HORIZONTAL_SIZE] = { 0 };
+    int totalHeight = 0;
+    int holes = 0;
+    int bumpiness = 0;
+
+    for (int i = 1; i < GRID_HORIZONTAL_SIZE - 1; i++)
+    {
+        int j = 0;
+
+        while ((j < BOARD_PLAYABLE_ROWS) && !(board->rows[j] & (1u << i))) j++;
+
+        height[i] = BOARD_PLAYABLE_ROWS - j;
+        totalHeight += height[i];
+
+        for (j++; j < BOARD_PLAYABLE_ROWS; j++)
+        {
+            if (!(board->rows[j] & (1u << i))) holes++;
+        }
+
+        if (i > 1) bumpiness += abs(height[i] - height[i - 1]);
+    }
+
+    return -WEIGHT_HEIGHT*totalHeight - WEIGHT_HOLES*holes - WEIGHT_BUMPINESS*bumpiness;
+}
+
+// Search placements of queue[0] from start, queue holds depth piece types, cache may be NULL
+bool SearchPlacement(const PieceSet *set, PositionCache *cache, const Board *board, PiecePosition start,
+                     const int *queue, int depth, BotAbort abort, void *data, Placement *best)
+{
+    Search search = { set, cache, abort, data, false };
+    Placement placements[MAX_PLACEMENTS];
+    int count = GetPlacements(set, board, start, placements);
+    int bestScore = 0;
+
+    for (int p = 0; p < count; p++)
+    {
+        if ((abort != NULL) && abort(data)) return false;
+
+        int score = PlacementScore(&search, board, placements[p].position, queue + 1, depth - 1);
+
+        if (search.aborted) return false;
+
+        if ((p == 0) || (score > bestScore))
+        {
+            bestScore = score;
+            *best = placements[p];
+        }
+    }
+
+    return (count > 0);
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+// Lock the piece, then score the stack or the best of the pieces to come
+static int PlacementScore(Search *search, const Board *board, PiecePosition position, const int *queue, int depth)
+{
+    Board child = *board;
+    int lines = LockPiece(search->set, &child, position);
+
+    if (IsBoardOver(&child)) return BOT_LOST;
+    if (depth == 0) return WEIGHT_LINES*lines + EvaluateBoard(&child);
+
+    int score = (queue[0] == BOT_ANY_PIECE)? AverageScore(search, &child, queue, depth) : BestScore(search, &child, queue, depth);
+
+    return (score == BOT_LOST)? BOT_LOST : WEIGHT_LINES*lines + score;
+}
+
+// Best score of queue[0] on the board, the same board and queue always have the same score
+static int BestScore(Search *search, const Board *board, const int *queue, int depth)
+{
+    unsigned long long key = board->hash;
+    unsigned long long data = 0;
+    bool cached = (search->cache != NULL);
+
+    for (int q = 0; q < depth; q++)
+    {
+        if (queue[q] == BOT_ANY_PIECE) cached = false;
+        else key ^= HashQueue(q, queue[q]);
+    }
+
+    if (cached && ProbePosition(search->cache, key, &data) && ((int)(data & 0xff) == depth)) return (int)(unsigned int)(data >> 8);
+
+    Board spawned = *board;
+    Placement placements[MAX_PLACEMENTS];
+    int count = GetPlacements(search->set, &spawned, SpawnPiece(search->set, &spawned, queue[0]), placements);
+    int bestScore = BOT_LOST;
+
+    for (int p = 0; p < count; p++)
+    {
+        if ((depth > 1) && (search->abort != NULL) && search->abort(search->data)) search->aborted = true;
+        if (search->aborted) return BOT_LOST;
+
+        int score = PlacementScore(search, &spawned, placements[p].position, queue + 1, depth - 1);
+
+        if (score > bestScore) bestScore = score;
+    }
+
+    if (cached) StorePosition(search->cache, key, ((unsigned long long)(unsigned int)bestScore << 8) | depth);
+
+    return bestScore;
+}
+
+// Average best score over the first piece tier, by piece weights
+static int AverageScore(Search *search, const Board *board, const int *queue, int depth)
+{
+    const PieceTier *tier = &search->set->tier[0];
+    int next[BOT_MAX_DEPTH];
+    long long total = 0;
+
+    for (int q = 0; q < depth; q++) next[q] = queue[q];
+
+    for (int t = 0; t < tier->end; t++)
+    {
+        int weight = search->set->cumulativeWeight[t] - ((t > 0)? search->set->cumulativeWeight[t - 1] : 0);
+
+        next[0] = t;
+
+        int score = BestScore(search, board, next, depth);
+
+        if (search->aborted) return BOT_LOST;
+
+        total += (long long)weight*score;
+    }
+
+    return (int)(total/tier->totalWeight);
+}
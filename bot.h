@@ -0,0 +1,43 @@
+/*******************************************************************************************
+*
+*   tetris42 - placement search
+*
+*   Scores a board by its lines, heights, holes and bumpiness and looks for the placement
+*   of the current piece with the best score after the queued pieces are placed too. Pieces
+*   not drawn yet are averaged over the first piece tier. Searches can be aborted between
+*   placements, so deeper searches can be run one after another while time allows.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef BOT_H
+#define BOT_H
+
+#include "engine.h"
+#include "zobrist.h"
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define BOT_MAX_DEPTH           3
+#define BOT_ANY_PIECE           -1              // Queue entry of a piece not drawn yet
+#define BOT_LOST                -1000000000     // Score of a board with the game over
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef bool (*BotAbort)(void *data);           // Return true to stop the search
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+int EvaluateBoard(const Board *board);          // Score of the stack, higher is better
+
+// Search placements of queue[0] from start, queue holds depth piece types, cache may be NULL
+bool SearchPlacement(const PieceSet *set, PositionCache *cache, const Board *board, PiecePosition start,
+                     const int *queue, int depth, BotAbort abort, void *data, Placement *best);
+
+#endif // BOT_H
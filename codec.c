@@ -0,0 +1,150 @@
+/*******************************************************************************************
+*
+*   tetris42 - compact byte encoding
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "codec.h"
+
+#include <string.h>
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+void PutByte(CodecWriter *writer, unsigned int value)
+{
+    if (writer->size >= writer->capacity)
+    {
+        writer->overflow = true;
+        return;
+    }
+
+    writer->data[writer->size++] = (unsigned char)value;
+}
+
+void PutBytes(CodecWriter *writer, const void *bytes, int count)
+{
+    if (writer->size + count > writer->capacity)
+    {
+        writer->overflow = true;
+        return;
+    }
+
+    memcpy(writer->data + writer->size, bytes, count);
+    writer->size += count;
+}
+
+void PutVarint(CodecWriter *writer, unsigned long long value)
+{
+    while (value >= 0x80)
+    {
+        PutByte(writer, (value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+
+    PutByte(writer, (unsigned int)value);
+}
+
+// Zigzag varint, small magnitudes stay short
+void PutSigned(CodecWriter *writer, long long value)
+{
+    PutVarint(writer, ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63));
+}
+
+// Little endian, for headers read in place
+void PutFixed(CodecWriter *writer, unsigned long long value, int bytes)
+{
+    for (int b = 0; b < bytes; b++) PutByte(writer, (unsigned int)(value >> 8*b) & 0xff);
+}
+
+// Changed rows only: rows skipped, XOR bits, ..., rows left
+void PutXorRows(CodecWriter *writer, const unsigned short *rows, const unsigned short *base, int count)
+{
+    int position = 0;
+
+    for (int j = 0; j < count; j++)
+    {
+        if (rows[j] == base[j]) continue;
+
+        PutVarint(writer, j - position);
+        PutVarint(writer, rows[j] ^ base[j]);
+        position = j + 1;
+    }
+
+    PutVarint(writer, count - position);
+}
+
+unsigned int GetByte(CodecReader *reader)
+{
+    if (reader->position >= reader->size)
+    {
+        reader->error = true;
+        return 0;
+    }
+
+    return reader->data[reader->position++];
+}
+
+void GetBytes(CodecReader *reader, void *bytes, int count)
+{
+    if ((count < 0) || (reader->position + count > reader->size))
+    {
+        reader->error = true;
+        memset(bytes, 0, (count > 0)? count : 0);
+        return;
+    }
+
+    memcpy(bytes, reader->data + reader->position, count);
+    reader->position += count;
+}
+
+unsigned long long GetVarint(CodecReader *reader)
+{
+    unsigned long long value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        unsigned int byte = GetByte(reader);
+
+        value |= (unsigned long long)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return reader->error? 0 : value;
+    }
+
+    reader->error = true;       // More than ten bytes
+
+    return 0;
+}
+
+long long GetSigned(CodecReader *reader)
+{
+    unsigned long long value = GetVarint(reader);
+
+    return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+unsigned long long GetFixed(CodecReader *reader, int bytes)
+{
+    unsigned long long value = 0;
+
+    for (int b = 0; b < bytes; b++) value |= (unsigned long long)GetByte(reader) << 8*b;
+
+    return value;
+}
+
+void GetXorRows(CodecReader *reader, unsigned short *rows, const unsigned short *base, int count)
+{
+    if (rows != base) memcpy(rows, base, count*sizeof(unsigned short));
+
+    int position = 0;
+
+    while (!reader->error)
+    {
+        unsigned long long skip = GetVarint(reader);
+
+        if (skip > (unsigned long long)(count - position)) reader->error = true;
+        else if ((position += (int)skip) == count) return;
+        else rows[position++] ^= (unsigned short)GetVarint(reader);
+    }
+}
@@ -0,0 +1,56 @@
+/*******************************************************************************************
+*
+*   tetris42 - compact byte encoding
+*
+*   Unsigned values are written as varints, 7 bits per byte with the top bit telling that
+*   more bytes follow. Board rows are written as XOR against a base (the previous rows or
+*   an empty well), as pairs of unchanged row count and changed bits closed by the count
+*   of rows left, so a frame where one row changed costs three or four bytes.
+*
+*   Writers and readers work on caller owned buffers and keep a sticky error flag instead
+*   of returning status from every call: check it once after a record.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct CodecWriter {
+    unsigned char *data;
+    int size;
+    int capacity;
+    bool overflow;              // Something did not fit, size stops growing
+} CodecWriter;
+
+typedef struct CodecReader {
+    const unsigned char *data;
+    int size;
+    int position;
+    bool error;                 // Read past the end or a malformed value, reads return 0
+} CodecReader;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+void PutByte(CodecWriter *writer, unsigned int value);
+void PutBytes(CodecWriter *writer, const void *bytes, int count);
+void PutVarint(CodecWriter *writer, unsigned long long value);
+void PutSigned(CodecWriter *writer, long long value);           // Zigzag varint, small magnitudes stay short
+void PutFixed(CodecWriter *writer, unsigned long long value, int bytes);  // Little endian, for headers read in place
+void PutXorRows(CodecWriter *writer, const unsigned short *rows, const unsigned short *base, int count);
+
+unsigned int GetByte(CodecReader *reader);
+void GetBytes(CodecReader *reader, void *bytes, int count);
+unsigned long long GetVarint(CodecReader *reader);
+long long GetSigned(CodecReader *reader);
+unsigned long long GetFixed(CodecReader *reader, int bytes);
+void GetXorRows(CodecReader *reader, unsigned short *rows, const unsigned short *base, int count);
+
+#endif // CODEC_H
@@ -0,0 +1,374 @@
+/*******************************************************************************************
+*
+*   tetris42 - self-play dataset
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "dataset.h"
+#include "codec.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static void GetBoardRows(const unsigned char *bits, unsigned short *rows);
+static void SetBoardRows(const unsigned short *rows, unsigned char *bits);
+static long long GetColumnValue(const DatasetRecord *record, int column);
+static void SetColumnValue(DatasetRecord *record, int column, long long value);
+static int GetColumnRuns(const DatasetRecord *records, int count, int column);
+static long long GetDifference(long long value, long long previous);
+static unsigned long long GetPayloadChecksum(const unsigned char *data, int size);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+void PackDatasetBoard(const Board *board, unsigned char *bits)
+{
+    unsigned short rows[DATASET_BOARD_ROWS];
+
+    for (int j = 0; j < DATASET_BOARD_ROWS; j++) rows[j] = (board->rows[j] >> 1) & ((1u << DATASET_BOARD_COLUMNS) - 1);
+
+    SetBoardRows(rows, bits);
+}
+
+// Hash is not set
+void UnpackDatasetBoard(const unsigned char *bits, Board *board)
+{
+    unsigned short rows[DATASET_BOARD_ROWS];
+
+    GetBoardRows(bits, rows);
+    InitBoard(board);
+
+    for (int j = 0; j < DATASET_BOARD_ROWS; j++) board->rows[j] |= rows[j] << 1;
+}
+
+bool WriteDatasetHeader(FILE *file, const DatasetHeader *header)
+{
+    unsigned char data[DATASET_HEADER + DATASET_PIECES_SIZE];
+    CodecWriter writer = { data, 0, sizeof(data), false };
+    int length = (int)strlen(header->pieces);
+
+    PutFixed(&writer, DATASET_MAGIC, 4);
+    PutFixed(&writer, DATASET_VERSION, 4);
+    PutFixed(&writer, header->players, 4);
+    PutFixed(&writer, header->depth, 4);
+    PutFixed(&writer, header->maxPieces, 4);
+    PutFixed(&writer, header->firstSeed, 8);
+    PutFixed(&writer, header->endSeed, 8);
+    PutFixed(&writer, length, 4);
+    PutBytes(&writer, header->pieces, length);
+
+    return !writer.overflow && (fwrite(data, 1, writer.size, file) == (size_t)writer.size);
+}
+
+bool ReadDatasetHeader(FILE *file, DatasetHeader *header)
+{
+    unsigned char data[DATASET_HEADER];
+    CodecReader reader = { data, DATASET_HEADER, 0, false };
+
+    if (fread(data, 1, DATASET_HEADER, file) != DATASET_HEADER) return false;
+    if ((GetFixed(&reader, 4) != DATASET_MAGIC) || (GetFixed(&reader, 4) != DATASET_VERSION)) return false;
+
+    header->players = (int)GetFixed(&reader, 4);
+    header->depth = (int)GetFixed(&reader, 4);
+    header->maxPieces = (int)GetFixed(&reader, 4);
+    header->firstSeed = GetFixed(&reader, 8);
+    header->endSeed = GetFixed(&reader, 8);
+
+    unsigned int length = (unsigned int)GetFixed(&reader, 4);
+
+    if (length >= DATASET_PIECES_SIZE) return false;
+    if (fread(header->pieces, 1, length, file) != length) return false;
+    header->pieces[length] = '\0';
+
+    return true;
+}
+
+// Encode into buffer, of DATASET_CHUNK_SIZE(count) bytes, and write
+bool WriteDatasetChunk(FILE *file, const DatasetRecord *records, int count, unsigned long long firstSeed,
+                       unsigned long long nextSeed, unsigned char *buffer)
+{
+    CodecWriter writer = { buffer, DATASET_CHUNK_HEADER, DATASET_CHUNK_SIZE(count), false };
+
+    for (int c = 0; c < DATASET_COLUMNS; c++)
+    {
+        int sizeAt = writer.size;
+
+        PutFixed(&writer, 0, 4);
+
+        if (c == DATASET_BOARD)
+        {
+            unsigned short base[DATASET_BOARD_ROWS] = { 0 };
+            unsigned short rows[DATASET_BOARD_ROWS];
+
+            PutByte(&writer, DATASET_XOR_ROWS);
+
+            for (int r = 0; r < count; r++)
+            {
+                GetBoardRows(records[r].board, rows);
+                PutXorRows(&writer, rows, base, DATASET_BOARD_ROWS);
+                memcpy(base, rows, sizeof(base));
+            }
+        }
+        else
+        {
+            int encoding = (2*GetColumnRuns(records, count, c) <= count)? DATASET_RUNS : DATASET_DELTAS;
+            long long previous = 0;
+
+            PutByte(&writer, encoding);
+
+            for (int r = 0; r < count; r++)
+            {
+                long long value = GetColumnValue(&records[r], c);
+                long long difference = GetDifference(value, previous);
+                int repeats = 0;
+
+                PutSigned(&writer, difference);
+                previous = value;
+
+                if (encoding == DATASET_DELTAS) continue;
+
+                while ((r + 1 < count) && (GetDifference(GetColumnValue(&records[r + 1], c), previous) == difference))
+                {
+                    previous = GetColumnValue(&records[++r], c);
+                    repeats++;
+                }
+
+                PutVarint(&writer, repeats);
+            }
+        }
+
+        CodecWriter size = { buffer + sizeAt, 0, 4, false };
+
+        PutFixed(&size, writer.size - sizeAt - 4, 4);
+    }
+
+    if (writer.overflow) return false;
+
+    int payloadSize = writer.size - DATASET_CHUNK_HEADER;
+    CodecWriter header = { buffer, 0, DATASET_CHUNK_HEADER, false };
+
+    PutFixed(&header, DATASET_CHUNK_MAGIC, 4);
+    PutFixed(&header, count, 4);
+    PutFixed(&header, payloadSize, 4);
+    PutFixed(&header, firstSeed, 8);
+    PutFixed(&header, nextSeed, 8);
+    PutFixed(&header, GetPayloadChecksum(buffer + DATASET_CHUNK_HEADER, payloadSize), 8);
+
+    return (fwrite(buffer, 1, writer.size, file) == (size_t)writer.size);
+}
+
+// 1 read, 0 end of file, -1 cut short or corrupt
+int ReadDatasetChunk(FILE *file, DatasetChunk *chunk)
+{
+    unsigned char data[DATASET_CHUNK_HEADER];
+    CodecReader header = { data, DATASET_CHUNK_HEADER, 0, false };
+    size_t read = fread(data, 1, DATASET_CHUNK_HEADER, file);
+
+    if (read == 0) return feof(file)? 0 : -1;
+    if (read != DATASET_CHUNK_HEADER) return -1;
+    if (GetFixed(&header, 4) != DATASET_CHUNK_MAGIC) return -1;
+
+    unsigned int count = (unsigned int)GetFixed(&header, 4);
+    unsigned int payloadSize = (unsigned int)GetFixed(&header, 4);
+
+    chunk->firstSeed = GetFixed(&header, 8);
+    chunk->nextSeed = GetFixed(&header, 8);
+
+    unsigned long long checksum = GetFixed(&header, 8);
+
+    if ((count > (1u << 24)) || (payloadSize > (unsigned int)DATASET_CHUNK_SIZE(count))) return -1;
+
+    if ((int)payloadSize > chunk->dataCapacity)
+    {
+        unsigned char *grown = (unsigned char *)realloc(chunk->data, payloadSize);
+
+        if (grown == NULL) return -1;
+        chunk->data = grown;
+        chunk->dataCapacity = payloadSize;
+    }
+
+    if ((int)count > chunk->capacity)
+    {
+        DatasetRecord *grown = (DatasetRecord *)realloc(chunk->records, count*sizeof(DatasetRecord));
+
+        if (grown == NULL) return -1;
+        chunk->records = grown;
+        chunk->capacity = count;
+    }
+
+    if (fread(chunk->data, 1, payloadSize, file) != payloadSize) return -1;
+    if (GetPayloadChecksum(chunk->data, payloadSize) != checksum) return -1;
+
+    memset(chunk->records, 0, count*sizeof(DatasetRecord));
+    chunk->count = count;
+
+    CodecReader payload = { chunk->data, payloadSize, 0, false };
+
+    for (int c = 0; c < DATASET_COLUMNS; c++)
+    {
+        int size = (int)GetFixed(&payload, 4);
+
+        if (payload.error || (size < 0) || (size > payload.size - payload.position)) return -1;
+
+        CodecReader reader = { payload.data + payload.position, size, 0, false };
+        unsigned int encoding = GetByte(&reader);
+
+        if ((c == DATASET_BOARD) != (encoding == DATASET_XOR_ROWS)) return -1;
+
+        if (c == DATASET_BOARD)
+        {
+            unsigned short rows[DATASET_BOARD_ROWS] = { 0 };
+
+            for (unsigned int r = 0; r < count; r++)
+            {
+                GetXorRows(&reader, rows, rows, DATASET_BOARD_ROWS);
+                SetBoardRows(rows, chunk->records[r].board);
+            }
+        }
+        else
+        {
+            long long value = 0;
+
+            for (unsigned int r = 0; (r < count) && !reader.error; )
+            {
+                long long difference = GetSigned(&reader);
+                unsigned long long repeats = (encoding == DATASET_RUNS)? GetVarint(&reader) : 0;
+
+                if (repeats >= count - r) return -1;
+
+                for (unsigned long long k = 0; k <= repeats; k++, r++)
+                {
+                    value = (long long)((unsigned long long)value + (unsigned long long)difference);
+                    SetColumnValue(&chunk->records[r], c, value);
+                }
+            }
+        }
+
+        if (reader.error || (reader.position != size)) return -1;
+        payload.position += size;
+    }
+
+    return 1;
+}
+
+void UnloadDatasetChunk(DatasetChunk *chunk)
+{
+    free(chunk->records);
+    free(chunk->data);
+    memset(chunk, 0, sizeof(DatasetChunk));
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static void GetBoardRows(const unsigned char *bits, unsigned short *rows)
+{
+    for (int j = 0; j < DATASET_BOARD_ROWS; j++)
+    {
+        rows[j] = 0;
+
+        for (int i = 0; i < DATASET_BOARD_COLUMNS; i++)
+        {
+            int bit = j*DATASET_BOARD_COLUMNS + i;
+
+            if (bits[bit/8] & (1u << (bit%8))) rows[j] |= 1u << i;
+        }
+    }
+}
+
+static void SetBoardRows(const unsigned short *rows, unsigned char *bits)
+{
+    memset(bits, 0, DATASET_BOARD_BYTES);
+
+    for (int j = 0; j < DATASET_BOARD_ROWS; j++)
+    {
+        for (int i = 0; i < DATASET_BOARD_COLUMNS; i++)
+        {
+            int bit = j*DATASET_BOARD_COLUMNS + i;
+
+            if (rows[j] & (1u << i)) bits[bit/8] |= 1u << (bit%8);
+        }
+    }
+}
+
+static long long GetColumnValue(const DatasetRecord *record, int column)
+{
+    switch (column)
+    {
+        case DATASET_SEED: return (long long)record->seed;
+        case DATASET_PLAYER: return record->player;
+        case DATASET_MOVE: return record->move;
+        case DATASET_PIECE: return record->piece;
+        case DATASET_INCOMING: return record->incoming;
+        case DATASET_ROTATION: return record->rotation;
+        case DATASET_X: return record->x;
+        case DATASET_Y: return record->y;
+        case DATASET_LINES: return record->lines;
+        case DATASET_TOTAL_LINES: return record->totalLines;
+        case DATASET_TOTAL_MOVES: return record->totalMoves;
+        case DATASET_WON: return record->won;
+        case DATASET_TOP_OUT: return record->topOut;
+        default: return 0;
+    }
+}
+
+static void SetColumnValue(DatasetRecord *record, int column, long long value)
+{
+    switch (column)
+    {
+        case DATASET_SEED: record->seed = (unsigned long long)value; break;
+        case DATASET_PLAYER: record->player = (unsigned char)value; break;
+        case DATASET_MOVE: record->move = (unsigned int)value; break;
+        case DATASET_PIECE: record->piece = (unsigned char)value; break;
+        case DATASET_INCOMING: record->incoming = (unsigned char)value; break;
+        case DATASET_ROTATION: record->rotation = (unsigned char)value; break;
+        case DATASET_X: record->x = (signed char)value; break;
+        case DATASET_Y: record->y = (signed char)value; break;
+        case DATASET_LINES: record->lines = (unsigned char)value; break;
+        case DATASET_TOTAL_LINES: record->totalLines = (unsigned int)value; break;
+        case DATASET_TOTAL_MOVES: record->totalMoves = (unsigned int)value; break;
+        case DATASET_WON: record->won = (unsigned char)value; break;
+        case DATASET_TOP_OUT: record->topOut = (unsigned char)value; break;
+        default: break;
+    }
+}
+
+// Runs of equal differences, a column with few of them is written as runs
+static int GetColumnRuns(const DatasetRecord *records, int count, int column)
+{
+    long long previous = 0;
+    long long difference = 0;
+    int runs = 0;
+
+    for (int r = 0; r < count; r++)
+    {
+        long long value = GetColumnValue(&records[r], column);
+
+        if ((r == 0) || (GetDifference(value, previous) != difference)) runs++;
+        difference = GetDifference(value, previous);
+        previous = value;
+    }
+
+    return runs;
+}
+
+// Wraps around, seeds use all 64 bits
+static long long GetDifference(long long value, long long previous)
+{
+    return (long long)((unsigned long long)value - (unsigned long long)previous);
+}
+
+// FNV-1a
+static unsigned long long GetPayloadChecksum(const unsigned char *data, int size)
+{
+    unsigned long long hash = 0xcbf29ce484222325ull;
+
+    for (int i = 0; i < size; i++) hash = (hash ^ data[i])*0x100000001b3ull;
+
+    return hash;
+}
@@ -0,0 +1,132 @@
+/*******************************************************************************************
+*
+*   tetris42 - self-play dataset
+*
+*   Positions of bot games for training placement models: the board when a piece spawns,
+*   the current and incoming piece, the placement the bot chose and how the game ended.
+*   A dataset file starts with a header (settings and piece set definition) followed by
+*   chunks of whole matches, so a file cut short loses at most its last chunk.
+*
+*   Chunks are columnar: every column is written for all records of the chunk before the
+*   next one, each preceded by its size so readers can skip columns. Boards are 10 bits per
+*   row XORed against the previous record (PutXorRows), other columns are zigzag varints of
+*   the difference to the previous record, as runs of equal differences for columns that
+*   rarely change (seed, outcome). Readers get fixed-width DatasetRecord rows back.
+*
+*   File header     magic, version, players, depth, max pieces, first seed, end seed,
+*                   piece set text size, piece set text
+*   Chunk header    magic, records, payload size, first seed, next seed, payload checksum
+*   Chunk payload   per column: size, encoding, values
+*
+*   Fixed fields are little endian (PutFixed), chunk headers are DATASET_CHUNK_HEADER bytes.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef DATASET_H
+#define DATASET_H
+
+#include "engine.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define DATASET_MAGIC           0x44323454u     // "T42D"
+#define DATASET_CHUNK_MAGIC     0x43323454u     // "T42C"
+#define DATASET_VERSION         1
+#define DATASET_HEADER          40              // Before the piece set text
+#define DATASET_CHUNK_HEADER    36
+#define DATASET_PIECES_SIZE     8192            // Largest piece set definition text
+
+// Column encodings
+#define DATASET_XOR_ROWS        0               // Boards
+#define DATASET_DELTAS          1               // Difference per record
+#define DATASET_RUNS            2               // Difference, records after it with the same difference
+
+// Playable squares only, walls and floor are left out
+#define DATASET_BOARD_COLUMNS   (GRID_HORIZONTAL_SIZE - 2)
+#define DATASET_BOARD_ROWS      BOARD_PLAYABLE_ROWS
+#define DATASET_BOARD_BYTES     ((DATASET_BOARD_COLUMNS*DATASET_BOARD_ROWS + 7)/8)
+
+#define DATASET_RECORD_SIZE     128             // Largest encoded record
+#define DATASET_CHUNK_SIZE(records) (DATASET_CHUNK_HEADER + DATASET_COLUMNS*5 + (records)*DATASET_RECORD_SIZE)
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+// Columns in the order they are written
+typedef enum {
+    DATASET_SEED = 0,
+    DATASET_PLAYER,
+    DATASET_MOVE,
+    DATASET_BOARD,
+    DATASET_PIECE,
+    DATASET_INCOMING,
+    DATASET_ROTATION,
+    DATASET_X,
+    DATASET_Y,
+    DATASET_LINES,
+    DATASET_TOTAL_LINES,
+    DATASET_TOTAL_MOVES,
+    DATASET_WON,
+    DATASET_TOP_OUT,
+    DATASET_COLUMNS
+} DatasetColumn;
+
+typedef struct DatasetRecord {
+    unsigned long long seed;                    // Of the match
+    unsigned char board[DATASET_BOARD_BYTES];   // Bit i + 10*j is column i of row j from the top
+    unsigned char player;                       // Board of the match
+    unsigned char piece;                        // Current piece type
+    unsigned char incoming;                     // Incoming piece type
+    unsigned char rotation;                     // Chosen placement, box position like PiecePosition
+    signed char x;
+    signed char y;
+    unsigned char lines;                        // Deleted by this placement
+    unsigned char won;                          // Board ended with the most lines of the match, ties win
+    unsigned char topOut;                       // Board ended full, not at the piece limit
+    unsigned int move;                          // Placements before this one
+    unsigned int totalLines;                    // Lines of the board at the end
+    unsigned int totalMoves;                    // Placements of the board
+} DatasetRecord;
+
+typedef struct DatasetHeader {
+    int players;
+    int depth;                                  // Bot search depth
+    int maxPieces;                              // Placements per board before a match stops
+    unsigned long long firstSeed;               // Seeds of the file, end excluded
+    unsigned long long endSeed;
+    char pieces[DATASET_PIECES_SIZE];           // Piece set definition text
+} DatasetHeader;
+
+// Reader side chunk, buffers grow to the largest chunk read
+typedef struct DatasetChunk {
+    unsigned long long firstSeed;
+    unsigned long long nextSeed;                // First seed of the next chunk
+    int count;
+    DatasetRecord *records;
+    int capacity;
+    unsigned char *data;
+    int dataCapacity;
+} DatasetChunk;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+void PackDatasetBoard(const Board *board, unsigned char *bits);
+void UnpackDatasetBoard(const unsigned char *bits, Board *board);   // Hash is not set
+
+bool WriteDatasetHeader(FILE *file, const DatasetHeader *header);
+bool ReadDatasetHeader(FILE *file, DatasetHeader *header);
+
+// Encode into buffer, of DATASET_CHUNK_SIZE(count) bytes, and write
+bool WriteDatasetChunk(FILE *file, const DatasetRecord *records, int count, unsigned long long firstSeed,
+                       unsigned long long nextSeed, unsigned char *buffer);
+int ReadDatasetChunk(FILE *file, DatasetChunk *chunk);     // 1 read, 0 end of file, -1 cut short or corrupt
+void UnloadDatasetChunk(DatasetChunk *chunk);
+
+#endif // DATASET_H
@@ -0,0 +1,192 @@
+/*******************************************************************************************
+*
+*   tetris42 - compact board engine
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "engine.h"
+#include "zobrist.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static inline unsigned int ShiftRow(unsigned int mask, int x);
+static void GetPlacement(const PieceSet *set, PiecePosition position, Placement *placement);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// Empty grid with walls and floor, same as InitGame()
+void InitBoard(Board *board)
+{
+    for (int j = 0; j < GRID_VERTICAL_SIZE - 1; j++) board->rows[j] = BOARD_WALLS;
+
+    board->rows[GRID_VERTICAL_SIZE - 1] = BOARD_FULL_ROW;
+    board->hash = 0;
+}
+
+// Check piece squares are inside the grid and over empty squares only
+bool PieceFits(const PieceSet *set, const Board *board, PiecePosition position)
+{
+    const PieceRotation *rotation = &set->type[position.type].rotation[position.rotation];
+
+    if ((position.x + rotation->minX < 0) || (position.x + rotation->maxX >= GRID_HORIZONTAL_SIZE) ||
+        (position.y + rotation->minY < 0) || (position.y + rotation->maxY >= GRID_VERTICAL_SIZE)) return false;
+
+    for (int j = rotation->minY; j <= rotation->maxY; j++)
+    {
+        if (board->rows[position.y + j] & ShiftRow(rotation->rowMask[j], position.x)) return false;
+    }
+
+    return true;
+}
+
+// Place new piece like Createpiece(), full squares under the new piece are lost as in the game
+PiecePosition SpawnPiece(const PieceSet *set, Board *board, int type)
+{
+    PiecePosition position = { type, 0, (GRID_HORIZONTAL_SIZE - set->type[type].size)/2, 0 };
+    const PieceRotation *rotation = &set->type[type].rotation[0];
+
+    for (int j = rotation->minY; j <= rotation->maxY; j++)
+    {
+        board->hash ^= HashRow(j, board->rows[j]);
+        board->rows[j] &= ~ShiftRow(rotation->rowMask[j], position.x);
+        board->hash ^= HashRow(j, board->rows[j]);
+    }
+
+    return position;
+}
+
+// Lock piece and delete completed lines, returns deleted lines
+int LockPiece(const PieceSet *set, Board *board, PiecePosition position)
+{
+    const PieceRotation *rotation = &set->type[position.type].rotation[position.rotation];
+    int deletedLines = 0;
+
+    for (int j = rotation->minY; j <= rotation->maxY; j++)
+    {
+        board->hash ^= HashRow(position.y + j, board->rows[position.y + j]);
+        board->rows[position.y + j] |= ShiftRow(rotation->rowMask[j], position.x);
+        board->hash ^= HashRow(position.y + j, board->rows[position.y + j]);
+    }
+
+    // Pull down the lines above every completed line, rows below keep their keys
+    int target = BOARD_PLAYABLE_ROWS - 1;
+
+    for (int j = BOARD_PLAYABLE_ROWS - 1; j >= 0; j--)
+    {
+        if (board->rows[j] == BOARD_FULL_ROW)
+        {
+            board->hash ^= HashRow(j, board->rows[j]);
+            deletedLines++;
+        }
+        else
+        {
+            if (target != j) board->hash ^= HashRow(j, board->rows[j]) ^ HashRow(target, board->rows[j]);
+            board->rows[target--] = board->rows[j];
+        }
+    }
+
+    while (target >= 0) board->rows[target--] = BOARD_WALLS;
+
+    return deletedLines;
+}
+
+// Game over when full squares reach the top rows, same as UpdateGame()
+bool IsBoardOver(const Board *board)
+{
+    return ((board->rows[0] | board->rows[1]) & ~BOARD_WALLS) != 0;
+}
+
+// Get all distinct final placements reachable from start with lateral moves, turns and gravity
+int GetPlacements(const PieceSet *set, const Board *board, PiecePosition start, Placement *placements)
+{
+    static const int moveX[3] = { -1, 1, 0 };
+    bool visited[PIECE_ROTATIONS][BOARD_POSITION_WIDTH][GRID_VERTICAL_SIZE] = { 0 };
+    PiecePosition queue[MAX_PLACEMENTS];
+    int head = 0;
+    int tail = 0;
+    int count = 0;
+
+    if (!PieceFits(set, board, start)) return 0;
+
+    visited[start.rotation][start.x + PIECE_MAX_SIZE][start.y] = true;
+    queue[tail++] = start;
+
+    while (head < tail)
+    {
+        PiecePosition position = queue[head++];
+        PiecePosition down = position;
+
+        down.y++;
+
+        // Gravity is the only way down, the piece locks where it can not fall
+        if (PieceFits(set, board, down))
+        {
+            if (!visited[down.rotation][down.x + PIECE_MAX_SIZE][down.y])
+            {
+                visited[down.rotation][down.x + PIECE_MAX_SIZE][down.y] = true;
+                queue[tail++] = down;
+            }
+        }
+        else
+        {
+            Placement placement;
+            bool found = false;
+
+            GetPlacement(set, position, &placement);
+
+            // Turned pieces with the same squares are the same placement
+            for (int p = 0; (p < count) && !found; p++)
+            {
+                found = (placements[p].top == placement.top) &&
+                        (memcmp(placements[p].rowMask, placement.rowMask, sizeof(placement.rowMask)) == 0);
+            }
+
+            if (!found) placements[count++] = placement;
+        }
+
+        // Lateral moves and turn
+        for (int m = 0; m < 3; m++)
+        {
+            PiecePosition next = position;
+
+            next.x += moveX[m];
+            if (m == 2) next.rotation = (next.rotation + 1)%PIECE_ROTATIONS;
+
+            if (PieceFits(set, board, next) && !visited[next.rotation][next.x + PIECE_MAX_SIZE][next.y])
+            {
+                visited[next.rotation][next.x + PIECE_MAX_SIZE][next.y] = true;
+                queue[tail++] = next;
+            }
+        }
+    }
+
+    return count;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static inline unsigned int ShiftRow(unsigned int mask, int x)
+{
+    return (x >= 0)? (mask << x) : (mask >> -x);
+}
+
+static void GetPlacement(const PieceSet *set, PiecePosition position, Placement *placement)
+{
+    const PieceRotation *rotation = &set->type[position.type].rotation[position.rotation];
+
+    memset(placement, 0, sizeof(Placement));
+    placement->position = position;
+    placement->top = position.y + rotation->minY;
+
+    for (int j = rotation->minY; j <= rotation->maxY; j++)
+    {
+        placement->rowMask[j - rotation->minY] = (unsigned short)ShiftRow(rotation->rowMask[j], position.x);
+    }
+}
@@ -0,0 +1,66 @@
+/*******************************************************************************************
+*
+*   tetris42 - compact board engine
+*
+*   Locked squares of a board are kept as one bit mask per row, pieces come from the piece
+*   set tables. Movement follows the game: lateral moves, ResolveTurnMovement() turns and
+*   gravity, with no drops or kicks. Used by the tools that search many boards.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "tetris42.h"
+#include "pieces.h"
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define BOARD_WALLS             ((1u << 0) | (1u << (GRID_HORIZONTAL_SIZE - 1)))
+#define BOARD_FULL_ROW          ((1u << GRID_HORIZONTAL_SIZE) - 1)
+#define BOARD_PLAYABLE_ROWS     (GRID_VERTICAL_SIZE - 1)
+
+// Every box position a piece can take is a possible placement
+#define BOARD_POSITION_WIDTH    (GRID_HORIZONTAL_SIZE + PIECE_MAX_SIZE)
+#define MAX_PLACEMENTS          (PIECE_ROTATIONS*BOARD_POSITION_WIDTH*GRID_VERTICAL_SIZE)
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+// Bit i of a row is set when column i is FULL or BLOCK, walls and floor included
+typedef struct Board {
+    unsigned short rows[GRID_VERTICAL_SIZE];
+    unsigned long long hash;            // Zobrist hash of the locked rows, kept up to date
+} Board;
+
+// Piece bounding box position on the grid, like piecePositionX/Y in the game
+typedef struct PiecePosition {
+    int type;
+    int rotation;
+    int x;
+    int y;
+} PiecePosition;
+
+// Final position of a piece, squares as grid row masks from the top row of the piece
+typedef struct Placement {
+    PiecePosition position;
+    int top;
+    unsigned short rowMask[PIECE_MAX_SIZE];
+} Placement;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+void InitBoard(Board *board);                                       // Empty grid with walls and floor
+bool PieceFits(const PieceSet *set, const Board *board, PiecePosition position);
+PiecePosition SpawnPiece(const PieceSet *set, Board *board, int type);  // Place new piece like Createpiece()
+int LockPiece(const PieceSet *set, Board *board, PiecePosition position);   // Lock piece, returns deleted lines
+bool IsBoardOver(const Board *board);                               // Game over when full squares reach the top rows
+int GetPlacements(const PieceSet *set, const Board *board, PiecePosition start, Placement *placements);
+
+#endif // ENGINE_H
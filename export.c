@@ -0,0 +1,186 @@
+/*******************************************************************************************
+*
+*   tetris42 - shared memory board export
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#if !defined(_WIN32) && !defined(PLATFORM_WEB)
+    #define SUPPORT_EXPORT
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "export.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(SUPPORT_EXPORT)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define EXPORT_READ_ATTEMPTS    1000    // A write takes well under a microsecond
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static ExportRegion *region = NULL;     // Region the game publishes to
+static char regionName[64] = { 0 };
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// Create and map the region, the only system calls of the game side
+bool InitExport(const char *name, int boardCount)
+{
+#if defined(SUPPORT_EXPORT)
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+
+    if (fd < 0) return false;
+
+    if (ftruncate(fd, sizeof(ExportRegion)) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *memory = mmap(NULL, sizeof(ExportRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    close(fd);
+    if (memory == MAP_FAILED) return false;
+
+    region = (ExportRegion *)memory;
+    memset(region, 0, sizeof(ExportRegion));
+    region->version = EXPORT_VERSION;
+    region->stateSize = sizeof(BoardState);
+    region->boardCount = (boardCount < EXPORT_BOARDS)? boardCount : EXPORT_BOARDS;
+
+    // Readers check the magic first, it goes in last
+    atomic_thread_fence(memory_order_release);
+    region->magic = EXPORT_MAGIC;
+
+    snprintf(regionName, sizeof(regionName), "%s", name);
+
+    return true;
+#else
+    (void)name;
+    (void)boardCount;
+
+    return false;
+#endif
+}
+
+// Unmap and remove the region
+void UnloadExport(void)
+{
+#if defined(SUPPORT_EXPORT)
+    if (region == NULL) return;
+
+    munmap(region, sizeof(ExportRegion));
+    shm_unlink(regionName);
+    region = NULL;
+#endif
+}
+
+// No system calls, never waits
+void PublishBoardState(int board, const BoardState *state)
+{
+    if ((region == NULL) || (board >= region->boardCount)) return;
+
+    ExportBoard *export = &region->board[board];
+    unsigned int sequence = atomic_load_explicit(&export->sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&export->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    memcpy(&export->state, state, sizeof(BoardState));
+
+    atomic_store_explicit(&export->sequence, sequence + 2, memory_order_release);
+}
+
+// All boards of the tick are published
+void PublishTick(unsigned int tick)
+{
+    if (region != NULL) atomic_store_explicit(&region->tick, tick, memory_order_release);
+}
+
+// Map an existing region read only
+ExportRegion *OpenExport(const char *name)
+{
+#if defined(SUPPORT_EXPORT)
+    int fd = shm_open(name, O_RDONLY, 0);
+    struct stat info;
+
+    if (fd < 0) return NULL;
+
+    if ((fstat(fd, &info) != 0) || (info.st_size < (off_t)sizeof(ExportRegion)))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    void *memory = mmap(NULL, sizeof(ExportRegion), PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+    if (memory == MAP_FAILED) return NULL;
+
+    ExportRegion *export = (ExportRegion *)memory;
+
+    if ((export->magic != EXPORT_MAGIC) || (export->version != EXPORT_VERSION) || (export->stateSize != sizeof(BoardState)))
+    {
+        munmap(memory, sizeof(ExportRegion));
+        return NULL;
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+
+    return export;
+#else
+    (void)name;
+
+    return NULL;
+#endif
+}
+
+void CloseExport(ExportRegion *export)
+{
+#if defined(SUPPORT_EXPORT)
+    if (export != NULL) munmap(export, sizeof(ExportRegion));
+#else
+    (void)export;
+#endif
+}
+
+// Copy a consistent state, torn copies fail the sequence check and are taken again
+bool ReadBoardState(const ExportRegion *export, int board, BoardState *state, int *retries)
+{
+    if ((board < 0) || (board >= export->boardCount)) return false;
+
+    const ExportBoard *source = &export->board[board];
+
+    for (int attempt = 0; attempt < EXPORT_READ_ATTEMPTS; attempt++)
+    {
+        unsigned int before = atomic_load_explicit(&source->sequence, memory_order_acquire);
+
+        if (before & 1) continue;
+
+        memcpy(state, &source->state, sizeof(BoardState));
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&source->sequence, memory_order_relaxed) == before)
+        {
+            if (retries != NULL) *retries += attempt;
+            return true;
+        }
+    }
+
+    return false;
+}
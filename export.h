@@ -0,0 +1,66 @@
+/*******************************************************************************************
+*
+*   tetris42 - shared memory board export
+*
+*   Board states are published into a POSIX shared memory region for overlays running as
+*   other processes. Every board has its own seqlock: the game makes the sequence odd,
+*   copies the state and makes it even again, with no system calls and never waiting.
+*   Readers copy the state and retry when the sequence was odd or changed meanwhile.
+*
+*   Not available on Windows and in the browser, InitExport() fails there.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "boardstate.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define EXPORT_NAME             "/tetris42"
+#define EXPORT_MAGIC            0x32345254u     // "TR42"
+#define EXPORT_VERSION          1
+#define EXPORT_BOARDS           4
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct ExportBoard {
+    _Atomic unsigned int sequence;      // Odd while the game writes the state
+    unsigned int reserved;
+    BoardState state;
+} ExportBoard;
+
+// Layout of the shared memory region
+typedef struct ExportRegion {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int stateSize;             // sizeof(BoardState), readers check it
+    int boardCount;
+    _Atomic unsigned int tick;          // Last tick published
+    unsigned int reserved;
+    ExportBoard board[EXPORT_BOARDS];
+} ExportRegion;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+// Game side
+bool InitExport(const char *name, int boardCount);          // Create and map the region
+void UnloadExport(void);                                    // Unmap and remove the region
+void PublishBoardState(int board, const BoardState *state); // No system calls, never waits
+void PublishTick(unsigned int tick);                        // All boards of the tick are published
+
+// Reader side
+ExportRegion *OpenExport(const char *name);                 // Map an existing region read only
+void CloseExport(ExportRegion *region);
+bool ReadBoardState(const ExportRegion *region, int board, BoardState *state, int *retries);
+
+#endif // EXPORT_H
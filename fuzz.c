@@ -0,0 +1,499 @@
+/*******************************************************************************************
+*
+*   tetris42 - differential fuzz target of the game rules
+*
+*   Plays the same seed and input sequence on the game's own UpdateGame() and on the match
+*   instance logic of game.h, and compares the boards after every tick: every square, the
+*   piece, the queue, the hash, the random state, the flags, counters and lines. The game's
+*   functions are static, so this file includes tetris42.c with its main() renamed and
+*   drives board 1 through the game's globals, as the game does with one player.
+*
+*   An input is 8 bytes of seed, then one byte per tick with the BoardInput fields as bits
+*   (move pressed, turn pressed, left, right, turn, fast fall, pause, restart); after the
+*   last one the board plays on for 10 seconds with no keys down. Every 16th input is played
+*   again on each side alone to time both.
+*
+*   Built with FUZZ_WITH_LIBFUZZER (clang) this is a libFuzzer target and a difference
+*   aborts, leaving the input behind. Standalone it plays the input files it is given, or
+*   random seeds with random players, and saves an input that differs:
+*       tetris42-fuzz [--runs <n>] [--ticks <n>] [--seed <n>] [files]
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#define main Tetris42Main       // Only the game's rules are used
+#include "tetris42.c"
+#undef main
+
+#include "game.h"
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define FUZZ_BOARD              1       // The board of one player
+#define FUZZ_SEED_SIZE          8
+#define FUZZ_TAIL_TICKS         600     // Played with no keys down after the input
+#define FUZZ_TIMING_EVERY       16      // Inputs between timed ones
+#define FUZZ_MAX_TICKS          1000000 // Of a random input
+#define FUZZ_DIFFERENCE_FILE    "fuzz-difference.bin"
+#define FUZZ_PAUSE_CHANCE       4000    // Random players press pause once in so many ticks
+#define FUZZ_RESTART_CHANCE     30
+
+#if defined(_WIN32)
+    #define NULL_DEVICE         "NUL"
+#else
+    #define NULL_DEVICE         "/dev/null"
+#endif
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef enum { PLAYER_RANDOM = 0, PLAYER_HOLDING, PLAYER_BOT } FuzzPlayer;
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static GameMatch fuzzMatch;
+static const uint8_t *fuzzData = NULL;  // Input being played, saved when it differs
+static size_t fuzzSize = 0;
+static bool saveDifference = false;
+
+static unsigned long long fuzzRuns = 0;
+static unsigned long long fuzzTicks = 0;
+static unsigned long long timedTicks = 0;
+static double legacyTime = 0;           // Seconds in UpdateGame()
+static double engineTime = 0;           // Seconds in StepGameBoard()
+
+// Rules the inputs reached
+static unsigned long long locks = 0;
+static unsigned long long deletedLines = 0;
+static unsigned long long games = 0;
+static unsigned long long refusedTurns = 0;
+static unsigned long long wallTicks = 0;    // With moving squares in the walls
+static unsigned long long pausedTicks = 0;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static void InitFuzz(void);
+static void StartLegacy(unsigned long long seed);
+static BoardInput GetTickInput(const uint8_t *keys, size_t count, int tick);
+static unsigned int GetInputKeys(const BoardInput *tickInput);
+static void CountRules(const BoardInput *tickInput, bool wasActive, bool wasFalling, int rotation, int lastLines);
+static void CompareBoards(unsigned long long seed, int tick, const BoardInput *tickInput);
+static void PlayTimed(unsigned long long seed, const uint8_t *keys, size_t count);
+static void ReportFuzz(void);
+static double GetFuzzTime(void);
+#if !defined(SUPPORT_LIBFUZZER)
+static unsigned long long NextRandom(unsigned long long *state);
+static size_t GenerateInput(uint8_t *data, int maxTicks, unsigned long long *random);
+static void PlayBot(unsigned long long seed, uint8_t *keys, size_t count, int mistakes, unsigned long long *random);
+#endif
+
+//------------------------------------------------------------------------------------
+// Fuzz target entry point
+//------------------------------------------------------------------------------------
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    size_t seedSize = (size < FUZZ_SEED_SIZE)? size : FUZZ_SEED_SIZE;
+    unsigned long long seed = 0;
+
+    InitFuzz();
+
+    for (size_t i = 0; i < seedSize; i++) seed |= (unsigned long long)data[i] << 8*i;
+
+    const uint8_t *keys = data + seedSize;
+    size_t count = size - seedSize;
+    int ticks = (int)count + FUZZ_TAIL_TICKS;
+
+    fuzzData = data;
+    fuzzSize = size;
+
+    StartLegacy(seed);
+    InitGameMatch(&fuzzMatch, 1, seed);
+
+    for (int t = 0; t < ticks; t++)
+    {
+        BoardInput tickInput = GetTickInput(keys, count, t);
+        bool wasActive = pieceActive[Gr];
+        bool wasFalling = !gameOver[Gr] && !lineToDelete[Gr];
+        int rotation = pieceRotation[Gr];
+        int lastLines = lines[Gr];
+
+        input[Gr] = tickInput;
+        UpdateGame();
+        StepGameBoard(&pieceSet, &fuzzMatch, FUZZ_BOARD, &tickInput);
+
+        CompareBoards(seed, t, &tickInput);
+        CountRules(&tickInput, wasActive, wasFalling, rotation, lastLines);
+    }
+
+    fuzzRuns++;
+    fuzzTicks += ticks;
+
+    if (fuzzRuns%FUZZ_TIMING_EVERY == 1) PlayTimed(seed, keys, count);
+
+    return 0;
+}
+
+#if !defined(SUPPORT_LIBFUZZER)
+//------------------------------------------------------------------------------------
+// Program main entry point
+//------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    unsigned long long runs = 1000;
+    unsigned long long random = (unsigned long long)time(NULL);
+    int maxTicks = 20000;
+    int fileCount = 0;
+    bool usage = false;
+
+    for (int a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "--runs") == 0) && (a + 1 < argc)) runs = strtoull(argv[++a], NULL, 10);
+        else if ((strcmp(argv[a], "--ticks") == 0) && (a + 1 < argc)) maxTicks = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--seed") == 0) && (a + 1 < argc)) random = strtoull(argv[++a], NULL, 10);
+        else if (argv[a][0] == '-') usage = true;
+        else argv[1 + fileCount++] = argv[a];
+    }
+
+    if (usage || (maxTicks < 1) || (maxTicks > FUZZ_MAX_TICKS))
+    {
+        fprintf(stderr, "Usage: tetris42-fuzz [options] [files]\n"
+                        "  --runs <n>               random inputs to play without files, 1000 by default\n"
+                        "  --ticks <n>              longest random input, 20000 ticks by default\n"
+                        "  --seed <n>               of the random inputs, the time by default\n"
+                        "  files                    inputs to play again, like the ones libFuzzer keeps\n");
+        return 1;
+    }
+
+    static uint8_t data[FUZZ_SEED_SIZE + FUZZ_MAX_TICKS];
+
+    saveDifference = true;
+
+    for (int f = 0; f < fileCount; f++)
+    {
+        FILE *file = fopen(argv[1 + f], "rb");
+
+        if (file == NULL)
+        {
+            fprintf(stderr, "Can not open %s.\n", argv[1 + f]);
+            return 1;
+        }
+
+        size_t size = fread(data, 1, sizeof(data), file);
+
+        fclose(file);
+        LLVMFuzzerTestOneInput(data, size);
+    }
+
+    if (fileCount > 0) return 0;
+
+    fprintf(stderr, "Random inputs from seed %llu\n", random);
+
+    for (unsigned long long r = 0; r < runs; r++)
+    {
+        size_t size = GenerateInput(data, maxTicks, &random);
+
+        LLVMFuzzerTestOneInput(data, size);
+    }
+
+    return 0;
+}
+#endif
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static void InitFuzz(void)
+{
+    static bool initialized = false;
+
+    if (initialized) return;
+    initialized = true;
+
+    LoadDefaultPieceSet(&pieceSet);
+    InitZobrist();
+    MAX_PLAYERS = 1;
+
+    // The game prints every game over, the report goes to stderr
+    if (freopen(NULL_DEVICE, "w", stdout) == NULL) fprintf(stderr, "Game output is not silenced.\n");
+    atexit(ReportFuzz);
+}
+
+// Board 1 from the same start as InitGameMatch()
+static void StartLegacy(unsigned long long seed)
+{
+    Gr = FUZZ_BOARD;
+    randomSeed = seed;
+    gameOver[Gr] = false;
+    pieceType[Gr] = 0;
+    InitGame();
+}
+
+static BoardInput GetTickInput(const uint8_t *keys, size_t count, int tick)
+{
+    unsigned int bits = ((size_t)tick < count)? keys[tick] : 0;
+    BoardInput tickInput = {
+        .movePressed = bits & 1,
+        .turnPressed = (bits >> 1) & 1,
+        .left = (bits >> 2) & 1,
+        .right = (bits >> 3) & 1,
+        .turn = (bits >> 4) & 1,
+        .fastFall = (bits >> 5) & 1,
+        .pausePressed = (bits >> 6) & 1,
+        .restartPressed = (bits >> 7) & 1
+    };
+
+    return tickInput;
+}
+
+static unsigned int GetInputKeys(const BoardInput *tickInput)
+{
+    return tickInput->movePressed | (tickInput->turnPressed << 1) | (tickInput->left << 2) | (tickInput->right << 3) |
+           (tickInput->turn << 4) | (tickInput->fastFall << 5) | (tickInput->pausePressed << 6) | (tickInput->restartPressed << 7);
+}
+
+static void CountRules(const BoardInput *tickInput, bool wasActive, bool wasFalling, int rotation, int lastLines)
+{
+    if (pause)
+    {
+        pausedTicks++;
+        return;
+    }
+
+    if (wasActive && !pieceActive[Gr]) locks++;
+    if (lines[Gr] > lastLines) deletedLines += lines[Gr] - lastLines;
+    if (gameOver[Gr] && wasFalling) games++;
+
+    // Turn counter is only reset by a turn, which the checker may refuse
+    if (wasActive && wasFalling && tickInput->turn && (turnMovementCounter[Gr] == 0) && (pieceRotation[Gr] == rotation)) refusedTurns++;
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+    {
+        if ((grid[Gr][0][j] == MOVING) || (grid[Gr][GRID_HORIZONTAL_SIZE - 1][j] == MOVING))
+        {
+            wallTicks++;
+            break;
+        }
+    }
+}
+
+static void CompareBoards(unsigned long long seed, int tick, const BoardInput *tickInput)
+{
+    const GameBoard *board = &fuzzMatch.board[FUZZ_BOARD];
+    int different = 0;
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+    {
+        for (int i = 0; i < GRID_HORIZONTAL_SIZE; i++) different += (grid[Gr][i][j] != GetGameSquare(board, i, j));
+    }
+
+    different += (pieceType[Gr] != board->pieceType) + (pieceRotation[Gr] != board->pieceRotation) +
+                 (incomingType[Gr] != board->incomingType) + (piecePositionX[Gr] != board->piecePositionX) +
+                 (piecePositionY[Gr] != board->piecePositionY) + (positionHash[Gr] != board->positionHash) +
+                 (randomState[Gr] != board->randomState) + (gameOver[Gr] != board->gameOver) +
+                 (beginPlay[Gr] != board->beginPlay) + (pieceActive[Gr] != board->pieceActive) +
+                 (detection[Gr] != board->detection) + (lineToDelete[Gr] != board->lineToDelete) +
+                 (level[Gr] != board->level) + (lines[Gr] != board->lines) +
+                 (gravityMovementCounter[Gr] != board->gravityMovementCounter) +
+                 (lateralMovementCounter[Gr] != board->lateralMovementCounter) +
+                 (turnMovementCounter[Gr] != board->turnMovementCounter) +
+                 (fastFallMovementCounter[Gr] != board->fastFallMovementCounter) +
+                 (fadeLineCounter[Gr] != board->fadeLineCounter) + (pause != fuzzMatch.pause) +
+                 (gravitySpeed != fuzzMatch.gravitySpeed) + (randomSeed != fuzzMatch.randomSeed);
+
+    if (different == 0) return;
+
+    const char squares[] = ".M#B~";
+
+    fprintf(stderr, "Difference after tick %d of seed %llu, keys 0x%02x\n", tick, seed, GetInputKeys(tickInput));
+    fprintf(stderr, "                     game                           engine\n");
+    fprintf(stderr, "piece      %2d %d %3d %3d   next %2d      %2d %d %3d %3d   next %2d\n",
+            pieceType[Gr], pieceRotation[Gr], piecePositionX[Gr], piecePositionY[Gr], incomingType[Gr],
+            board->pieceType, board->pieceRotation, board->piecePositionX, board->piecePositionY, board->incomingType);
+    fprintf(stderr, "hash       %016llx           %016llx\n", positionHash[Gr], board->positionHash);
+    fprintf(stderr, "random     %016llx           %016llx\n", randomState[Gr], board->randomState);
+    fprintf(stderr, "flags      over %d begin %d active %d detection %d delete %d pause %d    over %d begin %d active %d detection %d delete %d pause %d\n",
+            gameOver[Gr], beginPlay[Gr], pieceActive[Gr], detection[Gr], lineToDelete[Gr], pause,
+            board->gameOver, board->beginPlay, board->pieceActive, board->detection, board->lineToDelete, fuzzMatch.pause);
+    fprintf(stderr, "counters   %d %d %d %d %d speed %d    %d %d %d %d %d speed %d\n",
+            gravityMovementCounter[Gr], lateralMovementCounter[Gr], turnMovementCounter[Gr], fastFallMovementCounter[Gr], fadeLineCounter[Gr], gravitySpeed,
+            board->gravityMovementCounter, board->lateralMovementCounter, board->turnMovementCounter, board->fastFallMovementCounter, board->fadeLineCounter, fuzzMatch.gravitySpeed);
+    fprintf(stderr, "lines      %d level %d seed %016llx    %d level %d seed %016llx\n",
+            lines[Gr], level[Gr], randomSeed, board->lines, board->level, fuzzMatch.randomSeed);
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+    {
+        fprintf(stderr, "row %2d     ", j);
+        for (int i = 0; i < GRID_HORIZONTAL_SIZE; i++) fputc(squares[grid[Gr][i][j]], stderr);
+        fprintf(stderr, "                   ");
+        for (int i = 0; i < GRID_HORIZONTAL_SIZE; i++) fputc(squares[GetGameSquare(board, i, j)], stderr);
+        fputc('\n', stderr);
+    }
+
+    if (saveDifference)
+    {
+        FILE *file = fopen(FUZZ_DIFFERENCE_FILE, "wb");
+
+        if ((file != NULL) && (fwrite(fuzzData, 1, fuzzSize, file) == fuzzSize)) fprintf(stderr, "Input saved to %s\n", FUZZ_DIFFERENCE_FILE);
+        if (file != NULL) fclose(file);
+    }
+
+    abort();
+}
+
+// Each side alone, input decoding timed on both
+static void PlayTimed(unsigned long long seed, const uint8_t *keys, size_t count)
+{
+    int ticks = (int)count + FUZZ_TAIL_TICKS;
+
+    StartLegacy(seed);
+
+    double start = GetFuzzTime();
+
+    for (int t = 0; t < ticks; t++)
+    {
+        input[Gr] = GetTickInput(keys, count, t);
+        UpdateGame();
+    }
+
+    legacyTime += GetFuzzTime() - start;
+
+    InitGameMatch(&fuzzMatch, 1, seed);
+    start = GetFuzzTime();
+
+    for (int t = 0; t < ticks; t++)
+    {
+        BoardInput tickInput = GetTickInput(keys, count, t);
+
+        StepGameBoard(&pieceSet, &fuzzMatch, FUZZ_BOARD, &tickInput);
+    }
+
+    engineTime += GetFuzzTime() - start;
+    timedTicks += ticks;
+}
+
+static void ReportFuzz(void)
+{
+    fprintf(stderr, "Played %llu inputs, %llu ticks, the game and the engine never differed\n", fuzzRuns, fuzzTicks);
+    fprintf(stderr, "Reached %llu locks, %llu lines, %llu games over, %llu refused turns, %llu ticks with squares in the walls, %llu paused ticks\n",
+            locks, deletedLines, games, refusedTurns, wallTicks, pausedTicks);
+
+    if ((timedTicks > 0) && (engineTime > 0))
+    {
+        fprintf(stderr, "UpdateGame() %.1f ns per tick, StepGameBoard() %.1f ns per tick, engine %.2fx as fast\n",
+                1e9*legacyTime/timedTicks, 1e9*engineTime/timedTicks, legacyTime/engineTime);
+    }
+}
+
+static double GetFuzzTime(void)
+{
+    struct timespec time;
+
+    timespec_get(&time, TIME_UTC);
+
+    return time.tv_sec + time.tv_nsec/1e9;
+}
+
+#if !defined(SUPPORT_LIBFUZZER)
+// SplitMix64
+static unsigned long long NextRandom(unsigned long long *state)
+{
+    unsigned long long z = (*state += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+
+    return z ^ (z >> 31);
+}
+
+// Random seed and player: keys at random, keys held for a while at the player's pace or a
+// stress bot making mistakes, the one that locks pieces and deletes lines
+static size_t GenerateInput(uint8_t *data, int maxTicks, unsigned long long *random)
+{
+    size_t size = FUZZ_SEED_SIZE + 1 + NextRandom(random)%maxTicks;
+    int choice = (int)(NextRandom(random)%4);
+    FuzzPlayer player = (choice == 0)? PLAYER_RANDOM : (choice == 1)? PLAYER_HOLDING : PLAYER_BOT;
+    int pace = 2 + (int)(NextRandom(random)%60);
+    unsigned long long seed = NextRandom(random);
+    bool held[4] = { false };
+
+    for (int i = 0; i < FUZZ_SEED_SIZE; i++) data[i] = (uint8_t)(seed >> 8*i);
+
+    if (player == PLAYER_BOT)
+    {
+        PlayBot(seed, data + FUZZ_SEED_SIZE, size - FUZZ_SEED_SIZE, 4*pace, random);
+        return size;
+    }
+
+    for (size_t i = FUZZ_SEED_SIZE; i < size; i++)
+    {
+        unsigned long long value = NextRandom(random);
+        unsigned int pausePressed = ((value >> 40)%FUZZ_PAUSE_CHANCE == 0);
+        unsigned int restartPressed = ((value >> 52)%FUZZ_RESTART_CHANCE == 0);
+
+        if (player == PLAYER_RANDOM)
+        {
+            data[i] = (uint8_t)((value & 0x3f) | (pausePressed << 6) | (restartPressed << 7));
+            continue;
+        }
+
+        // Left, right, turn and fast fall, moves and turns pressed as keys go down
+        bool down[4];
+
+        for (int k = 0; k < 4; k++)
+        {
+            down[k] = held[k];
+            if ((value >> 8*k)%pace == 0) held[k] = !held[k];
+        }
+
+        data[i] = (uint8_t)((((held[0] && !down[0]) || (held[1] && !down[1])) << 0) | ((held[2] && !down[2]) << 1) |
+                            (held[0] << 2) | (held[1] << 3) | (held[2] << 4) | (held[3] << 5) |
+                            (pausePressed << 6) | (restartPressed << 7));
+    }
+
+    return size;
+}
+
+// Keys of a stress bot playing the engine's board, random keys once in mistakes ticks
+static void PlayBot(unsigned long long seed, uint8_t *keys, size_t count, int mistakes, unsigned long long *random)
+{
+    static bool initialized = false;
+    GameBoard *board = &fuzzMatch.board[FUZZ_BOARD];
+
+    if (!initialized) InitStress(&pieceSet, 0);
+    initialized = true;
+
+    InitGameMatch(&fuzzMatch, 1, seed);
+
+    for (size_t t = 0; t < count; t++)
+    {
+        PiecePosition piece = { board->pieceType, board->pieceRotation, board->piecePositionX, board->piecePositionY };
+        unsigned long long value = NextRandom(random);
+        bool wasActive = board->pieceActive;
+        BoardInput tickInput;
+
+        GetStressInput(FUZZ_BOARD, piece, board->pieceActive, board->gameOver, &tickInput);
+
+        keys[t] = (value%mistakes == 0)? (uint8_t)((value >> 8) & 0xbf) : (uint8_t)GetInputKeys(&tickInput);
+        tickInput = GetTickInput(keys, count, (int)t);
+
+        StepGameBoard(&pieceSet, &fuzzMatch, FUZZ_BOARD, &tickInput);
+
+        if (board->pieceActive && !wasActive)
+        {
+            Board grid;
+            PiecePosition start = { board->pieceType, 0, board->piecePositionX, 0 };
+
+            for (int j = 0; j < GRID_VERTICAL_SIZE; j++) grid.rows[j] = board->rows[FULL][j] | board->rows[BLOCK][j];
+
+            grid.hash = HashBoard(&grid);
+            PlanStressPiece(FUZZ_BOARD, &grid, start, board->incomingType);
+        }
+    }
+}
+#endif
@@ -0,0 +1,485 @@
+/*******************************************************************************************
+*
+*   tetris42 - game logic on match instances
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "game.h"
+#include "zobrist.h"
+
+#include <string.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define GAME_SCANNED_ROWS       (GRID_VERTICAL_SIZE - 1)    // Rows above the floor the game scans
+#define GAME_RIGHT_WALL         (1u << (GRID_HORIZONTAL_SIZE - 1))
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static _Thread_local unsigned long long *randomState = NULL;    // Of the board drawing a piece
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static inline unsigned int ShiftRow(unsigned int mask, int x);
+static inline bool RowInside(unsigned int mask, int x);
+static inline void SetSquares(GameBoard *board, int j, unsigned int mask, GridSquare square);
+static void Createpiece(const PieceSet *set, GameBoard *board);
+static void GetRandompiece(const PieceSet *set, GameBoard *board);
+static void ResolveFallingMovement(const PieceSet *set, GameBoard *board);
+static bool ResolveLateralMovement(GameBoard *board, const BoardInput *input);
+static bool ResolveTurnMovement(const PieceSet *set, GameBoard *board, const BoardInput *input);
+static void CheckDetection(GameBoard *board);
+static void CheckCompletion(GameBoard *board);
+static int DeleteCompleteLines(GameBoard *board);
+static unsigned long long HashGridRows(const GameBoard *board, int first, int last);
+static unsigned long long HashActivePiece(const GameBoard *board);
+static int GetBoardRandomValue(int min, int max);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+void InitGameMatch(GameMatch *match, int players, unsigned long long randomSeed)
+{
+    memset(match, 0, sizeof(GameMatch));
+
+    match->players = players;
+    match->gravitySpeed = GAME_GRAVITY_SPEED;
+    match->randomSeed = randomSeed;
+
+    // Boards without a player keep the initial values of the game's globals
+    for (int b = 0; b < GAME_BOARDS; b++)
+    {
+        match->board[b].incomingType = -1;
+        match->board[b].beginPlay = true;
+        match->board[b].level = 1;
+    }
+
+    if (players == 1) InitGameBoard(match, 1);
+    else for (int b = 0; b < players; b++) InitGameBoard(match, b);
+}
+
+void InitGameBoard(GameMatch *match, int b)
+{
+    GameBoard *board = &match->board[b];
+
+    board->level = 1;
+    board->lines = 0;
+    board->piecePositionX = 0;
+    board->piecePositionY = 0;
+
+    match->pause = false;
+
+    board->beginPlay = true;
+    board->pieceActive = false;
+    board->detection = false;
+    board->lineToDelete = false;
+
+    board->gravityMovementCounter = 0;
+    board->lateralMovementCounter = 0;
+    board->turnMovementCounter = 0;
+    board->fastFallMovementCounter = 0;
+    board->fadeLineCounter = 0;
+    match->gravitySpeed = GAME_GRAVITY_SPEED;
+
+    memset(board->rows, 0, sizeof(board->rows));
+    for (int j = 0; j < GRID_VERTICAL_SIZE - 1; j++) board->rows[BLOCK][j] = BOARD_WALLS;
+    board->rows[BLOCK][GRID_VERTICAL_SIZE - 1] = BOARD_FULL_ROW;
+
+    board->pieceRotation = 0;
+    board->incomingType = -1;
+    board->positionHash = 0;
+
+    match->randomSeed += 0x9e3779b97f4a7c15ull;
+    board->randomState = match->randomSeed ^ ((unsigned long long)b << 56);
+}
+
+void StepGameBoard(const PieceSet *set, GameMatch *match, int b, const BoardInput *input)
+{
+    GameBoard *board = &match->board[b];
+
+    if (board->gameOver)
+    {
+        if (input->restartPressed)
+        {
+            InitGameBoard(match, b);
+            board->gameOver = false;
+        }
+
+        return;
+    }
+
+    if (input->pausePressed) match->pause = !match->pause;
+    if (match->pause) return;
+
+    if (board->lineToDelete)
+    {
+        // The fading color is all that changes until the lines go
+        if (++board->fadeLineCounter >= FADING_TIME)
+        {
+            board->lines += DeleteCompleteLines(board);
+            board->fadeLineCounter = 0;
+            board->lineToDelete = false;
+        }
+
+        return;
+    }
+
+    if (!board->pieceActive)
+    {
+        Createpiece(set, board);
+        board->pieceActive = true;
+        board->fastFallMovementCounter = 0;
+    }
+    else
+    {
+        board->fastFallMovementCounter++;
+        board->gravityMovementCounter++;
+        board->lateralMovementCounter++;
+        board->turnMovementCounter++;
+
+        if (input->movePressed) board->lateralMovementCounter = LATERAL_SPEED;
+        if (input->turnPressed) board->turnMovementCounter = TURNING_SPEED;
+
+        if (input->fastFall && (board->fastFallMovementCounter >= FAST_FALL_AWAIT_COUNTER)) board->gravityMovementCounter += match->gravitySpeed;
+
+        if (board->gravityMovementCounter >= match->gravitySpeed)
+        {
+            CheckDetection(board);
+            ResolveFallingMovement(set, board);
+            CheckCompletion(board);
+            board->gravityMovementCounter = 0;
+        }
+
+        if ((board->lateralMovementCounter >= LATERAL_SPEED) && !ResolveLateralMovement(board, input)) board->lateralMovementCounter = 0;
+        if ((board->turnMovementCounter >= TURNING_SPEED) && ResolveTurnMovement(set, board, input)) board->turnMovementCounter = 0;
+    }
+
+    if ((board->rows[FULL][0] | board->rows[FULL][1]) & GAME_COLUMNS) board->gameOver = true;
+}
+
+void StepGameMatch(const PieceSet *set, GameMatch *match, const BoardInput *input)
+{
+    if (match->players == 1) StepGameBoard(set, match, 1, &input[1]);
+    else for (int b = 0; b < match->players; b++) StepGameBoard(set, match, b, &input[b]);
+
+    match->tick++;
+}
+
+GridSquare GetGameSquare(const GameBoard *board, int i, int j)
+{
+    for (int s = MOVING; s < GAME_SQUARE_STATES; s++)
+    {
+        if (board->rows[s][j] & (1u << i)) return (GridSquare)s;
+    }
+
+    return EMPTY;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+// Box row mask to grid row mask, squares outside the grid dropped
+static inline unsigned int ShiftRow(unsigned int mask, int x)
+{
+    if ((x <= -GRID_HORIZONTAL_SIZE) || (x >= GRID_HORIZONTAL_SIZE)) return 0;
+
+    return ((x >= 0)? (mask << x) : (mask >> -x)) & BOARD_FULL_ROW;
+}
+
+static inline bool RowInside(unsigned int mask, int x)
+{
+    if ((x <= -GRID_HORIZONTAL_SIZE) || (x >= GRID_HORIZONTAL_SIZE)) return mask == 0;
+
+    return (x >= 0)? ((mask << x) & ~BOARD_FULL_ROW) == 0 : (mask & ((1u << -x) - 1)) == 0;
+}
+
+// Squares of the mask become the square, whatever they were, like a grid store
+static inline void SetSquares(GameBoard *board, int j, unsigned int mask, GridSquare square)
+{
+    for (int s = MOVING; s < GAME_SQUARE_STATES; s++) board->rows[s][j] &= ~mask;
+    if (square != EMPTY) board->rows[square][j] |= mask;
+}
+
+static void Createpiece(const PieceSet *set, GameBoard *board)
+{
+    if (board->beginPlay)
+    {
+        GetRandompiece(set, board);
+        board->beginPlay = false;
+    }
+
+    board->pieceType = board->incomingType;
+    board->pieceRotation = 0;
+    board->piecePositionX = (GRID_HORIZONTAL_SIZE - set->type[board->pieceType].size)/2;
+    board->piecePositionY = 0;
+
+    GetRandompiece(set, board);
+
+    // Full squares under the new piece are lost
+    const PieceRotation *rotation = &set->type[board->pieceType].rotation[0];
+
+    board->positionHash ^= HashGridRows(board, rotation->minY, rotation->maxY);
+
+    for (int j = rotation->minY; j <= rotation->maxY; j++) SetSquares(board, j, ShiftRow(rotation->rowMask[j], board->piecePositionX), MOVING);
+
+    board->positionHash ^= HashGridRows(board, rotation->minY, rotation->maxY) ^ HashActivePiece(board);
+}
+
+static void GetRandompiece(const PieceSet *set, GameBoard *board)
+{
+    if (board->incomingType >= 0) board->positionHash ^= HashQueue(0, board->incomingType);
+
+    randomState = &board->randomState;
+    board->incomingType = GetRandomPieceType(set, board->lines, GetBoardRandomValue);
+
+    board->positionHash ^= HashQueue(0, board->incomingType);
+}
+
+static void ResolveFallingMovement(const PieceSet *set, GameBoard *board)
+{
+    if (board->detection)
+    {
+        const PieceRotation *rotation = &set->type[board->pieceType].rotation[board->pieceRotation];
+        int top = board->piecePositionY + rotation->minY;
+        int bottom = board->piecePositionY + rotation->maxY;
+
+        board->positionHash ^= HashGridRows(board, top, bottom) ^ HashActivePiece(board);
+
+        // Every moving square locks, stray ones too
+        for (int j = 0; j < GAME_SCANNED_ROWS; j++)
+        {
+            unsigned int squares = board->rows[MOVING][j] & GAME_COLUMNS;
+
+            if (squares == 0) continue;
+
+            board->rows[MOVING][j] &= ~squares;
+            board->rows[FULL][j] |= squares;
+            board->detection = false;
+            board->pieceActive = false;
+        }
+
+        board->positionHash ^= HashGridRows(board, top, bottom);
+    }
+    else
+    {
+        // Bottom up, so every square moves once, over whatever is below it
+        for (int j = GAME_SCANNED_ROWS - 1; j >= 0; j--)
+        {
+            unsigned int squares = board->rows[MOVING][j] & GAME_COLUMNS;
+
+            board->rows[MOVING][j] &= ~squares;
+            SetSquares(board, j + 1, squares, MOVING);
+        }
+
+        board->positionHash ^= HashActivePiece(board);
+        board->piecePositionY++;
+        board->positionHash ^= HashActivePiece(board);
+    }
+}
+
+static bool ResolveLateralMovement(GameBoard *board, const BoardInput *input)
+{
+    bool collision = false;
+
+    if (input->left)
+    {
+        for (int j = 0; j < GAME_SCANNED_ROWS; j++)
+        {
+            unsigned int squares = board->rows[MOVING][j] & GAME_COLUMNS;
+
+            if ((squares & (1u << 1)) || ((squares >> 1) & board->rows[FULL][j])) collision = true;
+        }
+
+        if (!collision)
+        {
+            // Moves into fading squares, which only full squares stop
+            for (int j = 0; j < GAME_SCANNED_ROWS; j++)
+            {
+                unsigned int squares = board->rows[MOVING][j] & GAME_COLUMNS;
+
+                board->rows[MOVING][j] &= ~squares;
+                SetSquares(board, j, squares >> 1, MOVING);
+            }
+
+            // Position still moves in the frame the piece locked, with nothing to move
+            if (board->pieceActive) board->positionHash ^= HashActivePiece(board);
+            board->piecePositionX--;
+            if (board->pieceActive) board->positionHash ^= HashActivePiece(board);
+        }
+    }
+    else if (input->right)
+    {
+        for (int j = 0; j < GAME_SCANNED_ROWS; j++)
+        {
+            unsigned int squares = board->rows[MOVING][j] & GAME_COLUMNS;
+
+            if ((squares & (GAME_RIGHT_WALL >> 1)) || ((squares << 1) & board->rows[FULL][j])) collision = true;
+        }
+
+        if (!collision)
+        {
+            // The game moves squares in the right wall too, out of the grid
+            for (int j = 0; j < GAME_SCANNED_ROWS; j++)
+            {
+                unsigned int squares = board->rows[MOVING][j] & (GAME_COLUMNS | GAME_RIGHT_WALL);
+
+                board->rows[MOVING][j] &= ~squares;
+                SetSquares(board, j, (squares << 1) & BOARD_FULL_ROW, MOVING);
+            }
+
+            if (board->pieceActive) board->positionHash ^= HashActivePiece(board);
+            board->piecePositionX++;
+            if (board->pieceActive) board->positionHash ^= HashActivePiece(board);
+        }
+    }
+
+    return collision;
+}
+
+static bool ResolveTurnMovement(const PieceSet *set, GameBoard *board, const BoardInput *input)
+{
+    if (!input->turn) return false;
+
+    const PieceType *type = &set->type[board->pieceType];
+    int turn = (board->pieceRotation + 1)%PIECE_ROTATIONS;
+    const PieceRotation *turned = &type->rotation[turn];
+    bool checker = false;
+
+    // It can only turn into empty or moving squares inside the grid
+    for (int j = turned->minY; j <= turned->maxY; j++)
+    {
+        int row = board->piecePositionY + j;
+        unsigned int mask = turned->rowMask[j];
+
+        if (mask == 0) continue;
+
+        if ((row >= GRID_VERTICAL_SIZE) || !RowInside(mask, board->piecePositionX) ||
+            (ShiftRow(mask, board->piecePositionX) & (board->rows[FULL][row] | board->rows[BLOCK][row] | board->rows[FADING][row]))) checker = true;
+    }
+
+    if (!checker)
+    {
+        if (board->pieceActive) board->positionHash ^= HashActivePiece(board);
+        board->pieceRotation = turn;
+        if (board->pieceActive) board->positionHash ^= HashActivePiece(board);
+    }
+
+    // Turned or not, moving squares go and the piece is stamped again where it is
+    for (int j = 0; j < GAME_SCANNED_ROWS; j++) board->rows[MOVING][j] &= ~GAME_COLUMNS;
+
+    const PieceRotation *rotation = &type->rotation[board->pieceRotation];
+    int top = board->piecePositionY + rotation->minY;
+    int bottom = board->piecePositionY + rotation->maxY;
+
+    board->positionHash ^= HashGridRows(board, top, bottom);
+
+    // Rows of a piece that left the grid are not stamped
+    for (int j = rotation->minY; j <= rotation->maxY; j++)
+    {
+        int row = board->piecePositionY + j;
+
+        if ((row >= 0) && (row < GRID_VERTICAL_SIZE)) SetSquares(board, row, ShiftRow(rotation->rowMask[j], board->piecePositionX), MOVING);
+    }
+
+    board->positionHash ^= HashGridRows(board, top, bottom);
+
+    return true;
+}
+
+static void CheckDetection(GameBoard *board)
+{
+    for (int j = 0; j < GAME_SCANNED_ROWS; j++)
+    {
+        if (board->rows[MOVING][j] & GAME_COLUMNS & (board->rows[FULL][j + 1] | board->rows[BLOCK][j + 1])) board->detection = true;
+    }
+}
+
+static void CheckCompletion(GameBoard *board)
+{
+    for (int j = 0; j < GAME_SCANNED_ROWS; j++)
+    {
+        if ((board->rows[FULL][j] & GAME_COLUMNS) == GAME_COLUMNS)
+        {
+            board->lineToDelete = true;
+            SetSquares(board, j, GAME_COLUMNS, FADING);
+        }
+    }
+}
+
+static int DeleteCompleteLines(GameBoard *board)
+{
+    int deletedLines = 0;
+
+    board->positionHash ^= HashGridRows(board, 0, GAME_SCANNED_ROWS - 1);
+
+    // A line goes while its first square is fading, rows above fall one by one
+    for (int j = GAME_SCANNED_ROWS - 1; j >= 0; j--)
+    {
+        while (board->rows[FADING][j] & (1u << 1))
+        {
+            SetSquares(board, j, GAME_COLUMNS, EMPTY);
+
+            // Moving squares stay where they are, unless a square falls on them
+            for (int j2 = j - 1; j2 >= 0; j2--)
+            {
+                unsigned int full = board->rows[FULL][j2] & GAME_COLUMNS;
+                unsigned int fading = board->rows[FADING][j2] & GAME_COLUMNS;
+
+                SetSquares(board, j2 + 1, full, FULL);
+                SetSquares(board, j2 + 1, fading, FADING);
+                board->rows[FULL][j2] &= ~full;
+                board->rows[FADING][j2] &= ~fading;
+            }
+
+            deletedLines++;
+        }
+    }
+
+    board->positionHash ^= HashGridRows(board, 0, GAME_SCANNED_ROWS - 1);
+
+    return deletedLines;
+}
+
+// Locked squares of the rows, fading lines are still locked squares
+static unsigned long long HashGridRows(const GameBoard *board, int first, int last)
+{
+    unsigned long long hash = 0;
+
+    if (first < 0) first = 0;
+    if (last > GRID_VERTICAL_SIZE - 1) last = GRID_VERTICAL_SIZE - 1;
+
+    for (int j = first; j <= last; j++) hash ^= HashRow(j, (board->rows[FULL][j] | board->rows[FADING][j]) & GAME_COLUMNS);
+
+    return hash;
+}
+
+static unsigned long long HashActivePiece(const GameBoard *board)
+{
+    PiecePosition position = { board->pieceType, board->pieceRotation, board->piecePositionX, board->piecePositionY };
+
+    return HashFallingPiece(position);
+}
+
+// SplitMix64 step of the board's own state, like the game
+static int GetBoardRandomValue(int min, int max)
+{
+    if (max < min)
+    {
+        int swap = max;
+        max = min;
+        min = swap;
+    }
+
+    unsigned long long z = (*randomState += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+    z ^= z >> 31;
+
+    return min + (int)(z%((unsigned long long)max - min + 1));
+}
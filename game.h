@@ -0,0 +1,79 @@
+/*******************************************************************************************
+*
+*   tetris42 - game logic on match instances
+*
+*   The rules of UpdateGame() with the state of a match in one struct instead of the
+*   game's globals, so a process can step any number of matches on any thread. Squares
+*   are kept as one row mask per square state and every grid scan of the game becomes a
+*   few mask operations per row, quirks included: turns refused by the checker still
+*   stamp the piece again, the piece moves and stamps in the frame it locked, squares
+*   left in the walls stay there and lines only go when their first square is fading.
+*
+*   The one difference: a square moved right out of the grid lands on the wall of the
+*   next board in the game, here it is dropped and boards never touch each other.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef GAME_H
+#define GAME_H
+
+#include "engine.h"
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define GAME_BOARDS             4
+#define GAME_SQUARE_STATES      (FADING + 1)
+#define GAME_COLUMNS            (BOARD_FULL_ROW & ~BOARD_WALLS)   // Columns the game scans, 1 to 10
+#define GAME_GRAVITY_SPEED      30
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+// A board of the game, fields named after its globals
+typedef struct GameBoard {
+    unsigned short rows[GAME_SQUARE_STATES][GRID_VERTICAL_SIZE];   // Per GridSquare, bit i is column i, EMPTY rows unused
+    int pieceType;
+    int pieceRotation;
+    int incomingType;
+    int piecePositionX;
+    int piecePositionY;
+    unsigned long long positionHash;
+    unsigned long long randomState;
+    bool gameOver;
+    bool beginPlay;
+    bool pieceActive;
+    bool detection;
+    bool lineToDelete;
+    int level;
+    int lines;
+    int gravityMovementCounter;
+    int lateralMovementCounter;
+    int turnMovementCounter;
+    int fastFallMovementCounter;
+    int fadeLineCounter;
+} GameBoard;
+
+typedef struct GameMatch {
+    GameBoard board[GAME_BOARDS];
+    int players;                        // Boards 0 to players - 1, board 1 alone for one player like the game
+    bool pause;
+    int gravitySpeed;
+    unsigned long long randomSeed;
+    unsigned int tick;
+} GameMatch;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+void InitGameMatch(GameMatch *match, int players, unsigned long long randomSeed);  // Boards of the players start like in main()
+void InitGameBoard(GameMatch *match, int board);        // InitGame()
+void StepGameBoard(const PieceSet *set, GameMatch *match, int board, const BoardInput *input);  // UpdateGame()
+void StepGameMatch(const PieceSet *set, GameMatch *match, const BoardInput *input);  // UpdateFrame(), input per board
+GridSquare GetGameSquare(const GameBoard *board, int i, int j);
+
+#endif // GAME_H
@@ -0,0 +1,258 @@
+/*******************************************************************************************
+*
+*   tetris42 - best move hints
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#if defined(__linux__)
+    #define _GNU_SOURCE         // SCHED_IDLE
+#endif
+
+#include "hint.h"
+#include "bot.h"
+#include "zobrist.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define HINT_WAIT_TIME          20      // Milliseconds, bounds a missed wake up
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+// Written by the game only, read with the sequence checked before and after
+typedef struct HintRequest {
+    _Atomic unsigned int sequence;                      // Odd while the game writes it
+    _Atomic unsigned short rows[GRID_VERTICAL_SIZE];
+    _Atomic int start;                                  // Packed piece position
+    _Atomic int incoming;
+} HintRequest;
+
+// Search thread copy of a request
+typedef struct HintWork {
+    int board;
+    unsigned int sequence;
+    Board stack;
+    PiecePosition start;
+    int incoming;
+    int depth;                                          // Deepest search published
+} HintWork;
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static const PieceSet *hintSet = NULL;
+static PositionCache hintCache = { 0 };
+
+static HintRequest requests[HINT_BOARDS];
+static _Atomic unsigned long long slots[HINT_BOARDS];   // Sequence, depth and packed placement
+static _Atomic unsigned int wakeCount = 0;
+static _Atomic bool running = false;
+
+static pthread_t thread;
+static pthread_mutex_t wakeMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeCondition = PTHREAD_COND_INITIALIZER;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static void *HintWorker(void *data);
+static bool ReadRequest(int board, HintWork *work);
+static bool IsRequestStale(void *data);
+static int PackPosition(PiecePosition position);
+static PiecePosition UnpackPosition(int packed);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// Start the search thread
+bool InitHints(const PieceSet *set, int cacheMegabytes)
+{
+    hintSet = set;
+    if (cacheMegabytes > 0) InitPositionCache(&hintCache, cacheMegabytes);
+
+    atomic_store(&running, true);
+
+    if (pthread_create(&thread, NULL, HintWorker, NULL) != 0)
+    {
+        atomic_store(&running, false);
+        UnloadPositionCache(&hintCache);
+
+        return false;
+    }
+
+#if defined(__linux__)
+    // Only use time the game leaves, however deep the search goes
+    struct sched_param param = { 0 };
+    pthread_setschedparam(thread, SCHED_IDLE, &param);
+#endif
+
+    return true;
+}
+
+// Stop the search thread
+void UnloadHints(void)
+{
+    if (!atomic_load(&running)) return;
+
+    atomic_store(&running, false);
+
+    pthread_mutex_lock(&wakeMutex);
+    pthread_cond_signal(&wakeCondition);
+    pthread_mutex_unlock(&wakeMutex);
+
+    pthread_join(thread, NULL);
+    UnloadPositionCache(&hintCache);
+}
+
+// New piece on a board, the search restarts from it, never blocks
+void RequestHint(int board, const Board *stack, PiecePosition start, int incoming)
+{
+    HintRequest *request = &requests[board];
+    unsigned int sequence = atomic_load_explicit(&request->sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&request->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++) atomic_store_explicit(&request->rows[j], stack->rows[j], memory_order_relaxed);
+    atomic_store_explicit(&request->start, PackPosition(start), memory_order_relaxed);
+    atomic_store_explicit(&request->incoming, incoming, memory_order_relaxed);
+
+    atomic_store_explicit(&request->sequence, sequence + 2, memory_order_release);
+    atomic_fetch_add_explicit(&wakeCount, 1, memory_order_release);
+
+    // A busy lock means the thread is awake, at worst it sleeps until the wait times out
+    if (pthread_mutex_trylock(&wakeMutex) == 0)
+    {
+        pthread_cond_signal(&wakeCondition);
+        pthread_mutex_unlock(&wakeMutex);
+    }
+}
+
+// Best placement found so far for the last piece requested
+bool GetHint(int board, PiecePosition *position, int *depth)
+{
+    unsigned long long slot = atomic_load_explicit(&slots[board], memory_order_acquire);
+    unsigned int sequence = atomic_load_explicit(&requests[board].sequence, memory_order_relaxed);
+
+    if ((slot == 0) || ((unsigned int)(slot >> 32) != sequence)) return false;
+
+    *position = UnpackPosition((int)(slot & 0xffffff));
+    if (depth != NULL) *depth = (int)((slot >> 24) & 0xff);
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+// Search the shallowest hint next, so every board gets a quick answer first
+static void *HintWorker(void *data)
+{
+    (void)data;
+
+    HintWork work[HINT_BOARDS] = { 0 };
+
+    for (int b = 0; b < HINT_BOARDS; b++) work[b].board = b;
+
+    while (atomic_load(&running))
+    {
+        unsigned int wake = atomic_load_explicit(&wakeCount, memory_order_acquire);
+        HintWork *next = NULL;
+
+        for (int b = 0; b < HINT_BOARDS; b++)
+        {
+            unsigned int sequence = atomic_load_explicit(&requests[b].sequence, memory_order_acquire);
+
+            if ((sequence != work[b].sequence) && ReadRequest(b, &work[b])) work[b].depth = 0;
+
+            if ((work[b].sequence != 0) && (work[b].depth < BOT_MAX_DEPTH) &&
+                ((next == NULL) || (work[b].depth < next->depth))) next = &work[b];
+        }
+
+        if (next == NULL)
+        {
+            struct timespec until;
+
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += HINT_WAIT_TIME*1000000L;
+            if (until.tv_nsec >= 1000000000L)
+            {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+
+            pthread_mutex_lock(&wakeMutex);
+            if (atomic_load(&running) && (atomic_load(&wakeCount) == wake)) pthread_cond_timedwait(&wakeCondition, &wakeMutex, &until);
+            pthread_mutex_unlock(&wakeMutex);
+
+            continue;
+        }
+
+        int queue[BOT_MAX_DEPTH] = { next->start.type, next->incoming, BOT_ANY_PIECE };
+        Placement best;
+
+        if (SearchPlacement(hintSet, (hintCache.entries != NULL)? &hintCache : NULL, &next->stack, next->start,
+                            queue, next->depth + 1, IsRequestStale, next, &best))
+        {
+            next->depth++;
+            atomic_store_explicit(&slots[next->board], ((unsigned long long)next->sequence << 32) |
+                                  ((unsigned long long)next->depth << 24) | (unsigned long long)PackPosition(best.position),
+                                  memory_order_release);
+        }
+        else if (!IsRequestStale(next)) next->depth = BOT_MAX_DEPTH;    // Nowhere to place the piece
+    }
+
+    return NULL;
+}
+
+// Copy a request, fails when the game wrote it meanwhile
+static bool ReadRequest(int board, HintWork *work)
+{
+    HintRequest *request = &requests[board];
+    unsigned int sequence = atomic_load_explicit(&request->sequence, memory_order_acquire);
+
+    if (sequence & 1) return false;
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++) work->stack.rows[j] = atomic_load_explicit(&request->rows[j], memory_order_relaxed);
+    int start = atomic_load_explicit(&request->start, memory_order_relaxed);
+    int incoming = atomic_load_explicit(&request->incoming, memory_order_relaxed);
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&request->sequence, memory_order_relaxed) != sequence) return false;
+
+    work->sequence = sequence;
+    work->stack.hash = HashBoard(&work->stack);
+    work->start = UnpackPosition(start);
+    work->incoming = (incoming >= 0)? incoming : BOT_ANY_PIECE;
+
+    return true;
+}
+
+// Abort a search once its piece is gone
+static bool IsRequestStale(void *data)
+{
+    const HintWork *work = (const HintWork *)data;
+
+    return !atomic_load_explicit(&running, memory_order_relaxed) ||
+           (atomic_load_explicit(&requests[work->board].sequence, memory_order_relaxed) != work->sequence);
+}
+
+static int PackPosition(PiecePosition position)
+{
+    return (position.type << 12) | (position.rotation << 10) | ((position.x + PIECE_MAX_SIZE) << 5) | position.y;
+}
+
+static PiecePosition UnpackPosition(int packed)
+{
+    PiecePosition position = { (packed >> 12) & 0x3f, (packed >> 10) & 0x3, ((packed >> 5) & 0x1f) - PIECE_MAX_SIZE, packed & 0x1f };
+
+    return position;
+}
@@ -0,0 +1,37 @@
+/*******************************************************************************************
+*
+*   tetris42 - best move hints
+*
+*   A background thread searches the placement of every new piece, deeper and deeper
+*   while the piece falls: the current piece alone, then with the incoming piece, then
+*   with the piece after it. Requests go in through a per board seqlock and every finished
+*   search is published in a single 64 bit slot, so the game only copies a few words when
+*   a piece appears and reads one word to draw. Nothing on the frame path waits for it.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef HINT_H
+#define HINT_H
+
+#include "engine.h"
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define HINT_BOARDS             4
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+bool InitHints(const PieceSet *set, int cacheMegabytes);    // Start the search thread
+void UnloadHints(void);                                     // Stop the search thread
+
+// New piece on a board, the search restarts from it, never blocks
+void RequestHint(int board, const Board *stack, PiecePosition start, int incoming);
+bool GetHint(int board, PiecePosition *position, int *depth);   // Best placement found so far
+
+#endif // HINT_H
@@ -0,0 +1,220 @@
+/*******************************************************************************************
+*
+*   tetris42 - cached HUD labels
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "hud.h"
+#include "memtrack.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define HUD_FIRST_CHAR          32      // Printable ASCII only, others are drawn as '?'
+#define HUD_CHARS               95
+#define HUD_ATLAS_WIDTH         1024
+#define HUD_MIN_FONT_SIZE       10      // Same limit as DrawText()
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct HudFont {
+    int fontSize;                       // 0 when not baked
+    int spacing;
+    Texture2D texture;
+    Rectangle recs[HUD_CHARS];
+} HudFont;
+
+typedef struct HudLabel {
+    const char *key;                    // Text or format, with value and font size
+    int value;
+    int fontSize;                       // 0 when not laid out
+    int font;
+    int width;
+    int length;
+    unsigned char glyph[HUD_TEXT_SIZE];
+    short offsetX[HUD_TEXT_SIZE];
+} HudLabel;
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static HudFont fonts[HUD_FONTS] = { 0 };
+static HudLabel labels[HUD_LABELS] = { 0 };
+static int nextFont = 0;                // Replaced next when all fonts are in use
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static int GetHudFont(int fontSize);
+static HudLabel *LayoutLabel(int id, const char *key, const char *text, int value, int fontSize);
+static void DrawLabel(const HudLabel *label, int posX, int posY, Color color);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// Bake glyphs of a size, scaled from the default font like DrawText() scales them
+void LoadHudFont(int fontSize)
+{
+    GetHudFont(fontSize);
+}
+
+// Unload all fonts and labels
+void UnloadHud(void)
+{
+    for (int f = 0; f < HUD_FONTS; f++)
+    {
+        if (fonts[f].fontSize != 0)
+        {
+            UnloadTexture(fonts[f].texture);
+            TrackGpuResources(-1);
+        }
+        fonts[f].fontSize = 0;
+    }
+
+    for (int l = 0; l < HUD_LABELS; l++) labels[l].fontSize = 0;
+}
+
+void DrawHudText(int id, const char *text, int posX, int posY, int fontSize, Color color)
+{
+    DrawLabel(LayoutLabel(id, text, text, 0, fontSize), posX, posY, color);
+}
+
+void DrawHudTextCentered(int id, const char *text, int centerX, int posY, int fontSize, Color color)
+{
+    HudLabel *label = LayoutLabel(id, text, text, 0, fontSize);
+
+    DrawLabel(label, centerX - label->width/2, posY, color);
+}
+
+// Formatted again only when the value changes
+void DrawHudNumber(int id, const char *format, int value, int posX, int posY, int fontSize, Color color)
+{
+    HudLabel *label = &labels[id%HUD_LABELS];
+
+    if ((label->fontSize == 0) || (label->key != format) || (label->value != value) || (label->fontSize != fontSize))
+    {
+        char text[HUD_TEXT_SIZE];
+
+        snprintf(text, HUD_TEXT_SIZE, format, value);
+        label = LayoutLabel(id, format, text, value, fontSize);
+    }
+
+    DrawLabel(label, posX, posY, color);
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+// Find or bake the font of a size
+static int GetHudFont(int fontSize)
+{
+    if (fontSize < HUD_MIN_FONT_SIZE) fontSize = HUD_MIN_FONT_SIZE;
+
+    for (int f = 0; f < HUD_FONTS; f++)
+    {
+        if (fonts[f].fontSize == fontSize) return f;
+    }
+
+    int f = nextFont;
+    HudFont *font = &fonts[f];
+
+    nextFont = (nextFont + 1)%HUD_FONTS;
+
+    // Labels laid out with the replaced font are laid out again
+    if (font->fontSize != 0)
+    {
+        UnloadTexture(font->texture);
+        TrackGpuResources(-1);
+        for (int l = 0; l < HUD_LABELS; l++) if (labels[l].font == f) labels[l].fontSize = 0;
+    }
+
+    Font base = GetFontDefault();
+    Image glyphs[HUD_CHARS];
+    int x = 0;
+    int y = 0;
+    int rowHeight = 0;
+
+    font->fontSize = fontSize;
+    font->spacing = fontSize/HUD_MIN_FONT_SIZE;
+
+    // Glyphs packed in rows, one pixel apart
+    for (int g = 0; g < HUD_CHARS; g++)
+    {
+        char text[2] = { (char)(HUD_FIRST_CHAR + g), '\0' };
+
+        glyphs[g] = ImageTextEx(base, text, (float)fontSize, (float)font->spacing, WHITE);
+
+        if (x + glyphs[g].width > HUD_ATLAS_WIDTH)
+        {
+            x = 0;
+            y += rowHeight + 1;
+            rowHeight = 0;
+        }
+
+        font->recs[g] = (Rectangle){ (float)x, (float)y, (float)glyphs[g].width, (float)glyphs[g].height };
+        x += glyphs[g].width + 1;
+        if (glyphs[g].height > rowHeight) rowHeight = glyphs[g].height;
+    }
+
+    Image atlas = GenImageColor(HUD_ATLAS_WIDTH, y + rowHeight, BLANK);
+
+    for (int g = 0; g < HUD_CHARS; g++)
+    {
+        ImageDraw(&atlas, glyphs[g], (Rectangle){ 0, 0, font->recs[g].width, font->recs[g].height }, font->recs[g], WHITE);
+        UnloadImage(glyphs[g]);
+    }
+
+    font->texture = LoadTextureFromImage(atlas);
+    TrackGpuResources(1);
+    UnloadImage(atlas);
+
+    return f;
+}
+
+// Glyphs and their offsets, advanced like DrawTextEx() does
+static HudLabel *LayoutLabel(int id, const char *key, const char *text, int value, int fontSize)
+{
+    HudLabel *label = &labels[id%HUD_LABELS];
+
+    if ((label->fontSize != 0) && (label->key == key) && (label->value == value) && (label->fontSize == fontSize)) return label;
+
+    int f = GetHudFont(fontSize);
+    int x = 0;
+
+    label->key = key;
+    label->value = value;
+    label->fontSize = fontSize;
+    label->font = f;
+    label->length = 0;
+
+    for (int c = 0; (text[c] != '\0') && (c < HUD_TEXT_SIZE); c++)
+    {
+        int g = (unsigned char)text[c] - HUD_FIRST_CHAR;
+
+        if ((g < 0) || (g >= HUD_CHARS)) g = '?' - HUD_FIRST_CHAR;
+
+        label->glyph[label->length] = (unsigned char)g;
+        label->offsetX[label->length++] = (short)x;
+        x += (int)fonts[f].recs[g].width + fonts[f].spacing;
+    }
+
+    label->width = (label->length > 0)? x - fonts[f].spacing : 0;
+
+    return label;
+}
+
+static void DrawLabel(const HudLabel *label, int posX, int posY, Color color)
+{
+    const HudFont *font = &fonts[label->font];
+
+    for (int c = 0; c < label->length; c++)
+    {
+        DrawTextureRec(font->texture, font->recs[label->glyph[c]], (Vector2){ (float)(posX + label->offsetX[c]), (float)posY }, color);
+    }
+}
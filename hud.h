@@ -0,0 +1,38 @@
+/*******************************************************************************************
+*
+*   tetris42 - cached HUD labels
+*
+*   Glyphs of the default font are baked once into an atlas per font size, scaled like
+*   DrawText() would scale them. A label is formatted and laid out only when its text,
+*   value or size changes, every frame it is a run of quads from one atlas texture, so the
+*   whole HUD of a size batches into one draw call.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef HUD_H
+#define HUD_H
+
+#include "raylib.h"
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define HUD_LABELS              256     // Labels cached at the same time, by id
+#define HUD_BOARD_LABELS        4       // Ids of board b start at b*HUD_BOARD_LABELS
+#define HUD_FONTS               8       // Font sizes baked at the same time
+#define HUD_TEXT_SIZE           64
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+void LoadHudFont(int fontSize);         // Bake glyphs of a size, sizes not baked are baked on first use
+void UnloadHud(void);                   // Unload all fonts and labels
+
+// Text must not change in place, a new text pointer or value lays the label out again
+void DrawHudText(int id, const char *text, int posX, int posY, int fontSize, Color color);
+void DrawHudTextCentered(int id, const char *text, int centerX, int posY, int fontSize, Color color);
+void DrawHudNumber(int id, const char *format, int value, int posX, int posY, int fontSize, Color color);
+
+#endif // HUD_H
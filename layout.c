@@ -0,0 +1,57 @@
+/*******************************************************************************************
+*
+*   tetris42 - board layout
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "layout.h"
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// Tile boards row by row, returns square size
+int LayoutBoards(int count, int width, int height, BoardTile *tiles)
+{
+    int columns = 1;
+    int squareSize = 0;
+
+    if (count <= 0) return 0;
+
+    // Column count with the biggest squares, margins go around every tile
+    for (int c = 1; c <= count; c++)
+    {
+        int rows = (count + c - 1)/c;
+        int sizeX = width/(c*(TILE_WIDTH + TILE_MARGIN) + TILE_MARGIN);
+        int sizeY = height/(rows*(TILE_HEIGHT + TILE_MARGIN) + TILE_MARGIN);
+        int size = (sizeX < sizeY)? sizeX : sizeY;
+
+        if (size > squareSize)
+        {
+            squareSize = size;
+            columns = c;
+        }
+    }
+
+    if (squareSize < 1) squareSize = 1;
+
+    int rows = (count + columns - 1)/columns;
+    int pitchX = (TILE_WIDTH + TILE_MARGIN)*squareSize;
+    int pitchY = (TILE_HEIGHT + TILE_MARGIN)*squareSize;
+    int top = (height - rows*pitchY + TILE_MARGIN*squareSize)/2;
+
+    for (int b = 0; b < count; b++)
+    {
+        int row = b/columns;
+        int inRow = (row < rows - 1)? columns : count - row*columns;
+        int left = (width - inRow*pitchX + TILE_MARGIN*squareSize)/2;
+
+        tiles[b].x = left + (b%columns)*pitchX;
+        tiles[b].y = top + row*pitchY;
+        tiles[b].squareSize = squareSize;
+        tiles[b].detail = (squareSize < LOW_DETAIL_SQUARE_SIZE)? DETAIL_LOW : DETAIL_FULL;
+    }
+
+    return squareSize;
+}
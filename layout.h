@@ -0,0 +1,46 @@
+/*******************************************************************************************
+*
+*   tetris42 - board layout
+*
+*   Tiles any number of boards over the screen: the column count giving the biggest
+*   squares wins, rows are centered and the last row is centered on its own. Tiles with
+*   small squares are drawn with a low level of detail.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "tetris42.h"
+#include "pieces.h"
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+// Board tile in squares: grid, one square gap and the incoming piece box
+#define TILE_WIDTH              (GRID_HORIZONTAL_SIZE + 1 + PIECE_MAX_SIZE)
+#define TILE_HEIGHT             GRID_VERTICAL_SIZE
+#define TILE_MARGIN             1
+
+#define LOW_DETAIL_SQUARE_SIZE  16      // Smaller squares drop grid lines and most text
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef enum BoardDetail { DETAIL_FULL = 0, DETAIL_LOW } BoardDetail;
+
+typedef struct BoardTile {
+    int x;                      // Top left corner of the grid
+    int y;
+    int squareSize;
+    BoardDetail detail;
+} BoardTile;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+int LayoutBoards(int count, int width, int height, BoardTile *tiles);  // Returns square size
+
+#endif // LAYOUT_H
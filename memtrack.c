@@ -0,0 +1,121 @@
+/*******************************************************************************************
+*
+*   tetris42 - allocation tracking
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "memtrack.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+// Wrapped calls are counted once, by the wrappers
+#if defined(SUPPORT_MALLOC_WRAP)
+    #define COUNT_CALL(counter)     ((void)0)
+#else
+    #define COUNT_CALL(counter)     atomic_fetch_add_explicit(&(counter), 1, memory_order_relaxed)
+#endif
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+// raylib may allocate on its audio thread
+static atomic_ullong allocations = 0;
+static atomic_ullong reallocations = 0;
+static atomic_ullong frees = 0;
+static atomic_llong gpuResources = 0;
+
+#if defined(SUPPORT_MALLOC_WRAP)
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+// The C library's functions, calls of malloc() and friends are linked to the wrappers
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void __real_free(void *pointer);
+#endif
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+void *TrackedMalloc(size_t size)
+{
+    COUNT_CALL(allocations);
+
+    return malloc(size);
+}
+
+void *TrackedCalloc(size_t count, size_t size)
+{
+    COUNT_CALL(allocations);
+
+    return calloc(count, size);
+}
+
+void *TrackedRealloc(void *pointer, size_t size)
+{
+    if (pointer == NULL) COUNT_CALL(allocations);
+    else COUNT_CALL(reallocations);
+
+    return realloc(pointer, size);
+}
+
+void TrackedFree(void *pointer)
+{
+    if (pointer != NULL) COUNT_CALL(frees);
+
+    free(pointer);
+}
+
+#if defined(SUPPORT_MALLOC_WRAP)
+void *__wrap_malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size)
+{
+    atomic_fetch_add_explicit((pointer == NULL)? &allocations : &reallocations, 1, memory_order_relaxed);
+
+    return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void *pointer)
+{
+    if (pointer != NULL) atomic_fetch_add_explicit(&frees, 1, memory_order_relaxed);
+
+    __real_free(pointer);
+}
+#endif
+
+void TrackGpuResources(int change)
+{
+    atomic_fetch_add_explicit(&gpuResources, change, memory_order_relaxed);
+}
+
+MemoryCounters GetMemoryCounters(void)
+{
+    MemoryCounters counters;
+
+    counters.allocations = atomic_load_explicit(&allocations, memory_order_relaxed);
+    counters.reallocations = atomic_load_explicit(&reallocations, memory_order_relaxed);
+    counters.frees = atomic_load_explicit(&frees, memory_order_relaxed);
+    counters.gpuResources = atomic_load_explicit(&gpuResources, memory_order_relaxed);
+
+    return counters;
+}
@@ -0,0 +1,60 @@
+/*******************************************************************************************
+*
+*   tetris42 - allocation tracking
+*
+*   The CMake build includes this header first in every source file, raylib's included, so
+*   RL_MALLOC(), RL_CALLOC(), RL_REALLOC() and RL_FREE() count their calls before they call
+*   the C library. Only calls are counted, raylib may free memory the C library allocated.
+*   Linked with GNU ld's --wrap for malloc, calloc, realloc and free (SUPPORT_MALLOC_WRAP,
+*   the Linux build) every call of the game and raylib is counted instead; calls inside
+*   the C library (strdup(), fopen()) and shared libraries like the GPU driver are not.
+*   GPU resources are counted where the game loads and unloads them.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+
+#include <stddef.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+// raylib.h keeps these when they are defined before it
+#if !defined(RL_MALLOC)
+    #define RL_MALLOC(sz)           TrackedMalloc(sz)
+    #define RL_CALLOC(n, sz)        TrackedCalloc(n, sz)
+    #define RL_REALLOC(ptr, sz)     TrackedRealloc(ptr, sz)
+    #define RL_FREE(ptr)            TrackedFree(ptr)
+#endif
+
+// What the allocation counters hold
+#if defined(SUPPORT_MALLOC_WRAP)
+    #define TRACKED_ALLOCATIONS     "heap allocations"
+#else
+    #define TRACKED_ALLOCATIONS     "raylib allocations"
+#endif
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct MemoryCounters {
+    unsigned long long allocations;     // Also reallocations of NULL
+    unsigned long long reallocations;
+    unsigned long long frees;           // Of pointers other than NULL
+    long long gpuResources;             // Textures and render textures loaded
+} MemoryCounters;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+void *TrackedMalloc(size_t size);
+void *TrackedCalloc(size_t count, size_t size);
+void *TrackedRealloc(void *pointer, size_t size);
+void TrackedFree(void *pointer);
+void TrackGpuResources(int change);         // Loaded ones count 1, unloaded -1
+MemoryCounters GetMemoryCounters(void);
+
+#endif // MEMTRACK_H
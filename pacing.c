@@ -0,0 +1,256 @@
+/*******************************************************************************************
+*
+*   tetris42 - frame pacing
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "pacing.h"
+
+#include "raylib.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define PACING_WINDOW           120         // Frames between frame delay tunings
+#define PACING_MARGIN           1.5         // Milliseconds kept after the 95th percentile of update and draw
+#define PACING_MARGIN_STEP      0.5         // Milliseconds added to the margin for every missed blank
+#define PACING_MAX_MARGIN       6.0
+#define PACING_BUCKET_TIME      0.05        // Milliseconds per histogram bucket
+#define PACING_BUCKETS          2000        // The last one holds 100 ms and longer
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static PacingMode pacingMode = PACING_CLASSIC;
+static int refreshRate = 0;
+static bool autoDelay = true;
+static double period = 1.0/60;          // Seconds
+static double frameDelay = 0;           // Seconds from the blank to polling input
+static double margin = PACING_MARGIN/1000;
+
+static double frameEnd = 0;             // When the last frame was swapped and waited for
+static double inputTime = 0;            // When input of the current frame was polled
+static bool blocked = false;            // Polling waited for events, the frame is not measured
+static float pacedFrameTime = 0;
+
+static double workTimes[PACING_WINDOW] = { 0 };  // Poll to drawn, seconds
+static int workCount = 0;
+static bool windowMissed = false;       // A blank was missed since the last tuning
+
+static unsigned int frames = 0;
+static double frameTimeSum = 0;
+static double frameTimeSquares = 0;
+static unsigned int missedBlanks = 0;
+static unsigned int jitterBuckets[PACING_BUCKETS] = { 0 };
+static unsigned int latencies = 0;
+static double latencySum = 0;
+static unsigned int latencyBuckets[PACING_BUCKETS] = { 0 };
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+#if defined(SUPPORT_CUSTOM_FRAME_CONTROL)
+static void WaitUntil(double time);
+#endif
+static void CountBucket(unsigned int *buckets, double time);
+static double GetBucketPercentile(const unsigned int *buckets, unsigned int count, double fraction);
+static int CompareTimes(const void *a, const void *b);
+static void TuneFrameDelay(void);
+
+//------------------------------------------------------------------------------------
+// Module Functions Definition
+//------------------------------------------------------------------------------------
+void InitPacing(PacingMode mode, int frameRate, float delay)
+{
+    period = 1.0/frameRate;
+    refreshRate = GetMonitorRefreshRate(GetCurrentMonitor());
+    autoDelay = (delay < 0);
+    frameDelay = autoDelay? 0 : fmin(delay/1000.0, period);
+    pacingMode = mode;
+
+#if defined(SUPPORT_CUSTOM_FRAME_CONTROL)
+    // Game speed is counted in frames, vsync may only set the frame rate it already has
+    if ((pacingMode == PACING_LOW_LATENCY) && (abs(refreshRate - frameRate) > 1))
+    {
+        printf("Low latency needs a %d Hz display, this one runs at %d Hz.\n", frameRate, refreshRate);
+        pacingMode = PACING_CLASSIC;
+    }
+
+    if (pacingMode == PACING_LOW_LATENCY) SetWindowState(FLAG_VSYNC_HINT);
+    SetTargetFPS(0);
+#else
+    if (pacingMode == PACING_LOW_LATENCY)
+    {
+        printf("Low latency needs raylib built with SUPPORT_CUSTOM_FRAME_CONTROL.\n");
+        pacingMode = PACING_CLASSIC;
+    }
+
+    SetTargetFPS(frameRate);
+#endif
+
+    frameEnd = GetTime();
+}
+
+void BeginPacedFrame(void)
+{
+#if defined(SUPPORT_CUSTOM_FRAME_CONTROL)
+    if (pacingMode == PACING_LOW_LATENCY) WaitUntil(frameEnd + frameDelay);
+
+    double pollTime = GetTime();
+
+    // Waits for events when they are enabled
+    PollInputEvents();
+    inputTime = GetTime();
+    blocked = (inputTime - pollTime > period/2);
+#else
+    // EndDrawing() polled at the end of the last frame
+    inputTime = frameEnd;
+    blocked = false;
+#endif
+}
+
+void EndPacedFrame(void)
+{
+    double drawnTime = GetTime();
+    double swapTime = drawnTime;
+    double now = drawnTime;
+
+#if defined(SUPPORT_CUSTOM_FRAME_CONTROL)
+    // Returns at the blank with vsync
+    SwapScreenBuffer();
+    swapTime = GetTime();
+    if (pacingMode == PACING_CLASSIC) WaitUntil(frameEnd + period);
+    now = GetTime();
+#endif
+
+    double frameTime = now - frameEnd;
+
+    pacedFrameTime = (float)frameTime;
+    frameEnd = now;
+
+    // The first frame and frames that waited for events have no meaningful timing
+    if ((inputTime == 0) || blocked) return;
+
+    frames++;
+    frameTimeSum += frameTime;
+    frameTimeSquares += frameTime*frameTime;
+    CountBucket(jitterBuckets, fabs(frameTime - period));
+
+    if (pacingMode == PACING_LOW_LATENCY)
+    {
+        if (frameTime > 1.5*period)
+        {
+            missedBlanks++;
+            windowMissed = true;
+            margin = fmin(margin + PACING_MARGIN_STEP/1000, PACING_MAX_MARGIN/1000);
+        }
+
+        workTimes[workCount++] = drawnTime - inputTime;
+        if (workCount == PACING_WINDOW)
+        {
+            // The margin shrinks back after a window without misses
+            if (!windowMissed) margin = fmax(margin - PACING_MARGIN_STEP/1000, PACING_MARGIN/1000);
+            if (autoDelay) TuneFrameDelay();
+            workCount = 0;
+            windowMissed = false;
+        }
+    }
+
+#if defined(SUPPORT_CUSTOM_FRAME_CONTROL)
+    // Waiting to be polled, poll to the blank the frame is shown at, scanout to the middle of the screen
+    double latency = period/2 + (swapTime - inputTime) + period/2;
+
+    if (pacingMode == PACING_CLASSIC) latency += period/2;
+
+    latencies++;
+    latencySum += latency;
+    CountBucket(latencyBuckets, latency);
+#else
+    (void)swapTime;
+#endif
+}
+
+float GetPacedFrameTime(void)
+{
+    return pacedFrameTime;
+}
+
+void ReportPacing(void)
+{
+    if (frames == 0) return;
+
+    double average = frameTimeSum/frames;
+    double deviation = sqrt(fmax(frameTimeSquares/frames - average*average, 0));
+
+    if (pacingMode == PACING_LOW_LATENCY) printf("Pacing low latency at %d Hz, frame delay %.1f ms%s\n", refreshRate, 1000*frameDelay, autoDelay? " (auto)" : "");
+    else printf("Pacing classic at %.0f fps on a %d Hz display\n", 1/period, refreshRate);
+
+    if (latencies > 0)
+    {
+        printf("Input to photon %.1f ms average, %.1f ms p99 (estimated)\n", 1000*latencySum/latencies, GetBucketPercentile(latencyBuckets, latencies, 0.99));
+    }
+
+    printf("Frame time %.2f ms average, jitter %.2f ms std dev, %.2f ms p99, %u missed blanks\n",
+           1000*average, 1000*deviation, GetBucketPercentile(jitterBuckets, frames, 0.99), missedBlanks);
+}
+
+//------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//------------------------------------------------------------------------------------
+#if defined(SUPPORT_CUSTOM_FRAME_CONTROL)
+static void WaitUntil(double time)
+{
+    double wait = time - GetTime();
+
+    if (wait > 0) WaitTime(wait);
+}
+#endif
+
+static void CountBucket(unsigned int *buckets, double time)
+{
+    int bucket = (int)(1000*time/PACING_BUCKET_TIME);
+
+    buckets[(bucket < PACING_BUCKETS)? bucket : PACING_BUCKETS - 1]++;
+}
+
+// Milliseconds at the upper edge of the bucket the fraction falls in
+static double GetBucketPercentile(const unsigned int *buckets, unsigned int count, double fraction)
+{
+    unsigned int rank = (unsigned int)ceil(fraction*count);
+    unsigned int total = 0;
+
+    for (int b = 0; b < PACING_BUCKETS; b++)
+    {
+        total += buckets[b];
+        if (total >= rank) return (b + 1)*PACING_BUCKET_TIME;
+    }
+
+    return PACING_BUCKETS*PACING_BUCKET_TIME;
+}
+
+static int CompareTimes(const void *a, const void *b)
+{
+    double difference = *(const double *)a - *(const double *)b;
+
+    return (difference > 0) - (difference < 0);
+}
+
+// Poll as late as the slowest 5% of frames still make the next blank with the margin to spare
+static void TuneFrameDelay(void)
+{
+    double sorted[PACING_WINDOW];
+
+    memcpy(sorted, workTimes, sizeof(sorted));
+    qsort(sorted, PACING_WINDOW, sizeof(sorted[0]), CompareTimes);
+
+    double delay = period - sorted[PACING_WINDOW*95/100] - margin;
+
+    frameDelay = fmax(0, fmin(delay, period - margin));
+}
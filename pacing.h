@@ -0,0 +1,49 @@
+/*******************************************************************************************
+*
+*   tetris42 - frame pacing
+*
+*   With raylib built with SUPPORT_CUSTOM_FRAME_CONTROL (the CMake build does) EndDrawing()
+*   only draws, and the loop swaps buffers, waits and polls input between BeginPacedFrame()
+*   and EndPacedFrame() itself:
+*       classic         swap, wait out the frame like SetTargetFPS(), poll input
+*       low latency     swap with vsync, wait the frame delay after the blank, poll input,
+*                       so input is sampled as late as update and draw allow
+*   The frame delay is given or tuned every 2 seconds from the 95th percentile of update
+*   and draw time plus a margin, which grows with every missed blank and shrinks back after
+*   2 seconds without one. Low latency needs a display running at the frame rate, on others
+*   the game stays classic so its speed does not change. Without custom frame control
+*   raylib does all of it in EndDrawing().
+*
+*   Input to photon is estimated per frame: half a frame of waiting to be polled, poll to
+*   the blank the frame is shown at (a compositor blank half a frame after the swap on
+*   average without vsync) and half a frame of scanout to the middle of the screen.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef PACING_H
+#define PACING_H
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define PACING_AUTO_DELAY       -1.0f
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef enum PacingMode { PACING_CLASSIC = 0, PACING_LOW_LATENCY } PacingMode;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+void InitPacing(PacingMode mode, int frameRate, float frameDelay);  // After InitWindow(), delay in ms or PACING_AUTO_DELAY
+void BeginPacedFrame(void);             // Before update: wait the frame delay and poll input
+void EndPacedFrame(void);               // After drawing: swap buffers, classic waits out the frame
+float GetPacedFrameTime(void);          // Seconds between the last two frames, like GetFrameTime()
+void ReportPacing(void);                // Print input to photon and frame time jitter
+
+#endif // PACING_H
@@ -0,0 +1,374 @@
+/*******************************************************************************************
+*
+*   tetris42 - placement enumerator (perft)
+*
+*   Counts every distinct final placement reachable from a board and a piece queue down
+*   to a given depth, with the movement rules of the game. Subtrees below the first
+*   placements are split between threads and the throughput is reported as placements
+*   (nodes) per second. Known counts (--bench) guard engine rewrites. With --hash, subtree
+*   counts are shared between threads in a position cache and repeated stacks are counted once.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L     // clock_gettime() and sysconf()
+
+#include "engine.h"
+#include "zobrist.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define MAX_DEPTH               16
+#define MAX_THREADS             256
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct PerftJob {
+    const PieceSet *set;
+    PositionCache *cache;               // Subtree counts, NULL when not used
+    const Board *board;
+    const Placement *roots;
+    int rootCount;
+    const int *queue;
+    int depth;
+    unsigned long long *counts;         // Leaf placements below every root placement
+    atomic_int next;                    // Next root placement to take
+    atomic_ullong nodes;                // Placements generated on all depths
+} PerftJob;
+
+typedef struct PerftResult {
+    unsigned long long placements;
+    unsigned long long nodes;
+    double seconds;
+} PerftResult;
+
+// Known counts for --bench, built-in piece set
+typedef struct PerftPosition {
+    const char *board;
+    const char *queue;
+    int depth;
+    unsigned long long placements;
+} PerftPosition;
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static const PerftPosition benchPositions[] = {
+    { "", "Cube,L,Recta,S", 4, 95525 },
+    { "....#...../.##.#..#../.#....###./##.######./#########.", "S_big,f,-L", 3, 34832 },
+    { "........../..##....../.########./.########./##.#######", "U,Recta,L,T", 4, 719567 },
+    // Stack close to the top: game over and spawning over full squares
+    { "......##../.####.###./.#.#.##.##/..#.#.#.../.######.#./##.###.#.#/..#.#.###./#...###.#./"
+      "..#.##..#./######..##/.###..###./##.#....##/#.##...##./#####...##/##..#...../#.##..#...", "Recta,T,L_long", 3, 113 },
+};
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static unsigned long long Perft(const PieceSet *set, PositionCache *cache, const Board *board, const int *queue, int depth, unsigned long long *nodes);
+static void *PerftWorker(void *data);
+static PerftResult RunPerft(const PieceSet *set, PositionCache *cache, const Board *board, const int *queue, int depth, int threads, bool divide);
+static bool ParseBoard(Board *board, const char *rows);
+static int ParseQueue(const PieceSet *set, const char *text, int *queue);
+static double GetSeconds(void);
+
+//------------------------------------------------------------------------------------
+// Program main entry point
+//------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    const char *piecesFile = NULL;
+    const char *boardRows = "";
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int hashSize = 0;
+    bool divide = false;
+    bool bench = false;
+    const char *args[2] = { NULL, NULL };
+    int argCount = 0;
+
+    for (int a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "--pieces") == 0) && (a + 1 < argc)) piecesFile = argv[++a];
+        else if ((strcmp(argv[a], "--board") == 0) && (a + 1 < argc)) boardRows = argv[++a];
+        else if ((strcmp(argv[a], "--threads") == 0) && (a + 1 < argc)) threads = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--hash") == 0) && (a + 1 < argc)) hashSize = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--divide") == 0) divide = true;
+        else if (strcmp(argv[a], "--bench") == 0) bench = true;
+        else if (argCount < 2) args[argCount++] = argv[a];
+    }
+
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    PieceSet *set = malloc(sizeof(PieceSet));
+    PositionCache cache = { 0 };
+
+    InitZobrist();
+
+    if ((hashSize > 0) && !InitPositionCache(&cache, hashSize))
+    {
+        printf("Can not allocate %d MB position cache.\n", hashSize);
+        return 1;
+    }
+
+    if (bench || (piecesFile == NULL)) LoadDefaultPieceSet(set);
+    else if (!LoadPieceSet(set, piecesFile))
+    {
+        printf("Can not load pieces from %s.\n", piecesFile);
+        return 1;
+    }
+
+    if (bench)
+    {
+        int failed = 0;
+        PerftResult total = { 0 };
+
+        for (size_t b = 0; b < sizeof(benchPositions)/sizeof(benchPositions[0]); b++)
+        {
+            const PerftPosition *position = &benchPositions[b];
+            Board board;
+            int queue[MAX_DEPTH];
+
+            ParseBoard(&board, position->board);
+            ParseQueue(set, position->queue, queue);
+
+            // Counts of one position must not answer for another
+            if (cache.entries != NULL)
+            {
+                UnloadPositionCache(&cache);
+                InitPositionCache(&cache, hashSize);
+            }
+
+            PerftResult result = RunPerft(set, (cache.entries != NULL)? &cache : NULL, &board, queue, position->depth, threads, false);
+            bool passed = (result.placements == position->placements);
+
+            printf("%-4s perft %d %-24s %14llu placements %8.3f s\n", passed? "ok" : "FAIL",
+                   position->depth, position->queue, result.placements, result.seconds);
+
+            if (!passed) failed++;
+            total.nodes += result.nodes;
+            total.seconds += result.seconds;
+        }
+
+        printf("%llu nodes in %.3f s, %.0f nodes/s with %d threads\n", total.nodes, total.seconds,
+               total.nodes/total.seconds, threads);
+
+        UnloadPositionCache(&cache);
+        free(set);
+
+        return (failed == 0)? 0 : 1;
+    }
+
+    Board board;
+    int queue[MAX_DEPTH];
+    int depth = (args[0] != NULL)? atoi(args[0]) : 0;
+    int queueLength = (args[1] != NULL)? ParseQueue(set, args[1], queue) : -1;
+
+    if ((depth < 1) || (depth > MAX_DEPTH) || (queueLength < depth) || !ParseBoard(&board, boardRows))
+    {
+        printf("Usage: tetris42-perft [options] <depth> <queue>\n"
+               "  <queue>            piece names separated with ',', at least one per depth\n"
+               "  --pieces <file>    piece set, built-in pieces by default\n"
+               "  --board <rows>     locked squares, rows of %d '#' or '.' separated with '/',\n"
+               "                     the last row lies on the floor\n"
+               "  --threads <n>      worker threads, all cores by default\n"
+               "  --hash <mb>        share subtree counts in a position cache of this size\n"
+               "  --divide           print placements below every first placement\n"
+               "  --bench            run known positions and check their counts\n", GRID_HORIZONTAL_SIZE - 2);
+        return 1;
+    }
+
+    PerftResult result = RunPerft(set, (cache.entries != NULL)? &cache : NULL, &board, queue, depth, threads, divide);
+
+    printf("perft %d: %llu placements, %llu nodes in %.3f s, %.0f nodes/s with %d threads\n", depth,
+           result.placements, result.nodes, result.seconds, result.nodes/result.seconds, threads);
+
+    UnloadPositionCache(&cache);
+    free(set);
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+// Count leaf placements, a placement that ends the game has nothing below it
+static unsigned long long Perft(const PieceSet *set, PositionCache *cache, const Board *board, const int *queue, int depth, unsigned long long *nodes)
+{
+    unsigned long long key = board->hash;
+    unsigned long long data = 0;
+
+    // Same stack with the same pieces to come has the same count, depth is checked too
+    if (cache != NULL)
+    {
+        for (int q = 0; q < depth; q++) key ^= HashQueue(q, queue[q]);
+
+        if (ProbePosition(cache, key, &data) && ((int)(data & 0xff) == depth)) return data >> 8;
+    }
+
+    Placement placements[MAX_PLACEMENTS];
+    Board spawned = *board;
+    int count = GetPlacements(set, &spawned, SpawnPiece(set, &spawned, queue[0]), placements);
+
+    *nodes += count;
+    if (depth == 1) return count;
+
+    unsigned long long leaves = 0;
+
+    for (int p = 0; p < count; p++)
+    {
+        Board child = spawned;
+
+        LockPiece(set, &child, placements[p].position);
+        if (!IsBoardOver(&child)) leaves += Perft(set, cache, &child, queue + 1, depth - 1, nodes);
+    }
+
+    if (cache != NULL) StorePosition(cache, key, (leaves << 8) | depth);
+
+    return leaves;
+}
+
+static void *PerftWorker(void *data)
+{
+    PerftJob *job = (PerftJob *)data;
+    unsigned long long nodes = 0;
+    int r;
+
+    while ((r = atomic_fetch_add(&job->next, 1)) < job->rootCount)
+    {
+        Board child = *job->board;
+
+        LockPiece(job->set, &child, job->roots[r].position);
+
+        if (job->depth == 1) job->counts[r] = 1;
+        else if (IsBoardOver(&child)) job->counts[r] = 0;
+        else job->counts[r] = Perft(job->set, job->cache, &child, job->queue + 1, job->depth - 1, &nodes);
+    }
+
+    atomic_fetch_add(&job->nodes, nodes);
+
+    return NULL;
+}
+
+// Split subtrees of the first placements between threads
+static PerftResult RunPerft(const PieceSet *set, PositionCache *cache, const Board *board, const int *queue, int depth, int threads, bool divide)
+{
+    static Placement roots[MAX_PLACEMENTS];
+    static unsigned long long counts[MAX_PLACEMENTS];
+    pthread_t workers[MAX_THREADS];
+    PerftResult result = { 0 };
+    Board spawned = *board;
+    double start = GetSeconds();
+
+    PerftJob job = { 0 };
+    job.set = set;
+    job.cache = cache;
+    job.board = &spawned;
+    job.roots = roots;
+    job.rootCount = GetPlacements(set, &spawned, SpawnPiece(set, &spawned, queue[0]), roots);
+    job.queue = queue;
+    job.depth = depth;
+    job.counts = counts;
+    atomic_init(&job.next, 0);
+    atomic_init(&job.nodes, job.rootCount);
+
+    for (int t = 1; t < threads; t++) pthread_create(&workers[t], NULL, PerftWorker, &job);
+    PerftWorker(&job);
+    for (int t = 1; t < threads; t++) pthread_join(workers[t], NULL);
+
+    for (int r = 0; r < job.rootCount; r++)
+    {
+        result.placements += counts[r];
+
+        if (divide)
+        {
+            const PiecePosition *position = &roots[r].position;
+            printf("%s rotation %d x %d y %d: %llu\n", set->type[position->type].name,
+                   position->rotation, position->x, position->y, counts[r]);
+        }
+    }
+
+    result.nodes = atomic_load(&job.nodes);
+    result.seconds = GetSeconds() - start;
+
+    return result;
+}
+
+// Rows of the playable columns, the last given row lies on the floor
+static bool ParseBoard(Board *board, const char *rows)
+{
+    int width = GRID_HORIZONTAL_SIZE - 2;
+    int length = (int)strlen(rows);
+    int count = (length + 1)/(width + 1);
+
+    InitBoard(board);
+    if (length == 0) return true;
+    if ((length != count*(width + 1) - 1) || (count > BOARD_PLAYABLE_ROWS)) return false;
+
+    for (int r = 0; r < count; r++)
+    {
+        int j = BOARD_PLAYABLE_ROWS - count + r;
+
+        for (int i = 0; i < width; i++)
+        {
+            char square = rows[r*(width + 1) + i];
+
+            if (square == '#') board->rows[j] |= 1u << (i + 1);
+            else if (square != '.') return false;
+        }
+
+        if ((r < count - 1) && (rows[r*(width + 1) + width] != '/')) return false;
+    }
+
+    return true;
+}
+
+// Piece names or indexes separated with ',', returns queue length or -1
+static int ParseQueue(const PieceSet *set, const char *text, int *queue)
+{
+    int length = 0;
+
+    while (*text != '\0')
+    {
+        char name[PIECE_NAME_SIZE] = { 0 };
+        int size = (int)strcspn(text, ",");
+
+        if ((size == 0) || (size >= PIECE_NAME_SIZE) || (length >= MAX_DEPTH)) return -1;
+        memcpy(name, text, size);
+        text += size;
+        if (*text == ',') text++;
+
+        int type = FindPieceType(set, name);
+        char *end = NULL;
+
+        if (type < 0)
+        {
+            type = (int)strtol(name, &end, 10);
+            if ((*end != '\0') || (type < 0) || (type >= set->typeCount)) return -1;
+        }
+
+        queue[length++] = type;
+    }
+
+    return length;
+}
+
+static double GetSeconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec/1e9;
+}
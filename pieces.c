@@ -0,0 +1,321 @@
+/*******************************************************************************************
+*
+*   tetris42 - piece sets
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "pieces.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define MAX_LINE_SIZE           128
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+// Same pieces as tetris42.pieces, used when the file can not be found
+static const char *defaultPieces =
+    "set basic 0 0\n"
+    "Cube            1 ..../.##./.##./....\n"
+    "L               1 .#../.#../.##./....\n"
+    "L_inversa       1 ..#./..#./.##./....\n"
+    "Recta           1 ..../####/..../....\n"
+    "Creu_tallada    1 .#../.##./.#../....\n"
+    "S               1 ..../.##./..##/....\n"
+    "S_inversa       1 ..../..##/.##./....\n"
+    "set advanced 223 300\n"
+    "S_big           1 ..../###./..##/....\n"
+    "S_big_inversa   1 ..../..##/###./....\n"
+    "-L              1 .#../##../.##./....\n"
+    "-L_inversa      1 ..#./..##/.##./....\n"
+    "T               1 ..#./..#./.###/....\n"
+    "L_big           1 .#../.#../.###/....\n"
+    "Factory         1 ..../.##./.###/....\n"
+    "Factory_inversa 1 ..../.##./.##./..#.\n"
+    "L_long          1 .#../.#../.#../.##.\n"
+    "L_long_inversa  1 ..#./..#./..#./.##.\n"
+    "I               1 .#../.#../.#../....\n"
+    "U               1 .##./.#../.##./....\n"
+    "+               1 .#../###./.#../....\n"
+    "f               1 .#../.#../.##./.#..\n"
+    "f_inversa       1 ..#./..#./.##./..#.\n";
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static bool AddPieceTier(PieceSet *set, const char *name, int base, int threshold);
+static bool AddPieceType(PieceSet *set, const char *name, int weight, const char *rows);
+static void BuildRotation(PieceRotation *rotation, const bool box[PIECE_MAX_SIZE][PIECE_MAX_SIZE]);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// Load piece set from definition file
+bool LoadPieceSet(PieceSet *set, const char *fileName)
+{
+    FILE *file = fopen(fileName, "rb");
+    if (file == NULL) return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *text = (size >= 0)? malloc(size + 1) : NULL;
+    bool loaded = false;
+
+    if ((text != NULL) && (fread(text, 1, size, file) == (size_t)size))
+    {
+        text[size] = '\0';
+        loaded = LoadPieceSetFromMemory(set, text);
+        if (!loaded) fprintf(stderr, "Pieces file %s is not valid.\n", fileName);
+    }
+
+    free(text);
+    fclose(file);
+
+    return loaded;
+}
+
+// Load piece set from definition text, tables are generated here once
+bool LoadPieceSetFromMemory(PieceSet *set, const char *text)
+{
+    memset(set, 0, sizeof(PieceSet));
+
+    int lineNumber = 0;
+
+    while (*text != '\0')
+    {
+        char line[MAX_LINE_SIZE] = { 0 };
+        int length = (int)strcspn(text, "\r\n");
+
+        lineNumber++;
+        if (length >= MAX_LINE_SIZE)
+        {
+            fprintf(stderr, "Pieces line %d: too long.\n", lineNumber);
+            return false;
+        }
+        memcpy(line, text, length);
+        text += length;
+        if (*text == '\r') text++;
+        if (*text == '\n') text++;
+
+        char name[PIECE_NAME_SIZE] = { 0 };
+        char rows[MAX_LINE_SIZE] = { 0 };
+        int first = 0;
+        int second = 0;
+        bool valid = true;
+
+        // Empty lines and comments
+        if ((sscanf(line, " %19s", name) != 1) || (name[0] == '#')) continue;
+
+        if (strcmp(name, "set") == 0)
+        {
+            valid = (sscanf(line, " set %19s %d %d", name, &first, &second) == 3) && AddPieceTier(set, name, first, second);
+        }
+        else
+        {
+            valid = (sscanf(line, " %19s %d %127s", name, &first, rows) == 3) && AddPieceType(set, name, first, rows);
+        }
+
+        if (!valid)
+        {
+            fprintf(stderr, "Pieces line %d: %s\n", lineNumber, line);
+            return false;
+        }
+    }
+
+    if ((set->typeCount == 0) || (set->tier[0].totalWeight == 0)) return false;
+
+    return true;
+}
+
+// Write definition text, length or -1 when too long
+int SavePieceSetToMemory(const PieceSet *set, char *text, int size)
+{
+    int length = 0;
+    int t = 0;
+
+    for (int r = 0; r < set->tierCount; r++)
+    {
+        const PieceTier *tier = &set->tier[r];
+
+        length += snprintf(text + length, (length < size)? size - length : 0, "set %s %d %d\n", tier->name, tier->base, tier->threshold);
+
+        for (; t < tier->end; t++)
+        {
+            const PieceType *type = &set->type[t];
+            char rows[PIECE_MAX_SIZE*(PIECE_MAX_SIZE + 1)] = { 0 };
+
+            for (int j = 0; j < type->size; j++)
+            {
+                for (int i = 0; i < type->size; i++) rows[j*(type->size + 1) + i] = (type->rotation[0].rowMask[j] & (1u << i))? '#' : '.';
+                rows[j*(type->size + 1) + type->size] = (j < type->size - 1)? '/' : '\0';
+            }
+
+            length += snprintf(text + length, (length < size)? size - length : 0, "%s %d %s\n", type->name, type->weight, rows);
+        }
+    }
+
+    return (length < size)? length : -1;
+}
+
+// Load built-in tetris42 pieces
+void LoadDefaultPieceSet(PieceSet *set)
+{
+    LoadPieceSetFromMemory(set, defaultPieces);
+}
+
+// Get piece type by name, -1 if none
+int FindPieceType(const PieceSet *set, const char *name)
+{
+    for (int t = 0; t < set->typeCount; t++)
+    {
+        if (strcmp(set->type[t].name, name) == 0) return t;
+    }
+
+    return -1;
+}
+
+// Get random piece type, more tiers join the pool as the completed lines grow
+int GetRandomPieceType(const PieceSet *set, int lines, int (*randomValue)(int min, int max))
+{
+    int tier = 0;
+
+    while ((tier + 1 < set->tierCount) &&
+           (randomValue(0, lines + set->tier[tier + 1].base) > set->tier[tier + 1].threshold)) tier++;
+
+    int random = randomValue(0, set->tier[tier].totalWeight - 1);
+
+    // First piece type with cumulative weight above the random value
+    int low = 0;
+    int high = set->tier[tier].end - 1;
+
+    while (low < high)
+    {
+        int middle = (low + high)/2;
+
+        if (set->cumulativeWeight[middle] > random) high = middle;
+        else low = middle + 1;
+    }
+
+    return low;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static bool AddPieceTier(PieceSet *set, const char *name, int base, int threshold)
+{
+    if (set->tierCount >= MAX_PIECE_TIERS) return false;
+
+    PieceTier *tier = &set->tier[set->tierCount++];
+
+    snprintf(tier->name, PIECE_NAME_SIZE, "%s", name);
+    tier->base = base;
+    tier->threshold = threshold;
+    tier->end = set->typeCount;
+    tier->totalWeight = (set->typeCount > 0)? set->cumulativeWeight[set->typeCount - 1] : 0;
+
+    return true;
+}
+
+static bool AddPieceType(PieceSet *set, const char *name, int weight, const char *rows)
+{
+    if ((set->typeCount >= MAX_PIECE_TYPES) || (weight <= 0)) return false;
+    if ((set->tierCount == 0) && !AddPieceTier(set, "default", 0, 0)) return false;
+
+    // Box side is given by the length of the first row
+    int size = (int)strcspn(rows, "/");
+    if ((size < 1) || (size > PIECE_MAX_SIZE) || ((int)strlen(rows) != size*(size + 1) - 1)) return false;
+
+    bool box[PIECE_MAX_SIZE][PIECE_MAX_SIZE] = { 0 };
+    int squares = 0;
+
+    for (int j = 0; j < size; j++)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            char square = rows[j*(size + 1) + i];
+
+            if (square == '#')
+            {
+                box[i][j] = true;
+                squares++;
+            }
+            else if (square != '.') return false;
+        }
+
+        if ((j < size - 1) && (rows[j*(size + 1) + size] != '/')) return false;
+    }
+
+    if ((squares == 0) || (squares > PIECE_MAX_SQUARES)) return false;
+
+    PieceType *type = &set->type[set->typeCount];
+
+    snprintf(type->name, PIECE_NAME_SIZE, "%s", name);
+    type->size = size;
+    type->weight = weight;
+
+    // Generate every turn once, the same way the old 4x4 turn moved the squares
+    for (int r = 0; r < PIECE_ROTATIONS; r++)
+    {
+        bool turned[PIECE_MAX_SIZE][PIECE_MAX_SIZE] = { 0 };
+
+        BuildRotation(&type->rotation[r], box);
+
+        for (int i = 0; i < size; i++)
+        {
+            for (int j = 0; j < size; j++)
+            {
+                turned[i][j] = box[size - 1 - j][i];
+            }
+        }
+
+        memcpy(box, turned, sizeof(box));
+    }
+
+    set->cumulativeWeight[set->typeCount] = weight + ((set->typeCount > 0)? set->cumulativeWeight[set->typeCount - 1] : 0);
+    set->typeCount++;
+    if (size > set->maxSize) set->maxSize = size;
+
+    PieceTier *tier = &set->tier[set->tierCount - 1];
+    tier->end = set->typeCount;
+    tier->totalWeight = set->cumulativeWeight[set->typeCount - 1];
+
+    return true;
+}
+
+static void BuildRotation(PieceRotation *rotation, const bool box[PIECE_MAX_SIZE][PIECE_MAX_SIZE])
+{
+    memset(rotation, 0, sizeof(PieceRotation));
+    rotation->minX = PIECE_MAX_SIZE;
+    rotation->minY = PIECE_MAX_SIZE;
+    rotation->maxX = -1;
+    rotation->maxY = -1;
+
+    for (int j = 0; j < PIECE_MAX_SIZE; j++)
+    {
+        for (int i = 0; i < PIECE_MAX_SIZE; i++)
+        {
+            if (box[i][j])
+            {
+                rotation->x[rotation->squares] = i;
+                rotation->y[rotation->squares] = j;
+                rotation->squares++;
+                rotation->rowMask[j] |= 1u << i;
+
+                if (i < rotation->minX) rotation->minX = i;
+                if (i > rotation->maxX) rotation->maxX = i;
+                if (j < rotation->minY) rotation->minY = j;
+                if (j > rotation->maxY) rotation->maxY = j;
+            }
+        }
+    }
+}
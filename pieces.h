@@ -0,0 +1,78 @@
+/*******************************************************************************************
+*
+*   tetris42 - piece sets
+*
+*   Pieces are read once at startup from a compact definition file (see tetris42.pieces)
+*   and turned into tables: every turn of every piece with its squares, per row masks
+*   for collisions and the cumulative weights used to draw the next piece.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef PIECES_H
+#define PIECES_H
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define PIECE_MAX_SIZE          6       // Largest bounding box side
+#define PIECE_MAX_SQUARES       8       // Largest number of squares of a piece
+#define PIECE_ROTATIONS         4
+#define MAX_PIECE_TYPES         64
+#define MAX_PIECE_TIERS         8
+#define PIECE_NAME_SIZE         20
+#define PIECES_TEXT_SIZE        8192    // Largest definition text of a piece set
+
+#define PIECES_FILE             "tetris42.pieces"
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+// One turn of a piece inside its bounding box
+typedef struct PieceRotation {
+    int squares;
+    int x[PIECE_MAX_SQUARES];
+    int y[PIECE_MAX_SQUARES];
+    unsigned int rowMask[PIECE_MAX_SIZE];   // Bit i set when box column i of the row is a square
+    int minX, maxX, minY, maxY;             // Occupied part of the box
+} PieceRotation;
+
+typedef struct PieceType {
+    char name[PIECE_NAME_SIZE];
+    int size;                               // Bounding box side
+    int weight;                             // Relative chance inside the pool
+    PieceRotation rotation[PIECE_ROTATIONS];// In the order ResolveTurnMovement() turns
+} PieceType;
+
+// Pieces of a tier join the pool when GetRandomValue(0, lines + base) > threshold
+typedef struct PieceTier {
+    char name[PIECE_NAME_SIZE];
+    int base;
+    int threshold;
+    int end;                                // Pool is piece types [0, end)
+    int totalWeight;                        // Sum of weights of the pool
+} PieceTier;
+
+typedef struct PieceSet {
+    PieceType type[MAX_PIECE_TYPES];
+    int typeCount;
+    PieceTier tier[MAX_PIECE_TIERS];
+    int tierCount;
+    int cumulativeWeight[MAX_PIECE_TYPES];
+    int maxSize;                            // Largest bounding box of the set
+} PieceSet;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+bool LoadPieceSet(PieceSet *set, const char *fileName);     // Load piece set from definition file
+bool LoadPieceSetFromMemory(PieceSet *set, const char *text);   // Load piece set from definition text
+int SavePieceSetToMemory(const PieceSet *set, char *text, int size);    // Write definition text, length or -1 when too long
+void LoadDefaultPieceSet(PieceSet *set);                    // Load built-in tetris42 pieces
+int FindPieceType(const PieceSet *set, const char *name);   // Get piece type by name, -1 if none
+int GetRandomPieceType(const PieceSet *set, int lines, int (*randomValue)(int min, int max));
+
+#endif // PIECES_H
@@ -0,0 +1,416 @@
+/*******************************************************************************************
+*
+*   tetris42 - spectator player
+*
+*   Shows a spectator stream written by tetris42 --spectate: a file at the speed it was
+*   played, following it while the game still writes it, or live from the game over a
+*   local socket (unix:PATH) the player listens on. No game logic runs here, boards are
+*   rebuilt from the stream and drawn like the game draws them.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#if !defined(_WIN32) && !defined(PLATFORM_WEB)
+    #define SUPPORT_SPECTATOR_SOCKET
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "raylib.h"
+#include "spectator.h"
+#include "layout.h"
+#include "render.h"
+#include "hud.h"
+#include "screen.h"
+#include "pacing.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#if defined(SUPPORT_SPECTATOR_SOCKET)
+    #include <fcntl.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define DEFAULT_SCREEN_WIDTH    1920
+#define DEFAULT_SCREEN_HEIGHT   1080
+#define INPUT_SIZE              65536
+#define TICK_RATE               60      // Game frames per second
+
+#define STATUS_LABEL            (HUD_LABELS - 1)
+#define PAUSE_LABEL             (HUD_LABELS - 2)
+#define GAME_OVER_LABEL         3       // After the board labels of render.c
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static int screenWidth = DEFAULT_SCREEN_WIDTH;
+static int screenHeight = DEFAULT_SCREEN_HEIGHT;
+static ScreenScaling scaling = SCALING_SMOOTH;
+
+static BoardTile tiles[SPECTATOR_BOARDS];
+static int layoutWidth = 0;
+static int layoutHeight = 0;
+static int layoutCount = 0;
+
+static SpectatorStream stream;
+static GridSquare grid[SPECTATOR_BOARDS][GRID_HORIZONTAL_SIZE][GRID_VERTICAL_SIZE];
+static unsigned char input[INPUT_SIZE];
+static int inputSize = 0;
+
+static FILE *file = NULL;
+static int listenFd = -1;
+static int clientFd = -1;
+
+static bool live = false;               // Records are shown as they come
+static bool started = false;            // First keyframe seen, play clock runs
+static bool stopped = false;            // Playback paused with SPACE
+static bool corrupt = false;            // File stream broken, no more records are read
+static double playTick = 0;
+static bool fading[SPECTATOR_BOARDS] = { 0 };
+static unsigned int fadeStart[SPECTATOR_BOARDS] = { 0 };   // Tick the line clear of a board started
+static float speed = 1.0f;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static bool OpenSource(const char *source);
+static void CloseSource(void);
+static void ReadInput(void);
+static void DecodeInput(void);
+static void DrawPlayer(void);
+static void RestartStream(void);
+
+//------------------------------------------------------------------------------------
+// Program main entry point
+//------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    const char *source = NULL;
+    float from = 0;
+    bool usage = false;
+
+    for (int a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "--speed") == 0) && (a + 1 < argc)) speed = (float)atof(argv[++a]);
+        else if ((strcmp(argv[a], "--from") == 0) && (a + 1 < argc)) from = (float)atof(argv[++a]);
+        else if ((strcmp(argv[a], "--resolution") == 0) && (a + 1 < argc)) sscanf(argv[++a], "%dx%d", &screenWidth, &screenHeight);
+        else if ((strcmp(argv[a], "--scale") == 0) && (a + 1 < argc)) scaling = (strcmp(argv[++a], "integer") == 0)? SCALING_INTEGER : SCALING_SMOOTH;
+        else if ((argv[a][0] != '-') && (source == NULL)) source = argv[a];
+        else usage = true;
+    }
+
+    if (usage || (source == NULL) || (speed <= 0) || (screenWidth < 64) || (screenHeight < 64))
+    {
+        printf("usage: tetris42-player [--speed <x>] [--from <seconds>] [--resolution <w>x<h>] [--scale integer|smooth] <file | unix:path>\n"
+               "  <file>             stream written by tetris42 --spectate <file>\n"
+               "  unix:<path>        listen for tetris42 --spectate unix:<path> and show it live\n"
+               "  --speed <x>        playback speed of files, 1 by default\n"
+               "  --from <seconds>   start at the first keyframe after this game time\n");
+        return 1;
+    }
+
+    InitSpectatorStream(&stream);
+    stream.joinTick = (unsigned int)(from*TICK_RATE);
+
+    if (!OpenSource(source))
+    {
+        printf("Can not open %s.\n", source);
+        return 1;
+    }
+
+    SetTraceLogLevel(LOG_ERROR);
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+    InitWindow(screenWidth, screenHeight, "Tetris spectator");
+
+    FitWindowToMonitor(screenWidth, screenHeight);
+    if (!InitScreen(screenWidth, screenHeight, scaling))
+    {
+        printf("Can not create a %dx%d render target.\n", screenWidth, screenHeight);
+        CloseWindow();
+        CloseSource();
+        return 1;
+    }
+
+    // The game's build swaps and polls in the loop, GetFrameTime() stays 0 there
+    InitPacing(PACING_CLASSIC, TICK_RATE, PACING_AUTO_DELAY);
+
+    while (!WindowShouldClose())
+    {
+        BeginPacedFrame();
+
+        if (IsKeyPressed(KEY_SPACE) && !live) stopped = !stopped;
+
+        ReadInput();
+        DecodeInput();
+
+        if (live) playTick = stream.tick;
+        else if (started && !stopped) playTick += speed*TICK_RATE*GetPacedFrameTime();
+
+        DrawPlayer();
+        EndPacedFrame();
+    }
+
+    UnloadHud();
+    UnloadScreen();
+    CloseWindow();
+    CloseSource();
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static bool OpenSource(const char *source)
+{
+    if (strncmp(source, "unix:", 5) == 0)
+    {
+#if defined(SUPPORT_SPECTATOR_SOCKET)
+        struct sockaddr_un address;
+        const char *path = source + 5;
+
+        if ((path[0] == '\0') || (strlen(path) >= sizeof(address.sun_path))) return false;
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0) return false;
+
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, path);
+        unlink(path);
+
+        if ((bind(listenFd, (struct sockaddr *)&address, sizeof(address)) != 0) || (listen(listenFd, 1) != 0))
+        {
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+
+        fcntl(listenFd, F_SETFL, O_NONBLOCK);
+        live = true;
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    file = fopen(source, "rb");
+
+    return (file != NULL);
+}
+
+static void CloseSource(void)
+{
+    if (file != NULL) fclose(file);
+    file = NULL;
+
+#if defined(SUPPORT_SPECTATOR_SOCKET)
+    if (clientFd >= 0) close(clientFd);
+    if (listenFd >= 0) close(listenFd);
+#endif
+    clientFd = -1;
+    listenFd = -1;
+}
+
+// Whatever arrived since the last frame, never waits
+static void ReadInput(void)
+{
+    if (file != NULL)
+    {
+        inputSize += (int)fread(input + inputSize, 1, INPUT_SIZE - inputSize, file);
+
+        // File may still be written by the game
+        if (feof(file)) clearerr(file);
+    }
+#if defined(SUPPORT_SPECTATOR_SOCKET)
+    else if (listenFd >= 0)
+    {
+        // A game connecting again starts over with a header and keyframes
+        int fd = accept(listenFd, NULL, NULL);
+
+        if (fd >= 0)
+        {
+            if (clientFd >= 0) close(clientFd);
+            clientFd = fd;
+            fcntl(clientFd, F_SETFL, O_NONBLOCK);
+            RestartStream();
+        }
+
+        if (clientFd >= 0)
+        {
+            ssize_t size = recv(clientFd, input + inputSize, INPUT_SIZE - inputSize, 0);
+
+            if (size > 0) inputSize += (int)size;
+            else if (size == 0)
+            {
+                close(clientFd);
+                clientFd = -1;
+            }
+        }
+    }
+#endif
+}
+
+// Records up to the play clock, all of them when live
+static void DecodeInput(void)
+{
+    unsigned int untilTick = (live || !started)? UINT_MAX : (unsigned int)playTick;
+    int position = 0;
+
+    while (position < inputSize)
+    {
+        int used = ReadSpectatorRecord(&stream, input + position, inputSize - position, untilTick);
+
+        // Records can not be told apart in a broken stream, a dropped game reconnects with a header
+        if (used < 0)
+        {
+#if defined(SUPPORT_SPECTATOR_SOCKET)
+            if (clientFd >= 0)
+            {
+                printf("Spectator stream is corrupt, dropping the game until it connects again.\n");
+                close(clientFd);
+                clientFd = -1;
+                RestartStream();
+                return;
+            }
+#endif
+            printf("Spectator stream is corrupt, the rest of it is not shown.\n");
+            if (file != NULL) fclose(file);
+            file = NULL;
+            corrupt = true;
+            inputSize = 0;
+            return;
+        }
+        if (used == 0) break;
+
+        position += used;
+
+        // The record bringing fading rows is the tick the game completed the lines in
+        for (int b = 0; b < stream.boardCount; b++)
+        {
+            bool fades = (stream.squares[b].fadingRows != 0);
+
+            if (fades && !fading[b]) fadeStart[b] = stream.tick;
+            fading[b] = fades;
+        }
+
+        if (!started)
+        {
+            for (int b = 0; b < stream.boardCount; b++) started |= stream.synced[b];
+
+            // Play clock starts at the first keyframe shown
+            if (started)
+            {
+                playTick = stream.tick;
+                if (!live) untilTick = stream.tick;
+            }
+        }
+    }
+
+    memmove(input, input + position, inputSize - position);
+    inputSize -= position;
+}
+
+static void RestartStream(void)
+{
+    unsigned int joinTick = stream.joinTick;
+
+    InitSpectatorStream(&stream);
+    stream.joinTick = joinTick;
+    inputSize = 0;
+    started = false;
+    for (int b = 0; b < SPECTATOR_BOARDS; b++) fading[b] = false;
+}
+
+static void DrawPlayer(void)
+{
+    BeginScreen();
+
+    ClearBackground(RAYWHITE);
+
+    int count = (stream.boardCount > 0)? stream.boardCount : 1;
+
+    // Boards are tiled again only when the screen size or board count changes
+    if ((layoutWidth != screenWidth) || (layoutHeight != screenHeight) || (layoutCount != count))
+    {
+        int squareSize = LayoutBoards(count, screenWidth, screenHeight, tiles);
+
+        layoutWidth = screenWidth;
+        layoutHeight = screenHeight;
+        layoutCount = count;
+
+        UnloadHud();
+        LoadHudFont((tiles[0].detail == DETAIL_FULL)? squareSize/2 : squareSize);
+        LoadHudFont((squareSize < 20)? squareSize : 20);
+        LoadHudFont(40);
+    }
+
+    Color colors[4][3] = {
+        { SKYBLUE, BLUE, DARKBLUE },
+        { PURPLE, VIOLET, DARKPURPLE },
+        { GREEN, LIME, DARKGREEN },
+        { BEIGE, BROWN, DARKBROWN }
+    };
+
+    for (int b = 0; b < stream.boardCount; b++)
+    {
+        const BoardState *state = &stream.board[b];
+        BoardTile tile = tiles[b];
+        int fontSize = (tile.squareSize < 20)? tile.squareSize : 20;
+        int c = (1 == stream.boardCount)? 1 : b;        // Single player plays on the second board
+
+        if (!stream.synced[b])
+        {
+            DrawHudTextCentered(b*HUD_BOARD_LABELS + GAME_OVER_LABEL, "WAITING FOR A KEYFRAME", tile.x + TILE_WIDTH*tile.squareSize/2,
+                                tile.y + TILE_HEIGHT*tile.squareSize/2 - fontSize, fontSize, GRAY);
+            continue;
+        }
+
+        if (state->gameOver)
+        {
+            DrawHudTextCentered(b*HUD_BOARD_LABELS + GAME_OVER_LABEL, "GAME OVER", tile.x + TILE_WIDTH*tile.squareSize/2,
+                                tile.y + TILE_HEIGHT*tile.squareSize/2 - fontSize, fontSize, GRAY);
+            continue;
+        }
+
+        for (int i = 0; i < GRID_HORIZONTAL_SIZE; i++)
+        {
+            for (int j = 0; j < GRID_VERTICAL_SIZE; j++) grid[b][i][j] = (GridSquare)state->grid[j][i];
+        }
+
+        BoardView view = { 0 };
+
+        view.id = b;
+        view.grid = grid[b];
+        view.incoming = (state->incomingType >= 0)? &stream.set.type[state->incomingType].rotation[0] : NULL;
+        view.boxSize = (stream.set.maxSize > 4)? stream.set.maxSize : 4;
+        view.name = state->name;
+        view.lines = state->lines;
+        view.wallColor = colors[c][0];
+        view.fullColor = colors[c][1];
+        view.movingColor = colors[c][2];
+        // The game blinks on its fade counter, ticks since the line clear started
+        unsigned int fadeTicks = (unsigned int)playTick - fadeStart[b];
+
+        view.fadingColor = (fadeTicks%8 < 4)? MAROON : GRAY;
+
+        DrawBoard(&view, tile);
+
+        if (state->paused) DrawHudTextCentered(PAUSE_LABEL, "GAME PAUSED", screenWidth/2, screenHeight/2 - 40, 40, GRAY);
+    }
+
+    if (corrupt) DrawHudText(STATUS_LABEL, "STREAM IS CORRUPT", 10, 10, 20, DARKGRAY);
+    else if (started) DrawHudNumber(STATUS_LABEL, stopped? "%d S, PAUSED" : "%d S", (int)(playTick/TICK_RATE), 10, 10, 20, DARKGRAY);
+    else DrawHudText(STATUS_LABEL, live? "WAITING FOR THE GAME" : "READING STREAM", 10, 10, 20, DARKGRAY);
+
+    EndScreen();
+}
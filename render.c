@@ -0,0 +1,132 @@
+/*******************************************************************************************
+*
+*   tetris42 - board drawing
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "render.h"
+#include "hud.h"
+
+#include <stddef.h>
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static Color GetSquareColor(const BoardView *view, GridSquare square);
+static void DrawSquareLines(int x, int y, int size, Color color);
+static void DrawGridFull(const BoardView *view, BoardTile tile);
+static void DrawGridLow(const BoardView *view, BoardTile tile);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+void DrawBoard(const BoardView *view, BoardTile tile)
+{
+    int size = tile.squareSize;
+
+    if (tile.detail == DETAIL_FULL) DrawGridFull(view, tile);
+    else DrawGridLow(view, tile);
+
+    // Outline of the hinted placement
+    if (view->hint != NULL)
+    {
+        for (int s = 0; s < view->hint->squares; s++)
+        {
+            DrawRectangleLines(tile.x + (view->hintX + view->hint->x[s])*size, tile.y + (view->hintY + view->hint->y[s])*size,
+                               size, size, view->movingColor);
+        }
+    }
+
+    // Incoming piece box right of the grid, labels above and below it
+    int boxX = tile.x + (GRID_HORIZONTAL_SIZE + 1)*size;
+    int boxY = tile.y + 2*size;
+
+    for (int j = 0; j < view->boxSize; j++)
+    {
+        for (int i = 0; i < view->boxSize; i++)
+        {
+            bool filled = (view->incoming != NULL) && (view->incoming->rowMask[j] & (1u << i));
+
+            if (filled) DrawRectangle(boxX + i*size, boxY + j*size, size, size, view->fullColor);
+            else if (tile.detail == DETAIL_FULL) DrawSquareLines(boxX + i*size, boxY + j*size, size, view->wallColor);
+        }
+    }
+
+    int label = view->id*HUD_BOARD_LABELS;
+
+    if (tile.detail == DETAIL_FULL)
+    {
+        DrawHudText(label, view->name, boxX, boxY - 2*size, size/2, GRAY);
+        DrawHudText(label + 1, "INCOMING:", boxX, boxY - size, size/2, GRAY);
+        DrawHudNumber(label + 2, "LINES:   %04i", view->lines, boxX, boxY + view->boxSize*size + 20, size/2, GRAY);
+    }
+    else
+    {
+        DrawHudText(label, view->name, boxX, tile.y, size, GRAY);
+        DrawHudNumber(label + 2, "%i", view->lines, boxX, tile.y + size, size, GRAY);
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static Color GetSquareColor(const BoardView *view, GridSquare square)
+{
+    switch (square)
+    {
+        case FULL: return view->fullColor;
+        case MOVING: return view->movingColor;
+        case FADING: return view->fadingColor;
+        default: return view->wallColor;
+    }
+}
+
+static void DrawSquareLines(int x, int y, int size, Color color)
+{
+    DrawLine(x, y, x + size, y, color);
+    DrawLine(x, y, x, y + size, color);
+    DrawLine(x + size, y, x + size, y + size, color);
+    DrawLine(x, y + size, x + size, y + size, color);
+}
+
+// Every square on its own, empty squares as grid lines
+static void DrawGridFull(const BoardView *view, BoardTile tile)
+{
+    int size = tile.squareSize;
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+    {
+        for (int i = 0; i < GRID_HORIZONTAL_SIZE; i++)
+        {
+            GridSquare square = view->grid[i][j];
+
+            if (square == EMPTY) DrawSquareLines(tile.x + i*size, tile.y + j*size, size, view->wallColor);
+            else DrawRectangle(tile.x + i*size, tile.y + j*size, size, size, GetSquareColor(view, square));
+        }
+    }
+}
+
+// Runs of equal squares in a row as one rectangle, empty squares not drawn
+static void DrawGridLow(const BoardView *view, BoardTile tile)
+{
+    int size = tile.squareSize;
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+    {
+        int i = 0;
+
+        while (i < GRID_HORIZONTAL_SIZE)
+        {
+            GridSquare square = view->grid[i][j];
+            int run = 1;
+
+            while ((i + run < GRID_HORIZONTAL_SIZE) && (view->grid[i + run][j] == square)) run++;
+
+            if (square != EMPTY) DrawRectangle(tile.x + i*size, tile.y + j*size, run*size, size, GetSquareColor(view, square));
+
+            i += run;
+        }
+    }
+}
@@ -0,0 +1,46 @@
+/*******************************************************************************************
+*
+*   tetris42 - board drawing
+*
+*   Draws one board with its incoming piece and labels into a layout tile. Low detail
+*   tiles skip grid lines and square borders, draw runs of equal squares as one rectangle
+*   and keep only the name and lines labels.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "raylib.h"
+#include "tetris42.h"
+#include "pieces.h"
+#include "layout.h"
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+// Everything drawn for a board, filled in by the game or the spectator player
+typedef struct BoardView {
+    int id;                                         // Board number, keys its HUD labels
+    GridSquare (*grid)[GRID_VERTICAL_SIZE];         // Squares as grid[i][j]
+    const PieceRotation *incoming;                  // NULL before the first piece
+    int boxSize;                                    // Incoming box side in squares
+    const char *name;
+    int lines;
+    Color wallColor;                                // Walls, floor and grid lines
+    Color fullColor;
+    Color movingColor;
+    Color fadingColor;
+    const PieceRotation *hint;                      // Outlined placement, NULL for none
+    int hintX;
+    int hintY;
+} BoardView;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+void DrawBoard(const BoardView *view, BoardTile tile);
+
+#endif // RENDER_H
@@ -0,0 +1,92 @@
+/*******************************************************************************************
+*
+*   tetris42 - offscreen rendering
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "screen.h"
+#include "memtrack.h"
+
+#include <math.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define MONITOR_FILL            0.9f    // Part of the monitor a fitted window takes
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static RenderTexture2D target = { 0 };
+static ScreenScaling screenScaling = SCALING_SMOOTH;
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// Largest window of this aspect on the monitor, monitor size is only known after InitWindow()
+void FitWindowToMonitor(int width, int height)
+{
+    int monitor = GetCurrentMonitor();
+    int monitorWidth = GetMonitorWidth(monitor);
+    int monitorHeight = GetMonitorHeight(monitor);
+
+    if ((monitorWidth <= 0) || (monitorHeight <= 0)) return;
+
+    float scale = fminf(MONITOR_FILL*monitorWidth/width, MONITOR_FILL*monitorHeight/height);
+
+    SetWindowSize((int)(width*scale), (int)(height*scale));
+}
+
+// Internal resolution, call after InitWindow()
+bool InitScreen(int width, int height, ScreenScaling scaling)
+{
+    target = LoadRenderTexture(width, height);
+    screenScaling = scaling;
+
+    if (target.id == 0) return false;
+
+    TrackGpuResources(1);
+    SetTextureFilter(target.texture, (scaling == SCALING_INTEGER)? TEXTURE_FILTER_POINT : TEXTURE_FILTER_BILINEAR);
+
+    return true;
+}
+
+void UnloadScreen(void)
+{
+    if (target.id != 0)
+    {
+        UnloadRenderTexture(target);
+        TrackGpuResources(-1);
+    }
+    target.id = 0;
+}
+
+// Start drawing at the internal resolution
+void BeginScreen(void)
+{
+    BeginDrawing();
+    BeginTextureMode(target);
+}
+
+// Scale the frame to the window and show it
+void EndScreen(void)
+{
+    EndTextureMode();
+
+    float width = (float)target.texture.width;
+    float height = (float)target.texture.height;
+    float scale = fminf(GetScreenWidth()/width, GetScreenHeight()/height);
+
+    // Whole pixel factors, or their inverse when the window is smaller
+    if (screenScaling == SCALING_INTEGER) scale = (scale >= 1.0f)? floorf(scale) : 1.0f/ceilf(1.0f/scale);
+
+    Rectangle source = { 0, 0, width, -height };    // Render textures are upside down
+    Rectangle dest = { floorf((GetScreenWidth() - width*scale)/2), floorf((GetScreenHeight() - height*scale)/2), width*scale, height*scale };
+
+    ClearBackground(BLACK);
+    DrawTexturePro(target.texture, source, dest, (Vector2){ 0, 0 }, 0.0f, WHITE);
+
+    EndDrawing();
+}
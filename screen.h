@@ -0,0 +1,35 @@
+/*******************************************************************************************
+*
+*   tetris42 - offscreen rendering
+*
+*   Frames are drawn into a texture at a fixed internal resolution and then scaled to
+*   whatever size the window has, so layout depends on the internal resolution only and
+*   fill cost can be lowered independently of the monitor. Integer scaling keeps squares
+*   sharp with whole pixel factors, smooth scaling fills the window with bilinear filtering.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include "raylib.h"
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef enum ScreenScaling { SCALING_SMOOTH = 0, SCALING_INTEGER } ScreenScaling;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+void FitWindowToMonitor(int width, int height);                 // Largest window of this aspect on the monitor, call after InitWindow()
+bool InitScreen(int width, int height, ScreenScaling scaling);  // Internal resolution, call after InitWindow()
+void UnloadScreen(void);
+void BeginScreen(void);                 // Start drawing at the internal resolution
+void EndScreen(void);                   // Scale the frame to the window and show it
+
+#endif // SCREEN_H
@@ -0,0 +1,513 @@
+/*******************************************************************************************
+*
+*   tetris42 - self-play dataset generator
+*
+*   Bots play matches headless and every placement becomes a dataset record (dataset.h):
+*   board, current and incoming piece, chosen placement, lines and the end of the game.
+*   Each board of a match draws pieces from its own generator seeded by the match seed, as
+*   in the game, and a bot searches its placement from the current and incoming piece.
+*
+*   The seed range is split into shards, one file each, and threads take shards one by
+*   one, so the output depends on the seeds and settings only. Records stream out in
+*   chunks of whole matches; memory stays flat however many positions are written. A shard
+*   run again continues after its last complete chunk and a finished shard is skipped.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L     // clock_gettime(), sysconf() and truncate()
+
+#include "dataset.h"
+#include "bot.h"
+#include "zobrist.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define MAX_THREADS             256
+#define MAX_PLAYERS             4
+#define SHARD_NAME_SIZE         512
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct SelfplayJob {
+    const PieceSet *set;
+    DatasetHeader header;               // Settings every shard file carries
+    const char *prefix;
+    int shards;
+    int chunkRecords;
+    atomic_int next;                    // Next shard to take
+    atomic_ullong positions;            // Written by this run
+    atomic_ullong matches;
+    atomic_ullong bytes;
+    atomic_int failed;
+} SelfplayJob;
+
+// Buffers of one thread, sized once
+typedef struct SelfplayWorker {
+    DatasetRecord *records;             // A chunk and one more match
+    int count;
+    unsigned char *buffer;              // Encoded chunk
+} SelfplayWorker;
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static _Thread_local unsigned long long randomState = 0;    // Of the board being played
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static void *SelfplayThread(void *data);
+static void RunShard(SelfplayJob *job, SelfplayWorker *worker, int shard);
+static bool ResumeShard(SelfplayJob *job, const char *fileName, unsigned long long firstSeed, unsigned long long endSeed, unsigned long long *seed);
+static int PlayMatch(const SelfplayJob *job, unsigned long long seed, DatasetRecord *records);
+static int GetSeedRandomValue(int min, int max);
+static int CheckDataset(const PieceSet *set, int fileCount, char **fileNames);
+static double GetSeconds(void);
+
+//------------------------------------------------------------------------------------
+// Program main entry point
+//------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    const char *piecesFile = NULL;
+    const char *prefix = "selfplay";
+    unsigned long long firstSeed = 0;
+    unsigned long long seedCount = 1000;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int shards = 16;
+    int players = 2;
+    int depth = 2;
+    int maxPieces = 1000;
+    int chunkRecords = 4096;
+    bool check = false;
+    bool usage = false;
+    char **files = NULL;
+    int fileCount = 0;
+
+    for (int a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "--pieces") == 0) && (a + 1 < argc)) piecesFile = argv[++a];
+        else if ((strcmp(argv[a], "--out") == 0) && (a + 1 < argc)) prefix = argv[++a];
+        else if ((strcmp(argv[a], "--seeds") == 0) && (a + 1 < argc))
+        {
+            if (sscanf(argv[++a], "%llu:%llu", &firstSeed, &seedCount) != 2) usage = true;
+        }
+        else if ((strcmp(argv[a], "--shards") == 0) && (a + 1 < argc)) shards = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--threads") == 0) && (a + 1 < argc)) threads = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--players") == 0) && (a + 1 < argc)) players = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--depth") == 0) && (a + 1 < argc)) depth = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--max-pieces") == 0) && (a + 1 < argc)) maxPieces = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--chunk") == 0) && (a + 1 < argc)) chunkRecords = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--check") == 0)
+        {
+            check = true;
+            files = argv + a + 1;
+            fileCount = argc - a - 1;
+            break;
+        }
+        else usage = true;
+    }
+
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    if (usage || (shards < 1) || ((unsigned long long)shards > seedCount) || (players < 1) || (players > MAX_PLAYERS) ||
+        (depth < 1) || (depth > BOT_MAX_DEPTH) || (maxPieces < 1) || (chunkRecords < 1) || (check && (fileCount == 0)))
+    {
+        printf("Usage: tetris42-selfplay [options]\n"
+               "       tetris42-selfplay [--pieces <file>] --check <files>\n"
+               "  --seeds <first>:<count>  match seeds, 0:1000 by default\n"
+               "  --shards <n>             files the seeds are split into, 16 by default\n"
+               "  --out <prefix>           shard files <prefix>-<shard>.t42d, selfplay by default\n"
+               "  --players <n>            boards per match, 2 by default\n"
+               "  --depth <n>              bot search depth, 2 (current and incoming piece) by default\n"
+               "  --max-pieces <n>         placements per board before a match stops, 1000 by default\n"
+               "  --chunk <n>              records per chunk, 4096 by default\n"
+               "  --pieces <file>          piece set, built-in pieces by default\n"
+               "  --threads <n>            worker threads, all cores by default\n"
+               "  --check                  read shard files back and print their contents\n");
+        return 1;
+    }
+
+    static PieceSet pieceSet;
+    PieceSet *set = &pieceSet;
+
+    InitZobrist();
+
+    if (piecesFile == NULL) LoadDefaultPieceSet(set);
+    else if (!LoadPieceSet(set, piecesFile))
+    {
+        printf("Can not load pieces from %s.\n", piecesFile);
+        return 1;
+    }
+
+    if (check)
+    {
+        return CheckDataset(set, fileCount, files);
+    }
+
+    static SelfplayJob job = { 0 };
+    pthread_t workers[MAX_THREADS];
+
+    job.set = set;
+    job.header.players = players;
+    job.header.depth = depth;
+    job.header.maxPieces = maxPieces;
+    job.header.firstSeed = firstSeed;
+    job.header.endSeed = firstSeed + seedCount;
+    job.prefix = prefix;
+    job.shards = shards;
+    job.chunkRecords = chunkRecords;
+
+    if (SavePieceSetToMemory(set, job.header.pieces, DATASET_PIECES_SIZE) < 0)
+    {
+        printf("Piece set definition is too long.\n");
+        return 1;
+    }
+
+    double start = GetSeconds();
+
+    int started = 1;
+
+    // Threads the system refuses leave their shards to the others
+    while ((started < threads) && (pthread_create(&workers[started], NULL, SelfplayThread, &job) == 0)) started++;
+    if (started < threads) printf("Can only start %d of %d threads.\n", started, threads);
+
+    SelfplayThread(&job);
+    for (int t = 1; t < started; t++) pthread_join(workers[t], NULL);
+
+    double seconds = GetSeconds() - start;
+    unsigned long long positions = atomic_load(&job.positions);
+    unsigned long long bytes = atomic_load(&job.bytes);
+
+    printf("%llu positions from %llu matches in %.1f s, %.0f positions/s with %d threads, %.1f bytes/position\n",
+           positions, atomic_load(&job.matches), seconds, positions/seconds, started, (positions > 0)? (double)bytes/positions : 0.0);
+
+    return (atomic_load(&job.failed) == 0)? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static void *SelfplayThread(void *data)
+{
+    SelfplayJob *job = (SelfplayJob *)data;
+    SelfplayWorker worker = { 0 };
+    int capacity = job->chunkRecords + job->header.players*job->header.maxPieces;
+    int shard;
+
+    worker.records = (DatasetRecord *)malloc(capacity*sizeof(DatasetRecord));
+    worker.buffer = (unsigned char *)malloc(DATASET_CHUNK_SIZE(capacity));
+
+    if ((worker.records == NULL) || (worker.buffer == NULL)) atomic_fetch_add(&job->failed, 1);
+    else while ((shard = atomic_fetch_add(&job->next, 1)) < job->shards) RunShard(job, &worker, shard);
+
+    free(worker.records);
+    free(worker.buffer);
+
+    return NULL;
+}
+
+// Play the seeds of a shard not in its file yet
+static void RunShard(SelfplayJob *job, SelfplayWorker *worker, int shard)
+{
+    unsigned long long seedCount = job->header.endSeed - job->header.firstSeed;
+    unsigned long long firstSeed = job->header.firstSeed + seedCount*shard/job->shards;
+    unsigned long long endSeed = job->header.firstSeed + seedCount*(shard + 1)/job->shards;
+    char fileName[SHARD_NAME_SIZE];
+
+    snprintf(fileName, SHARD_NAME_SIZE, "%s-%04d.t42d", job->prefix, shard);
+
+    unsigned long long seed = firstSeed;
+
+    if (!ResumeShard(job, fileName, firstSeed, endSeed, &seed) || (seed >= endSeed)) return;
+
+    FILE *file = fopen(fileName, (seed == firstSeed)? "wb" : "ab");
+    DatasetHeader header = job->header;
+    unsigned long long chunkSeed = seed;
+    unsigned long long positions = 0;
+    unsigned long long matches = 0;
+    unsigned long long bytes = 0;
+    bool written = (file != NULL);
+
+    // Shards carry their own seed range, settings and pieces
+    header.firstSeed = firstSeed;
+    header.endSeed = endSeed;
+    if (written && (seed == firstSeed)) written = WriteDatasetHeader(file, &header);
+
+    worker->count = 0;
+
+    for (; written && (seed < endSeed); seed++)
+    {
+        worker->count += PlayMatch(job, seed, worker->records + worker->count);
+        matches++;
+
+        if ((worker->count >= job->chunkRecords) || (seed + 1 == endSeed))
+        {
+            long before = ftell(file);
+
+            written = WriteDatasetChunk(file, worker->records, worker->count, chunkSeed, seed + 1, worker->buffer) && (fflush(file) == 0);
+            positions += worker->count;
+            bytes += ftell(file) - before;
+            chunkSeed = seed + 1;
+            worker->count = 0;
+        }
+    }
+
+    if (file != NULL) fclose(file);
+
+    if (!written)
+    {
+        printf("Can not write %s.\n", fileName);
+        atomic_fetch_add(&job->failed, 1);
+    }
+
+    atomic_fetch_add(&job->positions, positions);
+    atomic_fetch_add(&job->matches, matches);
+    atomic_fetch_add(&job->bytes, bytes);
+}
+
+// Seed to continue from, false when the file was written with other settings
+static bool ResumeShard(SelfplayJob *job, const char *fileName, unsigned long long firstSeed, unsigned long long endSeed, unsigned long long *seed)
+{
+    FILE *file = fopen(fileName, "rb");
+
+    *seed = firstSeed;
+    if (file == NULL) return true;
+
+    static _Thread_local DatasetHeader header;
+    DatasetChunk chunk = { 0 };
+    long end = 0;
+
+    if (ReadDatasetHeader(file, &header))
+    {
+        if ((header.players != job->header.players) || (header.depth != job->header.depth) ||
+            (header.maxPieces != job->header.maxPieces) || (header.firstSeed != firstSeed) ||
+            (header.endSeed != endSeed) || (strcmp(header.pieces, job->header.pieces) != 0))
+        {
+            printf("%s was written with other settings, remove it to start over.\n", fileName);
+            atomic_fetch_add(&job->failed, 1);
+            fclose(file);
+            return false;
+        }
+
+        // A chunk cut short by a crash or a kill is dropped and played again
+        end = ftell(file);
+
+        while (ReadDatasetChunk(file, &chunk) > 0)
+        {
+            *seed = chunk.nextSeed;
+            end = ftell(file);
+        }
+    }
+
+    fclose(file);
+    UnloadDatasetChunk(&chunk);
+
+    // Without a header the file is written again from the start
+    if ((end == 0) || (truncate(fileName, end) != 0)) *seed = firstSeed;
+
+    return true;
+}
+
+// Records of every board, outcomes are filled in when all boards ended
+static int PlayMatch(const SelfplayJob *job, unsigned long long seed, DatasetRecord *records)
+{
+    const PieceSet *set = job->set;
+    int lines[MAX_PLAYERS] = { 0 };
+    int mostLines = 0;
+    int count = 0;
+
+    for (int p = 0; p < job->header.players; p++)
+    {
+        DatasetRecord *first = records + count;
+        Board board;
+        bool topOut = false;
+        int move = 0;
+
+        InitBoard(&board);
+        randomState = seed ^ ((unsigned long long)p << 56);
+
+        int incoming = GetRandomPieceType(set, 0, GetSeedRandomValue);
+
+        for (; move < job->header.maxPieces; move++)
+        {
+            int queue[BOT_MAX_DEPTH] = { incoming, GetRandomPieceType(set, lines[p], GetSeedRandomValue), BOT_ANY_PIECE };
+            PiecePosition start = SpawnPiece(set, &board, queue[0]);
+            Placement best;
+
+            incoming = queue[1];
+
+            if (!SearchPlacement(set, NULL, &board, start, queue, job->header.depth, NULL, NULL, &best))
+            {
+                topOut = true;
+                break;
+            }
+
+            DatasetRecord *record = &records[count++];
+
+            memset(record, 0, sizeof(DatasetRecord));
+            record->seed = seed;
+            PackDatasetBoard(&board, record->board);
+            record->player = (unsigned char)p;
+            record->piece = (unsigned char)queue[0];
+            record->incoming = (unsigned char)queue[1];
+            record->rotation = (unsigned char)best.position.rotation;
+            record->x = (signed char)best.position.x;
+            record->y = (signed char)best.position.y;
+            record->move = move;
+
+            record->lines = (unsigned char)LockPiece(set, &board, best.position);
+            lines[p] += record->lines;
+
+            if (IsBoardOver(&board))
+            {
+                topOut = true;
+                move++;
+                break;
+            }
+        }
+
+        for (DatasetRecord *record = first; record < records + count; record++)
+        {
+            record->totalLines = lines[p];
+            record->totalMoves = move;
+            record->topOut = topOut;
+        }
+
+        if (lines[p] > mostLines) mostLines = lines[p];
+    }
+
+    for (int r = 0; r < count; r++) records[r].won = (lines[records[r].player] == mostLines);
+
+    return count;
+}
+
+// SplitMix64 like the game, state is per thread so GetRandomPieceType() can call it
+static int GetSeedRandomValue(int min, int max)
+{
+    if (max < min)
+    {
+        int swap = max;
+        max = min;
+        min = swap;
+    }
+
+    unsigned long long z = (randomState += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+    z ^= z >> 31;
+
+    return min + (int)(z%((unsigned long long)max - min + 1));
+}
+
+// Decode every chunk, check records against the pieces and replay their placements
+static int CheckDataset(const PieceSet *set, int fileCount, char **fileNames)
+{
+    static DatasetHeader header;
+    static PieceSet pieceSet;
+    PieceSet *fileSet = &pieceSet;
+    DatasetChunk chunk = { 0 };
+    unsigned long long totalRecords = 0;
+    unsigned long long totalBytes = 0;
+    int failed = 0;
+    double start = GetSeconds();
+
+    for (int f = 0; f < fileCount; f++)
+    {
+        FILE *file = fopen(fileNames[f], "rb");
+
+        if ((file == NULL) || !ReadDatasetHeader(file, &header))
+        {
+            printf("%s: not a dataset file\n", fileNames[f]);
+            if (file != NULL) fclose(file);
+            failed++;
+            continue;
+        }
+
+        unsigned long long records = 0;
+        unsigned long long matches = 0;
+        unsigned long long lines = 0;
+        unsigned long long seed = header.firstSeed;
+        int bad = 0;
+        int result;
+
+        if (!LoadPieceSetFromMemory(fileSet, header.pieces)) *fileSet = *set;
+
+        while ((result = ReadDatasetChunk(file, &chunk)) > 0)
+        {
+            if (chunk.firstSeed != seed) bad++;
+            seed = chunk.nextSeed;
+            matches += chunk.nextSeed - chunk.firstSeed;
+
+            for (int r = 0; r < chunk.count; r++)
+            {
+                const DatasetRecord *record = &chunk.records[r];
+                PiecePosition position = { record->piece, record->rotation, record->x, record->y };
+                Board board;
+
+                if ((record->piece >= fileSet->typeCount) || (record->incoming >= fileSet->typeCount) ||
+                    (record->rotation >= PIECE_ROTATIONS) || (record->player >= header.players))
+                {
+                    bad++;
+                    continue;
+                }
+
+                // The chosen placement must fit the board and delete the recorded lines
+                UnpackDatasetBoard(record->board, &board);
+                board.hash = HashBoard(&board);
+                if (!PieceFits(fileSet, &board, position) || (LockPiece(fileSet, &board, position) != record->lines)) bad++;
+
+                lines += record->lines;
+            }
+
+            records += chunk.count;
+        }
+
+        long size = ftell(file);
+
+        printf("%s: seeds %llu-%llu of %llu-%llu, %llu matches, %llu positions, %llu lines, %.1f bytes/position%s\n",
+               fileNames[f], header.firstSeed, seed, header.firstSeed, header.endSeed, matches, records, lines,
+               (records > 0)? (double)size/records : 0.0, (result < 0)? ", last chunk cut short" : "");
+
+        if (bad > 0)
+        {
+            printf("%s: %d records or chunks do not match\n", fileNames[f], bad);
+            failed++;
+        }
+
+        totalRecords += records;
+        totalBytes += size;
+        fclose(file);
+    }
+
+    double seconds = GetSeconds() - start;
+
+    printf("%llu positions, %llu bytes, read in %.2f s, %.0f positions/s\n", totalRecords, totalBytes, seconds, totalRecords/seconds);
+
+    UnloadDatasetChunk(&chunk);
+
+    return (failed == 0)? 0 : 1;
+}
+
+static double GetSeconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec/1e9;
+}
@@ -0,0 +1,764 @@
+/*******************************************************************************************
+*
+*   tetris42 - headless match server
+*
+*   Hosts lobbies of one to four boards, every one stepped at the game's 60 ticks per
+*   second with the match instance logic (game.h) on a work-stealing pool (workpool.h).
+*   Each lobby has a home worker that releases its ticks when they are due, any idle
+*   worker may run them, so busy lobbies piling up on one worker do not hold up the quiet
+*   ones behind them. Lobbies start spread over the tick period.
+*
+*   A load generator plays the clients: every 60th of a second it queues one input frame
+*   per lobby, random keys of busy or quiet players, and reads back the packets the lobby
+*   sent, the piece and the locked rows XORed against the last packet, restarting boards
+*   that are over. Lobbies and clients talk through single producer single consumer rings.
+*
+*   A tick misses its deadline when it is done after the next one is due. The report has
+*   misses per lobby size, how long after they were due ticks were done, and the time every
+*   worker (pinned one per core) spent running ticks, the utilization of its core.
+*   --saturate ticks every lobby as fast as it can, --sweep does so with 1, 2, 4... workers
+*   up to --threads and prints throughput against one worker.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L     // clock_gettime(), nanosleep() and sysconf()
+
+#include "game.h"
+#include "workpool.h"
+#include "codec.h"
+#include "zobrist.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define MAX_LOBBIES             4096
+#define MAX_GENERATORS          64
+#define TICK_RATE               60
+#define MAX_BACKLOG             15      // Ticks a lobby may fall behind, older ones are skipped
+#define INPUT_QUEUE_SIZE        8       // Input frames on the way to a lobby
+#define PACKET_QUEUE_SIZE       8       // Packets on the way to the clients
+#define PACKET_SIZE             512     // Four boards of rows that all changed fit
+#define SERVER_BUCKET_TIME      0.05    // Milliseconds per histogram bucket
+#define SERVER_BUCKETS          2000    // The last one holds 100 ms and longer
+#define REPORT_INTERVAL         5.0     // Seconds between progress lines
+
+// Clients
+#define BUSY_PACE               8       // Frames between presses of a busy player, on average
+#define QUIET_PACE              60
+#define RESTART_CHANCE          20      // One in this many frames ENTER goes down on a board that is over
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct InputFrame {
+    BoardInput input[GAME_BOARDS];
+} InputFrame;
+
+typedef struct Packet {
+    int size;
+    unsigned char bytes[PACKET_SIZE];
+} Packet;
+
+typedef struct Lobby {
+    WorkItem item;                      // First, the pool hands back the lobby
+    GameMatch match;
+    int home;                           // Worker releasing its ticks
+    double nextTick;                    // When the next tick is due, written by the worker running the tick
+    atomic_bool inFlight;               // Released and not done yet
+    InputFrame inputs[INPUT_QUEUE_SIZE];
+    atomic_uint inputHead;              // Written by the load generator
+    atomic_uint inputTail;              // Written by the tick
+    Packet packets[PACKET_QUEUE_SIZE];
+    atomic_uint packetHead;             // Written by the tick
+    atomic_uint packetTail;             // Written by the load generator
+    unsigned short sent[GAME_BOARDS][GRID_VERTICAL_SIZE];   // Locked rows the clients have
+} Lobby;
+
+// Ticks a worker ran, written by it only
+typedef struct ServerWorker {
+    atomic_ullong ticks[GAME_BOARDS + 1];       // By players of the lobby
+    atomic_ullong misses[GAME_BOARDS + 1];
+    atomic_ullong skipped;                      // Given up by lobbies too far behind
+    atomic_ullong packetsDropped;               // Clients not reading
+    atomic_uint doneBuckets[SERVER_BUCKETS];    // Time from due to done
+    atomic_bool rescan;                         // A home lobby is done, set by whoever ran it
+    double nextScan;                            // Of the worker only
+    char padding[64];
+} ServerWorker;
+
+// Simulated player of a board
+typedef struct Client {
+    unsigned long long random;
+    int pace;                           // Frames between presses on average
+    int wait;                           // Frames to the next press
+    int holdFrames;                     // Left or right held
+    bool left;
+    int fallFrames;                     // Fast fall held
+    bool over;                          // In the last packet
+} Client;
+
+typedef struct LobbyClients {
+    Client client[GAME_BOARDS];
+    unsigned short rows[GAME_BOARDS][GRID_VERTICAL_SIZE];  // Mirror of the locked squares
+    unsigned int tick;                  // Of the last packet
+} LobbyClients;
+
+typedef struct Generator {
+    pthread_t thread;
+    int index;
+    atomic_ullong inputs;
+    atomic_ullong inputsDropped;        // The lobby is behind
+    atomic_ullong packets;
+    atomic_ullong bytes;
+    atomic_ullong errors;               // Packets that did not decode
+    atomic_ullong games;                // Seen ending
+} Generator;
+
+// Sums over workers and generators
+typedef struct ServerTotals {
+    unsigned long long ticks[GAME_BOARDS + 1];
+    unsigned long long misses[GAME_BOARDS + 1];
+    unsigned long long allTicks;
+    unsigned long long allMisses;
+    unsigned long long allSteals;
+    unsigned long long skipped;
+    unsigned long long packetsDropped;
+    unsigned long long doneBuckets[SERVER_BUCKETS];
+    unsigned long long busyTime[MAX_WORKERS];   // Nanoseconds
+    unsigned long long items[MAX_WORKERS];
+    unsigned long long steals[MAX_WORKERS];
+    unsigned long long inputs;
+    unsigned long long inputsDropped;
+    unsigned long long packets;
+    unsigned long long bytes;
+    unsigned long long errors;
+    unsigned long long games;
+} ServerTotals;
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static PieceSet *pieceSet = NULL;
+static int lobbyCount = 400;
+static int generatorCount = 1;
+static unsigned long long seed = 1;
+static bool saturate = false;           // No deadlines, lobbies tick again as soon as they are done
+static bool pin = true;
+static double period = 1.0/TICK_RATE;
+
+static Lobby *lobbies = NULL;
+static LobbyClients *clients = NULL;
+static ServerWorker *workers = NULL;
+static int workerCount = 0;
+static Generator generators[MAX_GENERATORS];
+static atomic_bool generating;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static bool RunServer(int threads, double seconds, bool progress, ServerTotals *totals);
+static void InitLobby(int index, unsigned long long *random, double start);
+static double PollLobbies(WorkPool *pool, int worker);
+static void RunTick(WorkItem *item, int worker);
+static void SendPacket(Lobby *lobby, ServerWorker *stats);
+static void *GeneratorThread(void *data);
+static void ReceivePackets(Lobby *lobby, LobbyClients *lobbyClients, Generator *generator);
+static void SendInputs(Lobby *lobby, LobbyClients *lobbyClients, Generator *generator);
+static void UpdateClient(Client *client, BoardInput *input);
+static void GetPlayedBoards(int players, int *first, int *end);
+static void SumTotals(const WorkPool *pool, ServerTotals *totals);
+static void ReportServer(const ServerTotals *totals, const WorkPool *pool, double seconds);
+static double GetBucketPercentile(const unsigned long long *buckets, unsigned long long count, double fraction);
+static unsigned long long NextRandom(unsigned long long *state);
+static void Add(atomic_ullong *counter, unsigned long long value);
+static void WaitSeconds(double seconds);
+
+//------------------------------------------------------------------------------------
+// Program main entry point
+//------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    const char *piecesFile = NULL;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    double seconds = 10;
+    bool sweep = false;
+    bool usage = false;
+
+    for (int a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "--lobbies") == 0) && (a + 1 < argc)) lobbyCount = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--threads") == 0) && (a + 1 < argc)) threads = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--clients") == 0) && (a + 1 < argc)) generatorCount = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--seconds") == 0) && (a + 1 < argc)) seconds = atof(argv[++a]);
+        else if ((strcmp(argv[a], "--seed") == 0) && (a + 1 < argc)) seed = strtoull(argv[++a], NULL, 10);
+        else if ((strcmp(argv[a], "--pieces") == 0) && (a + 1 < argc)) piecesFile = argv[++a];
+        else if (strcmp(argv[a], "--saturate") == 0) saturate = true;
+        else if (strcmp(argv[a], "--sweep") == 0) sweep = true;
+        else if (strcmp(argv[a], "--no-pin") == 0) pin = false;
+        else usage = true;
+    }
+
+    if (threads < 1) threads = 1;
+
+    if (usage || (lobbyCount < 1) || (lobbyCount > MAX_LOBBIES) || (threads > MAX_WORKERS) ||
+        (generatorCount < 1) || (generatorCount > MAX_GENERATORS) || (seconds <= 0))
+    {
+        printf("Usage: tetris42-server [options]\n"
+               "  --lobbies <n>            lobbies of 1 to 4 boards, 400 by default, at most %d\n"
+               "  --threads <n>            workers, all cores by default\n"
+               "  --clients <n>            load generator threads playing the clients, 1 by default\n"
+               "  --seconds <s>            run time, 10 by default\n"
+               "  --seed <n>               lobby sizes, player paces and piece sequences, 1 by default\n"
+               "  --pieces <file>          piece set, built-in pieces by default\n"
+               "  --saturate               tick lobbies as fast as possible, no deadlines\n"
+               "  --sweep                  saturated runs with 1, 2, 4... workers up to --threads\n"
+               "  --no-pin                 leave workers to the scheduler instead of one per core\n", MAX_LOBBIES);
+        return 1;
+    }
+
+    pieceSet = malloc(sizeof(PieceSet));
+
+    InitZobrist();
+
+    if (piecesFile == NULL) LoadDefaultPieceSet(pieceSet);
+    else if (!LoadPieceSet(pieceSet, piecesFile))
+    {
+        printf("Can not load pieces from %s.\n", piecesFile);
+        return 1;
+    }
+
+    static ServerTotals totals;
+    bool started = true;
+
+    if (sweep)
+    {
+        double single = 0;
+
+        saturate = true;
+        printf("Saturated %d lobbies, %.0f s per run\n", lobbyCount, seconds);
+
+        for (int w = 1; started; w = (2*w < threads)? 2*w : threads)
+        {
+            started = RunServer(w, seconds, false, &totals);
+
+            double rate = totals.allTicks/seconds;
+
+            if (w == 1) single = rate;
+            printf("%4d workers %12.0f ticks/s, %6.2fx one worker, %5.1f%% efficiency, %llu stolen\n",
+                   w, rate, rate/single, 100*rate/(single*w), totals.allSteals);
+
+            if (w == threads) break;
+        }
+    }
+    else started = RunServer(threads, seconds, true, &totals);
+
+    free(pieceSet);
+
+    if (!started) printf("Can not start the server threads.\n");
+
+    return started? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static bool RunServer(int threads, double seconds, bool progress, ServerTotals *totals)
+{
+    static WorkPool pool;
+    unsigned long long random = seed;
+    bool started = true;
+
+    workerCount = threads;
+    lobbies = (Lobby *)calloc(lobbyCount, sizeof(Lobby));
+    clients = (LobbyClients *)calloc(lobbyCount, sizeof(LobbyClients));
+    workers = (ServerWorker *)calloc(threads, sizeof(ServerWorker));
+
+    if ((lobbies == NULL) || (clients == NULL) || (workers == NULL)) started = false;
+
+    double start = GetWorkTime();
+
+    for (int l = 0; started && (l < lobbyCount); l++) InitLobby(l, &random, start);
+
+    atomic_store(&generating, true);
+
+    int generatorsStarted = 0;
+
+    for (int g = 0; started && (g < generatorCount); g++)
+    {
+        memset(&generators[g], 0, sizeof(Generator));
+        generators[g].index = g;
+        started = (pthread_create(&generators[g].thread, NULL, GeneratorThread, &generators[g]) == 0);
+        if (started) generatorsStarted++;
+    }
+
+    started = started && InitWorkPool(&pool, threads, PollLobbies, NULL, pin);
+
+    if (started)
+    {
+        double last = 0;
+
+        if (progress)
+        {
+            int boards = 0;
+
+            for (int l = 0; l < lobbyCount; l++) boards += lobbies[l].match.players;
+            printf("Serving %d lobbies (%d boards) %s on %d workers, %d client generator%s\n", lobbyCount, boards,
+                   saturate? "saturated" : "at 60 Hz", threads, generatorCount, (generatorCount == 1)? "" : "s");
+        }
+
+        for (double now = 0; now < seconds; now = GetWorkTime() - start)
+        {
+            WaitSeconds(((seconds - now) < 0.1)? (seconds - now) : 0.1);
+
+            if (progress && (GetWorkTime() - start - last >= REPORT_INTERVAL))
+            {
+                last += REPORT_INTERVAL;
+                SumTotals(&pool, totals);
+                printf("%6.0f s %12llu ticks %8llu misses\n", last, totals->allTicks, totals->allMisses);
+            }
+        }
+
+        seconds = GetWorkTime() - start;
+        SumTotals(&pool, totals);
+        if (progress) ReportServer(totals, &pool, seconds);
+        UnloadWorkPool(&pool);
+    }
+
+    atomic_store(&generating, false);
+    for (int g = 0; g < generatorsStarted; g++) pthread_join(generators[g].thread, NULL);
+
+    free(lobbies);
+    free(clients);
+    free(workers);
+
+    return started;
+}
+
+// Random size and players, phases spread over the tick period
+static void InitLobby(int index, unsigned long long *random, double start)
+{
+    Lobby *lobby = &lobbies[index];
+    LobbyClients *lobbyClients = &clients[index];
+    int players = 1 + (int)(NextRandom(random)%GAME_BOARDS);
+    bool busy = (NextRandom(random)%2 == 0);
+
+    InitGameMatch(&lobby->match, players, NextRandom(random));
+
+    lobby->item.run = RunTick;
+    lobby->home = index%workerCount;
+    lobby->nextTick = start + period*index/lobbyCount;
+    atomic_init(&lobby->inFlight, false);
+    atomic_init(&lobby->inputHead, 0);
+    atomic_init(&lobby->inputTail, 0);
+    atomic_init(&lobby->packetHead, 0);
+    atomic_init(&lobby->packetTail, 0);
+
+    for (int b = 0; b < GAME_BOARDS; b++)
+    {
+        Client *client = &lobbyClients->client[b];
+
+        client->random = NextRandom(random);
+        client->pace = busy? BUSY_PACE : QUIET_PACE;
+        client->wait = 1 + (int)(NextRandom(random)%client->pace);
+    }
+}
+
+// Releases due home lobbies, scans again when one is done or the earliest is due
+static double PollLobbies(WorkPool *pool, int worker)
+{
+    ServerWorker *home = &workers[worker];
+    double now = GetWorkTime();
+
+    if (!atomic_exchange_explicit(&home->rescan, false, memory_order_acquire) && (now < home->nextScan)) return home->nextScan - now;
+
+    double next = now + period;
+
+    for (int l = worker; l < lobbyCount; l += workerCount)
+    {
+        Lobby *lobby = &lobbies[l];
+
+        if (atomic_load_explicit(&lobby->inFlight, memory_order_acquire)) continue;
+
+        if (!saturate && (lobby->nextTick > now))
+        {
+            if (lobby->nextTick < next) next = lobby->nextTick;
+            continue;
+        }
+
+        atomic_store_explicit(&lobby->inFlight, true, memory_order_relaxed);
+
+        if (!PushWork(pool, worker, &lobby->item))
+        {
+            atomic_store_explicit(&lobby->inFlight, false, memory_order_relaxed);
+            next = now;
+            break;
+        }
+    }
+
+    home->nextScan = next;
+
+    return next - now;
+}
+
+static void RunTick(WorkItem *item, int worker)
+{
+    Lobby *lobby = (Lobby *)item;
+    ServerWorker *stats = &workers[worker];
+    int players = lobby->match.players;
+    InputFrame frame = { 0 };
+    unsigned int tail = atomic_load_explicit(&lobby->inputTail, memory_order_relaxed);
+
+    // One input frame per tick, a tick without one has no keys down
+    if (tail != atomic_load_explicit(&lobby->inputHead, memory_order_acquire))
+    {
+        frame = lobby->inputs[tail%INPUT_QUEUE_SIZE];
+        atomic_store_explicit(&lobby->inputTail, tail + 1, memory_order_release);
+    }
+
+    StepGameMatch(pieceSet, &lobby->match, frame.input);
+    SendPacket(lobby, stats);
+
+    double now = GetWorkTime();
+    double late = now - lobby->nextTick;
+
+    Add(&stats->ticks[players], 1);
+
+    if (saturate) lobby->nextTick = now;
+    else
+    {
+        int bucket = (late > 0)? (int)(1000*late/SERVER_BUCKET_TIME) : 0;
+        atomic_uint *counter = &stats->doneBuckets[(bucket < SERVER_BUCKETS)? bucket : SERVER_BUCKETS - 1];
+
+        atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+        if (late > period) Add(&stats->misses[players], 1);
+
+        lobby->nextTick += period;
+
+        // Too far behind to catch up, the game only slows down
+        int behind = (int)((now - lobby->nextTick)/period);
+
+        if (behind > MAX_BACKLOG)
+        {
+            Add(&stats->skipped, behind);
+            lobby->nextTick += behind*period;
+        }
+    }
+
+    atomic_store_explicit(&lobby->inFlight, false, memory_order_release);
+    atomic_store_explicit(&workers[lobby->home].rescan, true, memory_order_release);
+}
+
+// Tick, pause and per board the piece, counters and locked rows changed since the last packet
+static void SendPacket(Lobby *lobby, ServerWorker *stats)
+{
+    unsigned int head = atomic_load_explicit(&lobby->packetHead, memory_order_relaxed);
+
+    // Rows are XORed against the last packet the clients got
+    if (head - atomic_load_explicit(&lobby->packetTail, memory_order_acquire) >= PACKET_QUEUE_SIZE)
+    {
+        Add(&stats->packetsDropped, 1);
+        return;
+    }
+
+    const GameMatch *match = &lobby->match;
+    Packet *packet = &lobby->packets[head%PACKET_QUEUE_SIZE];
+    CodecWriter writer = { packet->bytes, 0, PACKET_SIZE, false };
+    int first, end;
+
+    PutVarint(&writer, match->tick);
+    PutByte(&writer, match->pause);
+
+    GetPlayedBoards(match->players, &first, &end);
+
+    for (int b = first; b < end; b++)
+    {
+        const GameBoard *board = &match->board[b];
+        unsigned short rows[GRID_VERTICAL_SIZE];
+
+        for (int j = 0; j < GRID_VERTICAL_SIZE; j++) rows[j] = (board->rows[FULL][j] | board->rows[FADING][j]) & GAME_COLUMNS;
+
+        PutByte(&writer, board->gameOver | (board->pieceActive << 1) | (board->lineToDelete << 2));
+        PutByte(&writer, board->pieceType);
+        PutByte(&writer, board->pieceRotation);
+        PutSigned(&writer, board->piecePositionX);
+        PutVarint(&writer, board->piecePositionY);
+        PutByte(&writer, board->incomingType + 1);
+        PutVarint(&writer, board->lines);
+        PutXorRows(&writer, rows, lobby->sent[b], GRID_VERTICAL_SIZE);
+
+        memcpy(lobby->sent[b], rows, sizeof(rows));
+    }
+
+    packet->size = writer.size;
+    atomic_store_explicit(&lobby->packetHead, head + 1, memory_order_release);
+}
+
+static void *GeneratorThread(void *data)
+{
+    Generator *generator = (Generator *)data;
+    double next = GetWorkTime();
+
+    while (atomic_load_explicit(&generating, memory_order_relaxed))
+    {
+        for (int l = generator->index; l < lobbyCount; l += generatorCount)
+        {
+            ReceivePackets(&lobbies[l], &clients[l], generator);
+            SendInputs(&lobbies[l], &clients[l], generator);
+        }
+
+        // Frames lost when the generator is behind are not made up
+        next += period;
+        if (next < GetWorkTime()) next = GetWorkTime();
+        WaitSeconds(next - GetWorkTime());
+    }
+
+    return NULL;
+}
+
+// Clients keep their copy of the locked rows and see which boards are over
+static void ReceivePackets(Lobby *lobby, LobbyClients *lobbyClients, Generator *generator)
+{
+    unsigned int tail = atomic_load_explicit(&lobby->packetTail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&lobby->packetHead, memory_order_acquire);
+    int first, end;
+
+    GetPlayedBoards(lobby->match.players, &first, &end);
+
+    for (; tail != head; tail++)
+    {
+        const Packet *packet = &lobby->packets[tail%PACKET_QUEUE_SIZE];
+        CodecReader reader = { packet->bytes, packet->size, 0, false };
+
+        lobbyClients->tick = (unsigned int)GetVarint(&reader);
+        GetByte(&reader);
+
+        for (int b = first; b < end; b++)
+        {
+            unsigned int flags = GetByte(&reader);
+
+            GetByte(&reader);
+            GetByte(&reader);
+            GetSigned(&reader);
+            GetVarint(&reader);
+            GetByte(&reader);
+            GetVarint(&reader);
+            GetXorRows(&reader, lobbyClients->rows[b], lobbyClients->rows[b], GRID_VERTICAL_SIZE);
+
+            if ((flags & 1) && !lobbyClients->client[b].over) Add(&generator->games, 1);
+            lobbyClients->client[b].over = (flags & 1);
+        }
+
+        if (reader.error || (reader.position != reader.size)) Add(&generator->errors, 1);
+        Add(&generator->packets, 1);
+        Add(&generator->bytes, packet->size);
+    }
+
+    atomic_store_explicit(&lobby->packetTail, tail, memory_order_release);
+}
+
+static void SendInputs(Lobby *lobby, LobbyClients *lobbyClients, Generator *generator)
+{
+    unsigned int head = atomic_load_explicit(&lobby->inputHead, memory_order_relaxed);
+    int first, end;
+
+    if (head - atomic_load_explicit(&lobby->inputTail, memory_order_acquire) >= INPUT_QUEUE_SIZE)
+    {
+        Add(&generator->inputsDropped, 1);
+        return;
+    }
+
+    InputFrame *frame = &lobby->inputs[head%INPUT_QUEUE_SIZE];
+
+    memset(frame, 0, sizeof(InputFrame));
+    GetPlayedBoards(lobby->match.players, &first, &end);
+
+    for (int b = first; b < end; b++) UpdateClient(&lobbyClients->client[b], &frame->input[b]);
+
+    atomic_store_explicit(&lobby->inputHead, head + 1, memory_order_release);
+    Add(&generator->inputs, 1);
+}
+
+// Presses at random about every pace frames: moves held for a while, turns, fast falls
+static void UpdateClient(Client *client, BoardInput *input)
+{
+    if (client->over)
+    {
+        input->restartPressed = (NextRandom(&client->random)%RESTART_CHANCE == 0);
+        return;
+    }
+
+    if (client->holdFrames > 0)
+    {
+        client->holdFrames--;
+        input->left = client->left;
+        input->right = !client->left;
+    }
+
+    if (client->fallFrames > 0)
+    {
+        client->fallFrames--;
+        input->fastFall = true;
+    }
+
+    if (--client->wait > 0) return;
+
+    unsigned long long random = NextRandom(&client->random);
+
+    client->wait = 1 + client->pace/2 + (int)(random%client->pace);
+    random /= client->pace;
+
+    switch (random%4)
+    {
+        case 0:
+        case 1:
+        {
+            client->left = (random/4)%2;
+            client->holdFrames = (int)((random/8)%(2*LATERAL_SPEED));
+            input->movePressed = true;
+            input->left = client->left;
+            input->right = !client->left;
+        } break;
+        case 2:
+        {
+            input->turnPressed = true;
+            input->turn = true;
+        } break;
+        default: client->fallFrames = (int)((random/4)%(2*FAST_FALL_AWAIT_COUNTER)); break;
+    }
+}
+
+// Board 1 alone for one player, like the game
+static void GetPlayedBoards(int players, int *first, int *end)
+{
+    *first = (players == 1)? 1 : 0;
+    *end = (players == 1)? 2 : players;
+}
+
+static void SumTotals(const WorkPool *pool, ServerTotals *totals)
+{
+    memset(totals, 0, sizeof(ServerTotals));
+
+    for (int w = 0; w < workerCount; w++)
+    {
+        ServerWorker *stats = &workers[w];
+
+        for (int p = 1; p <= GAME_BOARDS; p++)
+        {
+            totals->ticks[p] += atomic_load_explicit(&stats->ticks[p], memory_order_relaxed);
+            totals->misses[p] += atomic_load_explicit(&stats->misses[p], memory_order_relaxed);
+        }
+
+        totals->skipped += atomic_load_explicit(&stats->skipped, memory_order_relaxed);
+        totals->packetsDropped += atomic_load_explicit(&stats->packetsDropped, memory_order_relaxed);
+        for (int b = 0; b < SERVER_BUCKETS; b++) totals->doneBuckets[b] += atomic_load_explicit(&stats->doneBuckets[b], memory_order_relaxed);
+
+        totals->busyTime[w] = atomic_load_explicit(&pool->stats[w].busyTime, memory_order_relaxed);
+        totals->items[w] = atomic_load_explicit(&pool->stats[w].items, memory_order_relaxed);
+        totals->steals[w] = atomic_load_explicit(&pool->stats[w].steals, memory_order_relaxed);
+        totals->allSteals += totals->steals[w];
+    }
+
+    for (int p = 1; p <= GAME_BOARDS; p++)
+    {
+        totals->allTicks += totals->ticks[p];
+        totals->allMisses += totals->misses[p];
+    }
+
+    for (int g = 0; g < generatorCount; g++)
+    {
+        totals->inputs += atomic_load_explicit(&generators[g].inputs, memory_order_relaxed);
+        totals->inputsDropped += atomic_load_explicit(&generators[g].inputsDropped, memory_order_relaxed);
+        totals->packets += atomic_load_explicit(&generators[g].packets, memory_order_relaxed);
+        totals->bytes += atomic_load_explicit(&generators[g].bytes, memory_order_relaxed);
+        totals->errors += atomic_load_explicit(&generators[g].errors, memory_order_relaxed);
+        totals->games += atomic_load_explicit(&generators[g].games, memory_order_relaxed);
+    }
+}
+
+static void ReportServer(const ServerTotals *totals, const WorkPool *pool, double seconds)
+{
+    unsigned long long busyTime = 0;
+
+    printf("Served %.1f s, %llu ticks, %.0f per second, %llu skipped\n", seconds, totals->allTicks, totals->allTicks/seconds, totals->skipped);
+
+    if (!saturate)
+    {
+        printf("Deadline misses %llu (%.3f%%)", totals->allMisses, totals->allTicks? 100.0*totals->allMisses/totals->allTicks : 0.0);
+        for (int p = 1; p <= GAME_BOARDS; p++) printf(", %d board%s %llu of %llu", p, (p == 1)? "" : "s", totals->misses[p], totals->ticks[p]);
+        printf("\n");
+
+        printf("Ticks done after due %.2f ms p50, %.2f ms p99, %.2f ms p99.9\n",
+               GetBucketPercentile(totals->doneBuckets, totals->allTicks, 0.5),
+               GetBucketPercentile(totals->doneBuckets, totals->allTicks, 0.99),
+               GetBucketPercentile(totals->doneBuckets, totals->allTicks, 0.999));
+    }
+
+    for (int w = 0; w < workerCount; w++)
+    {
+        int cpu = atomic_load(&pool->stats[w].cpu);
+
+        busyTime += totals->busyTime[w];
+
+        if (cpu >= 0) printf("Worker %3d on core %3d", w, cpu);
+        else printf("Worker %3d            ", w);
+        printf(" busy %5.1f%%, %10llu ticks, %8llu stolen\n", 100*totals->busyTime[w]/1e9/seconds, totals->items[w], totals->steals[w]);
+    }
+
+    if (totals->allTicks > 0)
+    {
+        double tickTime = busyTime/1e9/totals->allTicks;
+
+        printf("Busy %.2f cores, %.2f us per tick, %.0f lobbies at 60 Hz per core\n", busyTime/1e9/seconds, 1e6*tickTime, 1/(tickTime*TICK_RATE));
+    }
+
+    printf("Clients sent %llu input frames (%llu dropped), got %llu packets of %.1f bytes (%llu dropped, %llu bad), %llu games ended\n",
+           totals->inputs, totals->inputsDropped, totals->packets, totals->packets? (double)totals->bytes/totals->packets : 0.0,
+           totals->packetsDropped, totals->errors, totals->games);
+}
+
+// Milliseconds at the upper edge of the bucket the fraction falls in
+static double GetBucketPercentile(const unsigned long long *buckets, unsigned long long count, double fraction)
+{
+    unsigned long long rank = (unsigned long long)(fraction*count + 0.999999);
+    unsigned long long total = 0;
+
+    for (int b = 0; b < SERVER_BUCKETS; b++)
+    {
+        total += buckets[b];
+        if (total >= rank) return (b + 1)*SERVER_BUCKET_TIME;
+    }
+
+    return SERVER_BUCKETS*SERVER_BUCKET_TIME;
+}
+
+// SplitMix64
+static unsigned long long NextRandom(unsigned long long *state)
+{
+    unsigned long long z = (*state += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+
+    return z ^ (z >> 31);
+}
+
+// Counters have a single writer
+static void Add(atomic_ullong *counter, unsigned long long value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static void WaitSeconds(double seconds)
+{
+    struct timespec time = { (time_t)seconds, (long)((seconds - (time_t)seconds)*1e9) };
+
+    if (seconds > 0) nanosleep(&time, NULL);
+}
@@ -0,0 +1,292 @@
+/*******************************************************************************************
+*
+*   tetris42 - shared memory export reader
+*
+*   Prints the boards a running game publishes with --shm, as an example for overlays.
+*   With --bench it measures the publish cost per board and per tick, alone and with a
+*   reader copying all boards in a loop, and how late readers see a new tick.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L     // clock_gettime() and nanosleep()
+
+#include "export.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define BENCH_NAME              "/tetris42-bench"
+#define BENCH_TICKS             1000000
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct BenchReader {
+    const ExportRegion *region;
+    const double *published;            // Publish time of every tick
+    double *latency;                    // Time until the reader saw every tick, 0 when missed
+    atomic_bool stop;
+    unsigned long long reads;
+    int retries;
+    int failures;
+} BenchReader;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static double GetSeconds(void);
+static void PrintBoard(const BoardState *state, bool grid);
+static void FillBenchState(BoardState *state, unsigned int tick, int board);
+static double PublishTicks(int ticks, double *published);
+static void *BenchReaderWorker(void *data);
+static int CompareDoubles(const void *a, const void *b);
+static int RunBench(int ticks);
+
+//------------------------------------------------------------------------------------
+// Program main entry point
+//------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    const char *name = EXPORT_NAME;
+    int interval = 500;
+    int count = 0;
+    bool grid = false;
+
+    for (int a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "--bench") == 0) return RunBench((a + 1 < argc)? atoi(argv[a + 1]) : BENCH_TICKS);
+        else if ((strcmp(argv[a], "--name") == 0) && (a + 1 < argc)) name = argv[++a];
+        else if ((strcmp(argv[a], "--interval") == 0) && (a + 1 < argc)) interval = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--count") == 0) && (a + 1 < argc)) count = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--grid") == 0) grid = true;
+        else
+        {
+            printf("usage: tetris42-shmread [--name <shm>] [--interval <ms>] [--count <n>] [--grid]\n"
+                   "       tetris42-shmread --bench [ticks]\n"
+                   "  --name <shm>       region name, %s by default (tetris42 --shm)\n"
+                   "  --interval <ms>    time between prints, 500 by default\n"
+                   "  --count <n>        stop after n prints\n"
+                   "  --grid             print the squares of every board\n"
+                   "  --bench [ticks]    measure publish cost and reader latency\n", EXPORT_NAME);
+            return 1;
+        }
+    }
+
+    ExportRegion *region = OpenExport(name);
+
+    if (region == NULL)
+    {
+        printf("No tetris42 export at %s, start the game with --shm.\n", name);
+        return 1;
+    }
+
+    struct timespec wait = { interval/1000, (interval%1000)*1000000L };
+    unsigned int lastTick = 0;
+
+    for (int printed = 0; (count == 0) || (printed < count); printed++)
+    {
+        unsigned int tick = atomic_load_explicit(&region->tick, memory_order_acquire);
+
+        if ((printed == 0) || (tick != lastTick))
+        {
+            printf("tick %u\n", tick);
+
+            for (int b = 0; b < region->boardCount; b++)
+            {
+                BoardState state;
+
+                if (ReadBoardState(region, b, &state, NULL)) PrintBoard(&state, grid);
+                else printf("  board %d busy\n", b);
+            }
+
+            lastTick = tick;
+        }
+
+        nanosleep(&wait, NULL);
+    }
+
+    CloseExport(region);
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static double GetSeconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec*1e-9;
+}
+
+static void PrintBoard(const BoardState *state, bool grid)
+{
+    printf("  %-20s lines %4d  level %2d  piece %3d turn %d at %3d,%3d  incoming %3d%s%s\n", state->name, state->lines, state->level,
+           state->pieceType, state->pieceRotation, state->pieceX, state->pieceY, state->incomingType,
+           state->paused? "  paused" : "", state->gameOver? "  game over" : "");
+
+    if (!grid) return;
+
+    static const char squares[] = { '.', '@', '#', '|', '~' };     // EMPTY, MOVING, FULL, BLOCK, FADING
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+    {
+        char row[GRID_HORIZONTAL_SIZE + 1];
+
+        for (int i = 0; i < GRID_HORIZONTAL_SIZE; i++) row[i] = (state->grid[j][i] <= FADING)? squares[state->grid[j][i]] : '?';
+        row[GRID_HORIZONTAL_SIZE] = '\0';
+
+        printf("    %s\n", row);
+    }
+}
+
+// Game like state, a few squares change every tick
+static void FillBenchState(BoardState *state, unsigned int tick, int board)
+{
+    state->tick = tick;
+    state->lines = tick/600;
+    state->level = 1;
+    state->pieceType = (signed char)(tick/40%22);
+    state->pieceY = (signed char)(tick/30%18);
+    state->grid[tick%(GRID_VERTICAL_SIZE - 1)][1 + (tick + board)%(GRID_HORIZONTAL_SIZE - 2)] ^= FULL;
+}
+
+// Publish every board each tick, returns seconds spent publishing
+static double PublishTicks(int ticks, double *published)
+{
+    BoardState states[EXPORT_BOARDS];
+    double total = 0;
+
+    memset(states, 0, sizeof(states));
+    for (int b = 0; b < EXPORT_BOARDS; b++) snprintf(states[b].name, BOARD_NAME_SIZE, "BENCH %d", b + 1);
+
+    for (int t = 1; t <= ticks; t++)
+    {
+        for (int b = 0; b < EXPORT_BOARDS; b++) FillBenchState(&states[b], t, b);
+
+        double start = GetSeconds();
+
+        for (int b = 0; b < EXPORT_BOARDS; b++) PublishBoardState(b, &states[b]);
+
+        // Noted before the tick goes out, the reader finds it once it sees the tick
+        double end = GetSeconds();
+
+        if (published != NULL) published[t] = end;
+        PublishTick(t);
+
+        total += GetSeconds() - start;
+    }
+
+    return total;
+}
+
+// Copy all boards in a loop, note when every tick is first seen
+static void *BenchReaderWorker(void *data)
+{
+    BenchReader *reader = (BenchReader *)data;
+    unsigned int lastTick = 0;
+
+    while (!atomic_load_explicit(&reader->stop, memory_order_relaxed))
+    {
+        BoardState state;
+
+        for (int b = 0; b < reader->region->boardCount; b++)
+        {
+            if (ReadBoardState(reader->region, b, &state, &reader->retries)) reader->reads++;
+            else reader->failures++;
+        }
+
+        unsigned int tick = atomic_load_explicit(&reader->region->tick, memory_order_acquire);
+
+        if (tick != lastTick)
+        {
+            reader->latency[tick] = GetSeconds() - reader->published[tick];
+            lastTick = tick;
+        }
+    }
+
+    return NULL;
+}
+
+static int CompareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int RunBench(int ticks)
+{
+    if (ticks <= 0) ticks = BENCH_TICKS;
+
+    if (!InitExport(BENCH_NAME, EXPORT_BOARDS))
+    {
+        printf("Can not create %s.\n", BENCH_NAME);
+        return 1;
+    }
+
+    ExportRegion *region = OpenExport(BENCH_NAME);
+    double *published = calloc(ticks + 1, sizeof(double));
+    double *latency = calloc(ticks + 1, sizeof(double));
+
+    if ((region == NULL) || (published == NULL) || (latency == NULL))
+    {
+        printf("Can not map %s.\n", BENCH_NAME);
+        UnloadExport();
+        return 1;
+    }
+
+    // Publishing alone
+    double alone = PublishTicks(ticks, NULL);
+
+    printf("publish alone        %8.1f ns/board %8.1f ns/tick (%d boards, %zu bytes each)\n",
+           alone*1e9/ticks/EXPORT_BOARDS, alone*1e9/ticks, EXPORT_BOARDS, sizeof(BoardState));
+
+    // Publishing while a reader copies all boards
+    BenchReader reader = { region, published, latency, false, 0, 0, 0 };
+    pthread_t thread;
+
+    PublishTick(0);
+    pthread_create(&thread, NULL, BenchReaderWorker, &reader);
+
+    double start = GetSeconds();
+    double shared = PublishTicks(ticks, published);
+    double seconds = GetSeconds() - start;
+
+    atomic_store(&reader.stop, true);
+    pthread_join(thread, NULL);
+
+    printf("publish with reader  %8.1f ns/board %8.1f ns/tick\n", shared*1e9/ticks/EXPORT_BOARDS, shared*1e9/ticks);
+    printf("reader               %8.0f boards/s, %d retries, %d failed reads\n", reader.reads/seconds, reader.retries, reader.failures);
+
+    // Delay until the reader saw a tick, ticks it skipped are not counted
+    int seen = 0;
+
+    for (int t = 1; t <= ticks; t++) if (latency[t] > 0) latency[seen++] = latency[t];
+
+    if (seen > 0)
+    {
+        qsort(latency, seen, sizeof(double), CompareDoubles);
+        printf("tick seen after      %8.1f us median %8.1f us p99 %8.1f us max (%d of %d ticks seen)\n",
+               latency[seen/2]*1e6, latency[seen*99/100]*1e6, latency[seen - 1]*1e6, seen, ticks);
+    }
+
+    CloseExport(region);
+    UnloadExport();
+    free(published);
+    free(latency);
+
+    return 0;
+}
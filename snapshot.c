@@ -0,0 +1,266 @@
+/*******************************************************************************************
+*
+*   tetris42 - match snapshots
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#if !defined(_WIN32) && !defined(PLATFORM_WEB)
+    #define SUPPORT_SNAPSHOT
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "snapshot.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(SUPPORT_SNAPSHOT)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define SNAPSHOT_SYNC_SAVES     16      // Saves between scheduling the saved slot for writing back
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+// Header in front of every state copy
+typedef struct SnapshotSlot {
+    _Atomic unsigned long long sequence;    // 0 while the slot is written
+    unsigned long long checksum;            // Of the state, seeded with the sequence
+    unsigned int magic;
+    unsigned int version;
+    int size;
+    unsigned int reserved;
+} SnapshotSlot;
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static unsigned char *mapping = NULL;
+static size_t mappingSize = 0;
+static size_t slotStride = 0;
+static size_t pageSize = 4096;
+static unsigned int stateVersion = 0;
+static int stateSize = 0;
+static unsigned long long sequence = 0;     // Of the newest slot
+
+static int saves = 0;
+static double saveTime = 0;
+static double maxSaveTime = 0;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static size_t GetSlotStride(int size);
+static unsigned long long GetSlotSequence(const unsigned char *slotData, unsigned int version, int size);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// Map the file for saving, keeps saved slots
+bool OpenSnapshot(const char *fileName, unsigned int version, int size)
+{
+#if defined(SUPPORT_SNAPSHOT)
+    int fd = open(fileName, O_RDWR | O_CREAT, 0644);
+    struct stat info;
+
+    if (fd < 0) return false;
+
+    slotStride = GetSlotStride(size);
+    mappingSize = 2*slotStride;
+
+    // A file of another layout starts over empty
+    if ((fstat(fd, &info) != 0) || (info.st_size != (off_t)mappingSize))
+    {
+        if ((ftruncate(fd, 0) != 0) || (ftruncate(fd, mappingSize) != 0))
+        {
+            close(fd);
+            return false;
+        }
+    }
+
+    void *memory = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    close(fd);
+    if (memory == MAP_FAILED) return false;
+
+    mapping = (unsigned char *)memory;
+    pageSize = (sysconf(_SC_PAGESIZE) > 0)? (size_t)sysconf(_SC_PAGESIZE) : 4096;
+    stateVersion = version;
+    stateSize = size;
+    sequence = 0;
+
+    // Saving goes on after the newest slot, which stays valid until the next save
+    for (int s = 0; s < 2; s++)
+    {
+        unsigned long long slotSequence = GetSlotSequence(mapping + s*slotStride, version, size);
+
+        if (slotSequence > sequence) sequence = slotSequence;
+    }
+
+    return true;
+#else
+    (void)fileName;
+    (void)version;
+    (void)size;
+
+    return false;
+#endif
+}
+
+// Copy into the older slot, never waits
+void SaveSnapshot(const void *state)
+{
+#if defined(SUPPORT_SNAPSHOT)
+    if (mapping == NULL) return;
+
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    unsigned long long next = sequence + 1;
+    SnapshotSlot *slot = (SnapshotSlot *)(mapping + (next & 1)*slotStride);
+
+    atomic_store_explicit(&slot->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    memcpy(slot + 1, state, stateSize);
+    slot->checksum = GetSnapshotChecksum(state, stateSize, next);
+    slot->magic = SNAPSHOT_MAGIC;
+    slot->version = stateVersion;
+    slot->size = stateSize;
+
+    atomic_store_explicit(&slot->sequence, next, memory_order_release);
+    sequence = next;
+
+    // Dirty pages reach the disk anyway, now and then the pages of this slot are scheduled
+    if (next%SNAPSHOT_SYNC_SAVES == 0)
+    {
+        size_t first = ((unsigned char *)slot - mapping)/pageSize*pageSize;
+        size_t last = (next & 1)*slotStride + slotStride;
+
+        msync(mapping + first, last - first, MS_ASYNC);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)*1e-9;
+
+    saves++;
+    saveTime += time;
+    if (time > maxSaveTime) maxSaveTime = time;
+#else
+    (void)state;
+#endif
+}
+
+// Prints save cost
+void CloseSnapshot(void)
+{
+#if defined(SUPPORT_SNAPSHOT)
+    if (mapping == NULL) return;
+
+    if (saves > 0) printf("Snapshots %d saved, %.1f us average, %.1f us max\n", saves, saveTime*1e6/saves, maxSaveTime*1e6);
+
+    // The last save is on disk when the game ends
+    msync(mapping, mappingSize, MS_SYNC);
+    munmap(mapping, mappingSize);
+    mapping = NULL;
+    saves = 0;
+    saveTime = 0;
+    maxSaveTime = 0;
+#endif
+}
+
+// Newest valid slot of this version and size
+bool LoadSnapshot(const char *fileName, unsigned int version, void *state, int size)
+{
+    FILE *file = fopen(fileName, "rb");
+
+    if (file == NULL) return false;
+
+    size_t stride = GetSlotStride(size);
+    unsigned char *data = (unsigned char *)malloc(2*stride);
+    bool loaded = false;
+
+    if ((data != NULL) && (fread(data, 1, 2*stride, file) == 2*stride))
+    {
+        unsigned long long newest = 0;
+        int newestSlot = -1;
+
+        for (int s = 0; s < 2; s++)
+        {
+            unsigned long long slotSequence = GetSlotSequence(data + s*stride, version, size);
+
+            if (slotSequence > newest)
+            {
+                newest = slotSequence;
+                newestSlot = s;
+            }
+        }
+
+        if (newestSlot >= 0)
+        {
+            memcpy(state, data + newestSlot*stride + sizeof(SnapshotSlot), size);
+            loaded = true;
+        }
+    }
+
+    free(data);
+    fclose(file);
+
+    return loaded;
+}
+
+// FNV-1a on 8 byte words, folded so high bits reach low ones
+unsigned long long GetSnapshotChecksum(const void *data, int size, unsigned long long seed)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    unsigned long long hash = 0xcbf29ce484222325ull ^ seed;
+    int i = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        unsigned long long word;
+
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word)*0x100000001b3ull;
+        hash ^= hash >> 29;
+    }
+
+    for (; i < size; i++) hash = (hash ^ bytes[i])*0x100000001b3ull;
+
+    return hash;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+// Header and state, cache line aligned
+static size_t GetSlotStride(int size)
+{
+    return (sizeof(SnapshotSlot) + size + 63)/64*64;
+}
+
+// Sequence of a complete slot, 0 when empty, torn or of another format
+static unsigned long long GetSlotSequence(const unsigned char *slotData, unsigned int version, int size)
+{
+    const SnapshotSlot *slot = (const SnapshotSlot *)slotData;
+    unsigned long long slotSequence = atomic_load_explicit((_Atomic unsigned long long *)&slot->sequence, memory_order_acquire);
+
+    if ((slotSequence == 0) || (slot->magic != SNAPSHOT_MAGIC) || (slot->version != version) || (slot->size != size)) return 0;
+    if (slot->checksum != GetSnapshotChecksum(slotData + sizeof(SnapshotSlot), size, slotSequence)) return 0;
+
+    return slotSequence;
+}
@@ -0,0 +1,37 @@
+/*******************************************************************************************
+*
+*   tetris42 - match snapshots
+*
+*   A snapshot file holds two slots, each a header and one copy of the caller's state.
+*   Saving copies the state into the older slot of a memory-mapped file and stamps it
+*   with a checksum and the next sequence number, so a crash while saving leaves the other
+*   slot intact. Pages go to disk in the background; saving is a memcpy plus a checksum
+*   and never waits for the disk, every 16th save only schedules its slot for writing back
+*   and closing waits for both. Loading takes the valid slot with the highest sequence.
+*
+*   Not available on Windows and in the browser, OpenSnapshot() fails there.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define SNAPSHOT_MAGIC          0x4d323454u     // "T42M"
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+bool OpenSnapshot(const char *fileName, unsigned int version, int size);    // Map the file for saving, keeps saved slots
+void SaveSnapshot(const void *state);                                       // Copy into the older slot, never waits
+void CloseSnapshot(void);                                                   // Prints save cost
+bool LoadSnapshot(const char *fileName, unsigned int version, void *state, int size);  // Newest valid slot of this version and size
+unsigned long long GetSnapshotChecksum(const void *data, int size, unsigned long long seed);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,597 @@
+/*******************************************************************************************
+*
+*   tetris42 - spectator stream
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#if !defined(_WIN32) && !defined(PLATFORM_WEB)
+    #define SUPPORT_SPECTATOR_SOCKET
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "spectator.h"
+#include "codec.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#if defined(SUPPORT_SPECTATOR_SOCKET)
+    #include <fcntl.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define SPECTATOR_SOCKET_PREFIX     "unix:"
+#define SPECTATOR_RETRY_TICKS       120     // Between connection attempts to a viewer
+#define SPECTATOR_FLUSH_TICKS       60      // File is flushed once a second for live viewers
+#define SPECTATOR_TICK_RATE         60
+#define SPECTATOR_OUTPUT_SIZE       (2*SPECTATOR_RECORD_SIZE + SPECTATOR_BOARDS*256)
+
+#if defined(MSG_NOSIGNAL)
+    #define SEND_FLAGS              (MSG_DONTWAIT | MSG_NOSIGNAL)
+#else
+    #define SEND_FLAGS              MSG_DONTWAIT
+#endif
+
+// Fields of a board in a delta record, in the order they are written, frequent ones first
+#define DELTA_MOVE                  0x01    // One byte: turn, column and row steps
+#define DELTA_SPAWN                 0x02    // Piece type, turn and position
+#define DELTA_INCOMING              0x04
+#define DELTA_ROWS                  0x08    // Locked squares
+#define DELTA_FADING                0x10    // Rows fading out, a line clear starts or ends
+#define DELTA_SCORE                 0x20    // Lines and level
+#define DELTA_STATE                 0x40    // Game over and pause
+#define DELTA_NAME                  0x80
+#define DELTA_LOOSE                 0x100   // Moving squares off the piece
+
+// Keyframes hold every field, squares against an empty well
+#define KEYFRAME_FIELDS             (DELTA_SPAWN | DELTA_INCOMING | DELTA_ROWS | DELTA_FADING | DELTA_SCORE | DELTA_STATE | DELTA_NAME | DELTA_LOOSE)
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static SpectatorStream sent;                    // What the viewer knows, updated by reading back every record
+static const PieceSet *pieceSet = NULL;
+static int boards = 0;
+static FILE *file = NULL;
+static int socketFd = -1;
+static char socketPath[108] = { 0 };
+static int retryTicks = 0;
+static unsigned int keyframeTick[SPECTATOR_BOARDS] = { 0 };
+static unsigned char output[SPECTATOR_OUTPUT_SIZE];    // Records of one tick
+static int outputSize = 0;
+static unsigned long long outputBytes = 0;
+static unsigned int firstTick = 0;
+static unsigned int lastTick = 0;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static void GetWellSquares(BoardSquares *squares);
+static void GetBoardSquares(const PieceSet *set, const BoardState *state, BoardSquares *squares);
+static void RebuildGrid(const SpectatorStream *stream, BoardState *state, const BoardSquares *squares);
+static int GetMoveByte(const BoardState *from, const BoardState *to);
+static void PutBoardFields(CodecWriter *writer, int fields, const BoardState *state, const BoardSquares *squares,
+                           const BoardSquares *base, const BoardState *previous);
+static bool GetBoardFields(CodecReader *reader, const SpectatorStream *stream, int fields, BoardState *state, BoardSquares *squares);
+static void PutRecord(int type, const CodecWriter *payload);
+static bool ConnectViewer(void);
+static void FlushOutput(unsigned int tick);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// File name or unix:PATH
+bool InitSpectator(const char *target, const PieceSet *set, int boardCount)
+{
+    pieceSet = set;
+    boards = (boardCount < SPECTATOR_BOARDS)? boardCount : SPECTATOR_BOARDS;
+    InitSpectatorStream(&sent);
+
+    if (strncmp(target, SPECTATOR_SOCKET_PREFIX, strlen(SPECTATOR_SOCKET_PREFIX)) == 0)
+    {
+#if defined(SUPPORT_SPECTATOR_SOCKET)
+        const char *path = target + strlen(SPECTATOR_SOCKET_PREFIX);
+
+        if ((path[0] == '\0') || (strlen(path) >= sizeof(socketPath))) return false;
+
+        // Viewer may start later, connection is retried while playing
+        strcpy(socketPath, path);
+        ConnectViewer();
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    file = fopen(target, "wb");
+
+    return (file != NULL);
+}
+
+// Every board once per tick
+void RecordSpectator(const BoardState *states)
+{
+    unsigned int tick = states[0].tick;
+
+    if ((file == NULL) && (socketFd < 0))
+    {
+        if ((socketPath[0] == '\0') || (--retryTicks > 0) || !ConnectViewer()) return;
+    }
+
+    if (outputBytes == 0) firstTick = tick;
+    lastTick = tick;
+
+    static unsigned char payload[SPECTATOR_RECORD_SIZE];
+    CodecWriter writer = { payload, 0, SPECTATOR_RECORD_SIZE, false };
+
+    // Piece set first, a new viewer knows nothing
+    if (!sent.header)
+    {
+        static char text[SPECTATOR_RECORD_SIZE];
+        int length = SavePieceSetToMemory(pieceSet, text, sizeof(text));
+
+        for (int b = 0; b < 4; b++) PutByte(&writer, (SPECTATOR_MAGIC >> 8*b) & 0xff);
+        PutVarint(&writer, SPECTATOR_VERSION);
+        PutVarint(&writer, boards);
+        PutVarint(&writer, SPECTATOR_KEYFRAME_TICKS);
+        PutVarint(&writer, (length > 0)? length : 0);
+        if (length > 0) PutBytes(&writer, text, length);
+
+        PutRecord('H', &writer);
+    }
+
+    BoardSquares well;
+    unsigned char changePayload[SPECTATOR_BOARDS*256];
+    CodecWriter changes = { changePayload, 0, sizeof(changePayload), false };
+
+    GetWellSquares(&well);
+
+    for (int b = 0; b < boards; b++)
+    {
+        BoardSquares squares;
+
+        GetBoardSquares(pieceSet, &states[b], &squares);
+
+        // Full board for joining viewers, the first ones are spread so boards take turns
+        if (!sent.synced[b] || (tick - keyframeTick[b] >= SPECTATOR_KEYFRAME_TICKS))
+        {
+            keyframeTick[b] = sent.synced[b]? tick : tick - b*SPECTATOR_KEYFRAME_TICKS/boards;
+
+            writer.size = 0;
+            PutVarint(&writer, tick);
+            PutVarint(&writer, b);
+            PutBoardFields(&writer, KEYFRAME_FIELDS, &states[b], &squares, &well, NULL);
+            PutRecord('K', &writer);
+            continue;
+        }
+
+        const BoardState *old = &sent.board[b];
+        int fields = 0;
+
+        if ((states[b].lines != old->lines) || (states[b].level != old->level)) fields |= DELTA_SCORE;
+        if ((states[b].gameOver != old->gameOver) || (states[b].paused != old->paused)) fields |= DELTA_STATE;
+        if (strncmp(states[b].name, old->name, BOARD_NAME_SIZE) != 0) fields |= DELTA_NAME;
+        if (states[b].incomingType != old->incomingType) fields |= DELTA_INCOMING;
+        if ((states[b].pieceType != old->pieceType) || (states[b].pieceRotation != old->pieceRotation) ||
+            (states[b].pieceX != old->pieceX) || (states[b].pieceY != old->pieceY))
+        {
+            fields |= (GetMoveByte(old, &states[b]) >= 0)? DELTA_MOVE : DELTA_SPAWN;
+        }
+        if (memcmp(squares.rows, sent.squares[b].rows, sizeof(squares.rows)) != 0) fields |= DELTA_ROWS;
+        if (squares.fadingRows != sent.squares[b].fadingRows) fields |= DELTA_FADING;
+        if (memcmp(squares.loose, sent.squares[b].loose, sizeof(squares.loose)) != 0) fields |= DELTA_LOOSE;
+
+        if (fields == 0) continue;
+
+        PutVarint(&changes, b);
+        PutVarint(&changes, fields);
+        PutBoardFields(&changes, fields, &states[b], &squares, &sent.squares[b], old);
+    }
+
+    // Ticks without changes write nothing
+    if (changes.size > 0)
+    {
+        writer.size = 0;
+        PutVarint(&writer, tick - sent.tick);
+        PutBytes(&writer, changes.data, changes.size);
+        PutRecord('D', &writer);
+    }
+
+    FlushOutput(tick);
+}
+
+// Prints the stream rate
+void UnloadSpectator(void)
+{
+    if ((outputBytes > 0) && (boards > 0))
+    {
+        double seconds = (double)(lastTick - firstTick + 1)/SPECTATOR_TICK_RATE;
+
+        printf("Spectator stream %llu bytes, %.0f bytes/s per board over %.1f s\n", outputBytes, outputBytes/seconds/boards, seconds);
+    }
+
+    if (file != NULL) fclose(file);
+    file = NULL;
+
+#if defined(SUPPORT_SPECTATOR_SOCKET)
+    if (socketFd >= 0) close(socketFd);
+#endif
+    socketFd = -1;
+    socketPath[0] = '\0';
+    outputBytes = 0;
+}
+
+void InitSpectatorStream(SpectatorStream *stream)
+{
+    memset(stream, 0, sizeof(SpectatorStream));
+}
+
+// Bytes used, 0 for more data or later tick, -1 when corrupt
+int ReadSpectatorRecord(SpectatorStream *stream, const unsigned char *data, int size, unsigned int untilTick)
+{
+    CodecReader frame = { data, size, 0, false };
+    int type = GetByte(&frame);
+    unsigned long long length = GetVarint(&frame);
+
+    if (frame.error) return 0;
+    if (length > SPECTATOR_RECORD_SIZE) return -1;
+    if (frame.position + (int)length > size) return 0;
+
+    CodecReader reader = { data + frame.position, (int)length, 0, false };
+    int used = frame.position + (int)length;
+
+    if (type == 'H')
+    {
+        static char text[SPECTATOR_RECORD_SIZE + 1];
+        unsigned int magic = 0;
+
+        for (int b = 0; b < 4; b++) magic |= GetByte(&reader) << 8*b;
+        if ((magic != SPECTATOR_MAGIC) || (GetVarint(&reader) != SPECTATOR_VERSION)) return -1;
+
+        unsigned long long boardCount = GetVarint(&reader);
+        unsigned long long keyframeTicks = GetVarint(&reader);
+        unsigned long long textLength = GetVarint(&reader);
+
+        if (reader.error || (boardCount < 1) || (boardCount > SPECTATOR_BOARDS) || (textLength > SPECTATOR_RECORD_SIZE)) return -1;
+
+        GetBytes(&reader, text, (int)textLength);
+        text[textLength] = '\0';
+
+        // Everything known so far belongs to an older game
+        unsigned int joinTick = stream->joinTick;
+        unsigned long long bytes = stream->bytes;
+
+        InitSpectatorStream(stream);
+        stream->joinTick = joinTick;
+        stream->bytes = bytes;
+
+        if (reader.error || !LoadPieceSetFromMemory(&stream->set, text)) return -1;
+
+        stream->header = true;
+        stream->boardCount = (int)boardCount;
+        stream->keyframeTicks = (int)keyframeTicks;
+    }
+    else if (type == 'K')
+    {
+        unsigned long long tick = GetVarint(&reader);
+        unsigned long long b = GetVarint(&reader);
+
+        if (!stream->header || reader.error || (b >= (unsigned long long)stream->boardCount)) return -1;
+        if (tick > untilTick) return 0;
+
+        BoardState state;
+        BoardSquares squares;
+
+        memset(&state, 0, sizeof(BoardState));
+        GetWellSquares(&squares);
+        if (!GetBoardFields(&reader, stream, KEYFRAME_FIELDS, &state, &squares)) return -1;
+
+        stream->tick = (unsigned int)tick;
+
+        if (tick >= stream->joinTick)
+        {
+            stream->board[b] = state;
+            stream->squares[b] = squares;
+            stream->synced[b] = true;
+            RebuildGrid(stream, &stream->board[b], &squares);
+        }
+    }
+    else if (type == 'D')
+    {
+        unsigned int tick = stream->tick + (unsigned int)GetVarint(&reader);
+        bool synced = false;
+
+        for (int b = 0; b < stream->boardCount; b++) synced |= stream->synced[b];
+        if (synced && (tick > untilTick)) return 0;
+
+        stream->tick = tick;
+
+        while (!reader.error && (reader.position < reader.size))
+        {
+            unsigned long long b = GetVarint(&reader);
+            int fields = (int)GetVarint(&reader);
+
+            if (reader.error || (b >= (unsigned long long)stream->boardCount)) return -1;
+
+            BoardState state = stream->board[b];
+            BoardSquares squares = stream->squares[b];
+
+            if (!GetBoardFields(&reader, stream, fields, &state, &squares)) return -1;
+
+            // Changes before the first keyframe of a board have nothing to apply to
+            if (!stream->synced[b]) continue;
+
+            stream->board[b] = state;
+            stream->squares[b] = squares;
+            RebuildGrid(stream, &stream->board[b], &squares);
+        }
+    }
+    // Other record types are left for later versions and skipped
+
+    if (reader.error) return -1;
+
+    stream->bytes += used;
+
+    return used;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+// Walls and floor only
+static void GetWellSquares(BoardSquares *squares)
+{
+    memset(squares, 0, sizeof(BoardSquares));
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE - 1; j++) squares->rows[j] = 1u | (1u << (GRID_HORIZONTAL_SIZE - 1));
+    squares->rows[GRID_VERTICAL_SIZE - 1] = (1u << GRID_HORIZONTAL_SIZE) - 1;
+}
+
+static void GetBoardSquares(const PieceSet *set, const BoardState *state, BoardSquares *squares)
+{
+    memset(squares, 0, sizeof(BoardSquares));
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+    {
+        for (int i = 0; i < GRID_HORIZONTAL_SIZE; i++)
+        {
+            GridSquare square = (GridSquare)state->grid[j][i];
+
+            if ((square == FULL) || (square == BLOCK) || (square == FADING)) squares->rows[j] |= 1u << i;
+            else if (square == MOVING) squares->loose[j] |= 1u << i;
+            if (square == FADING) squares->fadingRows |= 1u << j;
+        }
+    }
+
+    // Squares of the falling piece follow from its position
+    if (state->pieceType >= 0)
+    {
+        const PieceRotation *rotation = &set->type[state->pieceType].rotation[state->pieceRotation];
+
+        for (int s = 0; s < rotation->squares; s++)
+        {
+            int x = state->pieceX + rotation->x[s];
+            int y = state->pieceY + rotation->y[s];
+
+            if ((x >= 0) && (x < GRID_HORIZONTAL_SIZE) && (y >= 0) && (y < GRID_VERTICAL_SIZE)) squares->loose[y] &= ~(1u << x);
+        }
+    }
+}
+
+// Squares of the board from locked rows and the piece
+static void RebuildGrid(const SpectatorStream *stream, BoardState *state, const BoardSquares *squares)
+{
+    state->tick = stream->tick;
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+    {
+        for (int i = 0; i < GRID_HORIZONTAL_SIZE; i++)
+        {
+            bool wall = (i == 0) || (i == GRID_HORIZONTAL_SIZE - 1) || (j == GRID_VERTICAL_SIZE - 1);
+
+            if (squares->loose[j] & (1u << i)) state->grid[j][i] = MOVING;
+            else if (!(squares->rows[j] & (1u << i))) state->grid[j][i] = EMPTY;
+            else if (wall) state->grid[j][i] = BLOCK;
+            else state->grid[j][i] = (squares->fadingRows & (1u << j))? FADING : FULL;
+        }
+    }
+
+    if (state->pieceType >= 0)
+    {
+        const PieceRotation *rotation = &stream->set.type[state->pieceType].rotation[state->pieceRotation];
+
+        for (int s = 0; s < rotation->squares; s++)
+        {
+            int x = state->pieceX + rotation->x[s];
+            int y = state->pieceY + rotation->y[s];
+
+            if ((x >= 0) && (x < GRID_HORIZONTAL_SIZE) && (y >= 0) && (y < GRID_VERTICAL_SIZE)) state->grid[y][x] = MOVING;
+        }
+    }
+
+    memset(state->incomingRows, 0, sizeof(state->incomingRows));
+    state->incomingSize = 0;
+
+    if (state->incomingType >= 0)
+    {
+        const PieceType *incoming = &stream->set.type[state->incomingType];
+
+        state->incomingSize = incoming->size;
+        for (int j = 0; j < incoming->size; j++) state->incomingRows[j] = incoming->rotation[0].rowMask[j];
+    }
+}
+
+// Turn in bits 0-1, column step + 2 in bits 2-4, rows down in bits 5-7, -1 when it does not fit
+static int GetMoveByte(const BoardState *from, const BoardState *to)
+{
+    int dx = to->pieceX - from->pieceX;
+    int dy = to->pieceY - from->pieceY;
+
+    if ((from->pieceType < 0) || (to->pieceType != from->pieceType) || (dx < -2) || (dx > 2) || (dy < 0) || (dy > 7)) return -1;
+
+    return (to->pieceRotation & 3) | ((dx + 2) << 2) | (dy << 5);
+}
+
+static void PutBoardFields(CodecWriter *writer, int fields, const BoardState *state, const BoardSquares *squares,
+                           const BoardSquares *base, const BoardState *previous)
+{
+    if (fields & DELTA_MOVE) PutByte(writer, GetMoveByte(previous, state));
+    if (fields & DELTA_SPAWN)
+    {
+        PutVarint(writer, state->pieceType + 1);
+        PutByte(writer, state->pieceRotation & 3);
+        PutSigned(writer, state->pieceX);
+        PutSigned(writer, state->pieceY);
+    }
+    if (fields & DELTA_INCOMING) PutVarint(writer, state->incomingType + 1);
+    if (fields & DELTA_ROWS) PutXorRows(writer, squares->rows, base->rows, GRID_VERTICAL_SIZE);
+    if (fields & DELTA_FADING) PutVarint(writer, squares->fadingRows);
+    if (fields & DELTA_SCORE)
+    {
+        PutVarint(writer, state->lines);
+        PutVarint(writer, state->level);
+    }
+    if (fields & DELTA_STATE) PutByte(writer, (state->gameOver? 1 : 0) | (state->paused? 2 : 0));
+    if (fields & DELTA_NAME)
+    {
+        int length = 0;
+
+        while ((length < BOARD_NAME_SIZE - 1) && (state->name[length] != '\0')) length++;
+
+        PutVarint(writer, length);
+        PutBytes(writer, state->name, length);
+    }
+    if (fields & DELTA_LOOSE) PutXorRows(writer, squares->loose, base->loose, GRID_VERTICAL_SIZE);
+}
+
+static bool GetBoardFields(CodecReader *reader, const SpectatorStream *stream, int fields, BoardState *state, BoardSquares *squares)
+{
+    if (fields & DELTA_MOVE)
+    {
+        int move = GetByte(reader);
+
+        state->pieceRotation = move & 3;
+        state->pieceX += ((move >> 2) & 7) - 2;
+        state->pieceY += move >> 5;
+    }
+    if (fields & DELTA_SPAWN)
+    {
+        state->pieceType = (signed char)((int)GetVarint(reader) - 1);
+        state->pieceRotation = (signed char)GetByte(reader);
+        state->pieceX = (signed char)GetSigned(reader);
+        state->pieceY = (signed char)GetSigned(reader);
+    }
+    if (fields & DELTA_INCOMING) state->incomingType = (signed char)((int)GetVarint(reader) - 1);
+    if (fields & DELTA_ROWS) GetXorRows(reader, squares->rows, squares->rows, GRID_VERTICAL_SIZE);
+    if (fields & DELTA_FADING) squares->fadingRows = (unsigned int)GetVarint(reader);
+    if (fields & DELTA_SCORE)
+    {
+        state->lines = (int)GetVarint(reader);
+        state->level = (int)GetVarint(reader);
+    }
+    if (fields & DELTA_STATE)
+    {
+        int flags = GetByte(reader);
+
+        state->gameOver = (flags & 1) != 0;
+        state->paused = (flags & 2) != 0;
+    }
+    if (fields & DELTA_NAME)
+    {
+        unsigned long long length = GetVarint(reader);
+
+        if (length >= BOARD_NAME_SIZE) return false;
+
+        memset(state->name, 0, BOARD_NAME_SIZE);
+        GetBytes(reader, state->name, (int)length);
+    }
+    if (fields & DELTA_LOOSE) GetXorRows(reader, squares->loose, squares->loose, GRID_VERTICAL_SIZE);
+
+    if ((state->pieceType >= stream->set.typeCount) || (state->pieceRotation >= PIECE_ROTATIONS) ||
+        (state->incomingType >= stream->set.typeCount)) return false;
+
+    return !reader->error;
+}
+
+// Frame the payload and read it back, so the game side knows what the viewer has
+static void PutRecord(int type, const CodecWriter *payload)
+{
+    CodecWriter frame = { output + outputSize, 0, SPECTATOR_OUTPUT_SIZE - outputSize, false };
+
+    if (payload->overflow) return;
+
+    PutByte(&frame, type);
+    PutVarint(&frame, payload->size);
+    PutBytes(&frame, payload->data, payload->size);
+
+    if (frame.overflow) return;
+
+    ReadSpectatorRecord(&sent, frame.data, frame.size, UINT_MAX);
+    outputSize += frame.size;
+}
+
+static bool ConnectViewer(void)
+{
+#if defined(SUPPORT_SPECTATOR_SOCKET)
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    retryTicks = SPECTATOR_RETRY_TICKS;
+    if (fd < 0) return false;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+#if defined(SO_NOSIGPIPE)
+    int on = 1;
+
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+    // New viewer starts from a header and keyframes
+    socketFd = fd;
+    InitSpectatorStream(&sent);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Viewer that can not keep up is dropped and reconnected later, the game never waits
+static void FlushOutput(unsigned int tick)
+{
+    if (file != NULL)
+    {
+        fwrite(output, 1, outputSize, file);
+        if (tick%SPECTATOR_FLUSH_TICKS == 0) fflush(file);
+    }
+#if defined(SUPPORT_SPECTATOR_SOCKET)
+    else if ((socketFd >= 0) && (outputSize > 0) && (send(socketFd, output, outputSize, SEND_FLAGS) != outputSize))
+    {
+        close(socketFd);
+        socketFd = -1;
+        retryTicks = SPECTATOR_RETRY_TICKS;
+    }
+#endif
+    (void)tick;
+
+    outputBytes += outputSize;
+    outputSize = 0;
+}
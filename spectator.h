@@ -0,0 +1,76 @@
+/*******************************************************************************************
+*
+*   tetris42 - spectator stream
+*
+*   Board changes are written as records instead of frames: a header with the piece set,
+*   full keyframes of every board now and then, and in between one delta record per tick
+*   holding only what changed. Locked squares go as XOR rows against the last sent rows,
+*   piece moves as one byte, spawns, incoming pieces, lines and fading rows (line clears)
+*   as short varint fields. A viewer joining midway waits for the next keyframe.
+*
+*   Record: type byte, varint payload size, payload.
+*       H   magic, version, board count, keyframe interval, piece set definition text
+*       K   tick, board, every field of the board
+*       D   ticks since the last record, then per changed board: board, change flags, fields
+*
+*   The stream goes to a file or to a viewer listening on a local socket (unix:PATH),
+*   which the game reconnects to and restarts with a header and keyframes.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include "boardstate.h"
+#include "pieces.h"
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define SPECTATOR_BOARDS            4
+#define SPECTATOR_MAGIC             0x53323454u     // "T42S"
+#define SPECTATOR_VERSION           1
+#define SPECTATOR_KEYFRAME_TICKS    600             // Full boards every 10 seconds at 60 frames
+#define SPECTATOR_RECORD_SIZE       8192            // Largest payload, the header of a full piece set
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+// Squares of a board besides the falling piece, bit i is column i
+typedef struct BoardSquares {
+    unsigned short rows[GRID_VERTICAL_SIZE];                    // Locked squares, walls and floor included
+    unsigned short loose[GRID_VERTICAL_SIZE];                   // Moving squares off the piece, a turn in the lock frame leaves them
+    unsigned int fadingRows;                                    // Bit j set while row j fades out
+} BoardSquares;
+
+// Boards as a viewer knows them, the game keeps one too for what it sent
+typedef struct SpectatorStream {
+    PieceSet set;
+    bool header;                                                // Piece set known
+    int boardCount;
+    int keyframeTicks;
+    unsigned int tick;                                          // Tick of the last record
+    unsigned int joinTick;                                      // Keyframes before it are skipped
+    bool synced[SPECTATOR_BOARDS];                              // Keyframe seen, deltas apply
+    BoardState board[SPECTATOR_BOARDS];
+    BoardSquares squares[SPECTATOR_BOARDS];
+    unsigned long long bytes;                                   // Stream size so far
+} SpectatorStream;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+// Game side
+bool InitSpectator(const char *target, const PieceSet *set, int boardCount);    // File name or unix:PATH
+void RecordSpectator(const BoardState *states);     // Every board once per tick
+void UnloadSpectator(void);                         // Prints the stream rate
+
+// Viewer side
+void InitSpectatorStream(SpectatorStream *stream);
+int ReadSpectatorRecord(SpectatorStream *stream, const unsigned char *data, int size, unsigned int untilTick);  // Bytes used, 0 for more data or later tick, -1 when corrupt
+
+#endif // SPECTATOR_H
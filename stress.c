@@ -0,0 +1,364 @@
+/*******************************************************************************************
+*
+*   tetris42 - endurance stress runs
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#if !defined(_WIN32)
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "stress.h"
+#include "bot.h"
+#include "memtrack.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__linux__)
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#if defined(__GLIBC__)
+    #include <malloc.h>
+    #if __GLIBC_PREREQ(2, 33)
+        #define SUPPORT_HEAP_INFO
+    #endif
+#endif
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define STRESS_BOARDS           4
+#define STRESS_WARMUP           60.0    // Seconds, at most a fifth of the run
+#define STRESS_INTERVAL         60.0    // Seconds between samples, at most a tenth of the run
+#define STRESS_STUCK_FRAMES     3       // Frames a piece may refuse to move before it is dropped
+#define STRESS_RSS_SLACK        (1024*1024)     // Bytes, pages of the stack and caches touched late
+#define STRESS_HEAP_SLACK       (64*1024)
+#define STRESS_DRIFT            1.5     // Frame time of the last interval to the first one
+#define STRESS_DRIFT_SLACK      0.05    // Milliseconds of drift always allowed
+#define STRESS_OCTAVE_BUCKETS   16      // Frame time histogram buckets per doubling of nanoseconds, 4.4% apart
+#define STRESS_BUCKETS          512     // The last one holds frames of 4 s and longer
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct StressSample {
+    double time;                        // Seconds since the start
+    unsigned long long frames;
+    unsigned long long games;
+    size_t residentSize;                // Bytes, 0 when not known
+    size_t heapSize;                    // Bytes in use, 0 when not known
+    MemoryCounters memory;
+    double frameTime;                   // Median of the interval, milliseconds
+} StressSample;
+
+typedef struct StressBot {
+    bool planned;                       // Moving to target, dropped where it is otherwise
+    PiecePosition target;
+    PiecePosition last;                 // Position in the previous frame
+    bool moved;                         // Asked to move or turn in the previous frame
+    int stuckFrames;
+} StressBot;
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+static const PieceSet *stressSet = NULL;
+static StressBot bots[STRESS_BOARDS] = { 0 };
+
+static double duration = 0;             // Seconds
+static double warmup = 0;
+static double interval = 0;
+static double startTime = 0;
+static double frameStart = 0;
+static double nextSample = 0;
+static unsigned long long frames = 0;
+static unsigned long long games = 0;
+
+// Frame times of the current interval
+static unsigned int frameBuckets[STRESS_BUCKETS] = { 0 };
+static unsigned int bucketFrames = 0;
+
+static StressSample baseline = { 0 };   // After the warm-up
+static StressSample middle = { 0 };     // Halfway from the baseline to the end
+static StressSample last = { 0 };
+static bool baselineTaken = false;
+static bool middleTaken = false;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static double GetStressTime(void);
+static size_t GetResidentSize(void);
+static size_t GetHeapSize(void);
+static double GetMedianFrameTime(void);
+static void TakeSample(StressSample *sample, double now);
+static bool ReportCheck(bool passed, const char *format, ...);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+void InitStress(const PieceSet *set, double minutes)
+{
+    stressSet = set;
+    duration = 60*minutes;
+    warmup = (STRESS_WARMUP < duration/5)? STRESS_WARMUP : duration/5;
+    interval = (STRESS_INTERVAL < duration/10)? STRESS_INTERVAL : duration/10;
+    if (interval < 1) interval = 1;
+
+    startTime = GetStressTime();
+    nextSample = interval;
+}
+
+// Target of the best placement, the bot turns first, then moves and falls fast
+void PlanStressPiece(int board, const Board *grid, PiecePosition start, int incoming)
+{
+    StressBot *bot = &bots[board];
+    int queue[STRESS_DEPTH] = { start.type, incoming };
+    Placement best;
+
+    bot->planned = SearchPlacement(stressSet, NULL, grid, start, queue, STRESS_DEPTH, NULL, NULL, &best);
+    bot->target = best.position;
+    bot->last = start;
+    bot->moved = false;
+    bot->stuckFrames = 0;
+}
+
+// Presses every frame, so pieces move and turn every frame
+void GetStressInput(int board, PiecePosition piece, bool active, bool over, BoardInput *input)
+{
+    StressBot *bot = &bots[board];
+
+    *input = (BoardInput){ 0 };
+
+    if (over)
+    {
+        input->restartPressed = true;
+        bot->planned = false;
+        games++;
+        return;
+    }
+
+    if (!active) return;
+
+    // Turns refused by the board or walls in the way
+    if (bot->moved && (piece.x == bot->last.x) && (piece.rotation == bot->last.rotation))
+    {
+        if (++bot->stuckFrames >= STRESS_STUCK_FRAMES) bot->planned = false;
+    }
+    else bot->stuckFrames = 0;
+
+    bot->last = piece;
+    bot->moved = bot->planned;
+
+    if (bot->planned && (piece.rotation != bot->target.rotation))
+    {
+        input->turnPressed = true;
+        input->turn = true;
+    }
+    else if (bot->planned && (piece.x != bot->target.x))
+    {
+        input->movePressed = true;
+        input->left = (piece.x > bot->target.x);
+        input->right = !input->left;
+    }
+    else
+    {
+        input->fastFall = true;
+        bot->moved = false;
+    }
+}
+
+void BeginStressFrame(void)
+{
+    frameStart = GetStressTime();
+}
+
+void EndStressFrame(void)
+{
+    double now = GetStressTime();
+    double frameTime = (now - frameStart)*1e9;
+    int bucket = (frameTime > 1)? (int)(log2(frameTime)*STRESS_OCTAVE_BUCKETS) : 0;
+
+    frameBuckets[(bucket < STRESS_BUCKETS)? bucket : STRESS_BUCKETS - 1]++;
+    bucketFrames++;
+    frames++;
+
+    if (now - startTime < nextSample) return;
+
+    TakeSample(&last, now);
+    nextSample += interval;
+
+    if (!baselineTaken && (last.time >= warmup))
+    {
+        baseline = last;
+        baselineTaken = true;
+    }
+    else if (baselineTaken && !middleTaken && (last.time >= (warmup + duration)/2))
+    {
+        middle = last;
+        middleTaken = true;
+    }
+
+    printf("Stress %6.0f s %12llu frames %8llu games, RSS %.1f MB, heap %.1f MB, " TRACKED_ALLOCATIONS " %llu, GPU resources %lld, frame %.4f ms\n",
+           last.time, last.frames, last.games, last.residentSize/1048576.0, last.heapSize/1048576.0,
+           last.memory.allocations + last.memory.reallocations, last.memory.gpuResources, last.frameTime);
+}
+
+bool IsStressOver(void)
+{
+    return (GetStressTime() - startTime >= duration);
+}
+
+// Compares the end of the run with the samples after the warm-up and halfway
+bool ReportStress(void)
+{
+    StressSample end;
+    bool passed = true;
+
+    // Frame time of a short last interval comes from the one before
+    TakeSample(&end, GetStressTime());
+    if (end.frameTime < 0) end.frameTime = last.frameTime;
+
+    printf("Stress run %.0f s, %llu frames (%.1f h of play at 60 fps), %llu games\n", end.time, end.frames, end.frames/216000.0, end.games);
+
+    if (!baselineTaken)
+    {
+        printf("Stress run ended in the warm-up, nothing checked.\n");
+        return true;
+    }
+
+    if (!middleTaken) middle = baseline;
+
+    unsigned long long allocations = (end.memory.allocations + end.memory.reallocations) - (baseline.memory.allocations + baseline.memory.reallocations);
+    long long liveBlocks = (long long)(end.memory.allocations - end.memory.frees) - (long long)(baseline.memory.allocations - baseline.memory.frees);
+
+    passed &= ReportCheck((allocations == 0) && (liveBlocks == 0), TRACKED_ALLOCATIONS " in the frame loop %llu, live blocks %+lld", allocations, liveBlocks);
+
+    passed &= ReportCheck(end.memory.gpuResources == baseline.memory.gpuResources, "GPU resources %lld -> %lld",
+                          baseline.memory.gpuResources, end.memory.gpuResources);
+
+    if (end.residentSize > 0)
+    {
+        long long growth = (long long)end.residentSize - (long long)middle.residentSize;
+
+        passed &= ReportCheck(growth <= STRESS_RSS_SLACK, "RSS %.2f MB -> %.2f MB -> %.2f MB, %+.0f kB in the second half",
+                              baseline.residentSize/1048576.0, middle.residentSize/1048576.0, end.residentSize/1048576.0, growth/1024.0);
+    }
+
+    if (end.heapSize > 0)
+    {
+        long long growth = (long long)end.heapSize - (long long)middle.heapSize;
+
+        passed &= ReportCheck(growth <= STRESS_HEAP_SLACK, "Heap in use %.2f MB -> %.2f MB -> %.2f MB, %+.0f kB in the second half",
+                              baseline.heapSize/1048576.0, middle.heapSize/1048576.0, end.heapSize/1048576.0, growth/1024.0);
+    }
+
+    passed &= ReportCheck((end.frameTime <= STRESS_DRIFT*baseline.frameTime) || (end.frameTime - baseline.frameTime <= STRESS_DRIFT_SLACK),
+                          "Median frame time %.4f ms -> %.4f ms", baseline.frameTime, end.frameTime);
+
+#if defined(SUPPORT_MALLOC_WRAP)
+    printf("Stress run %s\n", passed? "PASSED" : "FAILED");
+#else
+    printf("Stress run %s, allocations of the game itself only checked as heap growth\n", passed? "PASSED" : "FAILED");
+#endif
+
+    return passed;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static double GetStressTime(void)
+{
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return time.tv_sec + time.tv_nsec/1e9;
+}
+
+// Read without stdio, which would allocate
+static size_t GetResidentSize(void)
+{
+#if defined(__linux__)
+    char text[128];
+    unsigned long pages = 0;
+    unsigned long resident = 0;
+    int file = open("/proc/self/statm", O_RDONLY);
+
+    if (file < 0) return 0;
+
+    ssize_t size = read(file, text, sizeof(text) - 1);
+
+    close(file);
+    if (size <= 0) return 0;
+    text[size] = '\0';
+    if (sscanf(text, "%lu %lu", &pages, &resident) != 2) return 0;
+
+    return (size_t)resident*(size_t)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+static size_t GetHeapSize(void)
+{
+#if defined(SUPPORT_HEAP_INFO)
+    struct mallinfo2 info = mallinfo2();
+
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+// Milliseconds, -1 without frames
+static double GetMedianFrameTime(void)
+{
+    unsigned int total = 0;
+
+    if (bucketFrames == 0) return -1;
+
+    for (int b = 0; b < STRESS_BUCKETS; b++)
+    {
+        total += frameBuckets[b];
+        if (2*total >= bucketFrames) return exp2((b + 0.5)/STRESS_OCTAVE_BUCKETS)/1e6;
+    }
+
+    return exp2((double)STRESS_BUCKETS/STRESS_OCTAVE_BUCKETS)/1e6;
+}
+
+// Starts the next frame time interval
+static void TakeSample(StressSample *sample, double now)
+{
+    sample->time = now - startTime;
+    sample->frames = frames;
+    sample->games = games;
+    sample->residentSize = GetResidentSize();
+    sample->heapSize = GetHeapSize();
+    sample->memory = GetMemoryCounters();
+    sample->frameTime = GetMedianFrameTime();
+
+    for (int b = 0; b < STRESS_BUCKETS; b++) frameBuckets[b] = 0;
+    bucketFrames = 0;
+}
+
+static bool ReportCheck(bool passed, const char *format, ...)
+{
+    va_list args;
+
+    printf("%s", passed? "  ok    " : "  FAIL  ");
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+
+    return passed;
+}
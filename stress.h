@@ -0,0 +1,40 @@
+/*******************************************************************************************
+*
+*   tetris42 - endurance stress runs
+*
+*   Bots play every board for a given time, restarting games as soon as they are over, in
+*   the window or headless as fast as boards update. Every minute the run is sampled:
+*   resident memory, C heap in use (glibc), allocation calls (memtrack.h, every malloc() of
+*   the game and raylib on Linux, raylib's own elsewhere), GPU resources and the median
+*   frame time. After a warm-up the frame loop has to run without a single counted
+*   allocation and with the same GPU resources, resident memory and heap may not grow in
+*   the second half of the run and frame time may not drift up.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef STRESS_H
+#define STRESS_H
+
+#include "engine.h"
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define STRESS_DEPTH            2       // Pieces the bots look ahead, the falling and the incoming one
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+void InitStress(const PieceSet *set, double minutes);
+void PlanStressPiece(int board, const Board *grid, PiecePosition start, int incoming);  // When a piece spawns
+void GetStressInput(int board, PiecePosition piece, bool active, bool over, BoardInput *input);
+void BeginStressFrame(void);
+void EndStressFrame(void);              // Samples the run now and then
+bool IsStressOver(void);
+bool ReportStress(void);                // False when anything grew
+
+#endif // STRESS_H
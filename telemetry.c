@@ -0,0 +1,444 @@
+/*******************************************************************************************
+*
+*   tetris42 - match telemetry
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#if !defined(_WIN32) && !defined(PLATFORM_WEB)
+    #define SUPPORT_METRICS_ENDPOINT
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "telemetry.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(SUPPORT_METRICS_ENDPOINT)
+    #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <netinet/in.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define TELEMETRY_WAIT_TIME         100         // Milliseconds, bounds stopping and answering a scrape
+#define TELEMETRY_NAME_SIZE         20
+#define METRICS_SIZE                16384
+#define METRIC_FAMILIES             10          // Per board, the frame time summary comes after them
+
+#if defined(MSG_NOSIGNAL)
+    #define SEND_FLAGS              MSG_NOSIGNAL
+#else
+    #define SEND_FLAGS              0
+#endif
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+// Counters copied at one time
+typedef struct TelemetrySample {
+    double time;                        // Seconds, monotonic
+    unsigned int pieces[TELEMETRY_BOARDS];
+    unsigned int lines[TELEMETRY_BOARDS];
+    unsigned int rotations[TELEMETRY_BOARDS];
+    unsigned int games[TELEMETRY_BOARDS];
+    unsigned int stackHeight[TELEMETRY_BOARDS];
+    unsigned int maxStackHeight[TELEMETRY_BOARDS];
+    unsigned long long pauseTime[TELEMETRY_BOARDS];
+    unsigned int frames;
+    unsigned int frameBuckets[TELEMETRY_BUCKETS];
+    unsigned long long frameTime;
+} TelemetrySample;
+
+// Prometheus metric of every board
+typedef struct MetricFamily {
+    const char *name;
+    const char *type;
+    int decimals;
+    const char *help;
+} MetricFamily;
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+TelemetryCounters telemetryCounters = { 0 };
+
+static pthread_t thread;
+static atomic_bool running = false;
+static FILE *file = NULL;
+static int listenFd = -1;
+static int firstBoard = 0;
+static int boardCount = 0;
+static char names[TELEMETRY_BOARDS][TELEMETRY_NAME_SIZE] = { 0 };     // Set before the thread starts
+
+static const MetricFamily families[METRIC_FAMILIES] = {
+    { "tetris42_pieces_total", "counter", 0, "Pieces locked." },
+    { "tetris42_lines_total", "counter", 0, "Lines deleted." },
+    { "tetris42_rotations_total", "counter", 0, "Piece turns." },
+    { "tetris42_games_total", "counter", 0, "Games ended." },
+    { "tetris42_pause_seconds_total", "counter", 3, "Time paused while playing." },
+    { "tetris42_pieces_per_second", "gauge", 3, "Pieces locked per second over the last sample." },
+    { "tetris42_lines_per_minute", "gauge", 2, "Lines per minute over the last sample." },
+    { "tetris42_rotations_per_piece", "gauge", 2, "Turns per locked piece over the last sample." },
+    { "tetris42_stack_height", "gauge", 0, "Rows up to the highest full square." },
+    { "tetris42_max_stack_height", "gauge", 0, "Highest stack of the game played." },
+};
+
+// Only the telemetry thread uses them once it runs
+static TelemetrySample previous = { 0 };
+static char metrics[METRICS_SIZE] = { 0 };
+static int metricsSize = 0;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static void *TelemetryThread(void *data);
+static void SetName(int board, const char *name);
+static void TakeSample(TelemetrySample *sample);
+static void WriteSample(const TelemetrySample *sample);
+static double GetFramePercentile(const unsigned int *buckets, unsigned int frames, double fraction);
+static double GetSeconds(clockid_t clockId);
+static void AppendText(char *text, int *size, int capacity, const char *format, ...);
+static void ServeMetrics(void);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// File or port may be NULL and 0, names of all boards
+bool InitTelemetry(const char *fileName, int port, int first, int count, const char *const *boardNames)
+{
+    if ((count < 1) || (first < 0) || (first + count > TELEMETRY_BOARDS)) return false;
+
+    if (fileName != NULL)
+    {
+        file = fopen(fileName, "a");
+        if (file == NULL) return false;
+    }
+
+    if (port > 0)
+    {
+#if defined(SUPPORT_METRICS_ENDPOINT)
+        struct sockaddr_in address = { 0 };
+        int on = 1;
+
+        address.sin_family = AF_INET;
+        address.sin_port = htons((unsigned short)port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+
+        if ((listenFd < 0) || (setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0) ||
+            (bind(listenFd, (struct sockaddr *)&address, sizeof(address)) != 0) || (listen(listenFd, 4) != 0))
+        {
+            if (listenFd >= 0) close(listenFd);
+            listenFd = -1;
+        }
+        else fcntl(listenFd, F_SETFL, O_NONBLOCK);
+#endif
+        if (listenFd < 0)
+        {
+            if (file != NULL) fclose(file);
+            file = NULL;
+            return false;
+        }
+    }
+
+    firstBoard = first;
+    boardCount = count;
+    for (int b = 0; b < TELEMETRY_BOARDS; b++) SetName(b, boardNames[b]);
+
+    // Scrapes before the first interval get the totals
+    TakeSample(&previous);
+    WriteSample(&previous);
+
+    atomic_store(&running, true);
+    if (pthread_create(&thread, NULL, TelemetryThread, NULL) != 0)
+    {
+        atomic_store(&running, false);
+        UnloadTelemetry();
+        return false;
+    }
+
+    return true;
+}
+
+// Writes the last sample
+void UnloadTelemetry(void)
+{
+    if (atomic_exchange(&running, false)) pthread_join(thread, NULL);
+
+#if defined(SUPPORT_METRICS_ENDPOINT)
+    if (listenFd >= 0) close(listenFd);
+#endif
+    listenFd = -1;
+
+    if (file != NULL) fclose(file);
+    file = NULL;
+}
+
+// Frame to frame time, paused boards (bit per board) add it to their pause time
+void CountTelemetryFrame(double frameTime, unsigned int pausedBoards)
+{
+    unsigned long long microseconds = (frameTime > 0)? (unsigned long long)(frameTime*1e6) : 0;
+    unsigned long long bucket = microseconds/TELEMETRY_BUCKET_TIME;
+
+    if (bucket >= TELEMETRY_BUCKETS) bucket = TELEMETRY_BUCKETS - 1;
+
+    AddTelemetry(&telemetryCounters.frames, 1);
+    AddTelemetry(&telemetryCounters.frameBuckets[bucket], 1);
+    atomic_store_explicit(&telemetryCounters.frameTime, atomic_load_explicit(&telemetryCounters.frameTime, memory_order_relaxed) + microseconds, memory_order_relaxed);
+
+    for (int b = 0; pausedBoards != 0; b++, pausedBoards >>= 1)
+    {
+        if (!(pausedBoards & 1)) continue;
+
+        atomic_ullong *pauseTime = &telemetryCounters.board[b].pauseTime;
+
+        atomic_store_explicit(pauseTime, atomic_load_explicit(pauseTime, memory_order_relaxed) + microseconds, memory_order_relaxed);
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static void *TelemetryThread(void *data)
+{
+    (void)data;
+
+    double next = GetSeconds(CLOCK_MONOTONIC) + TELEMETRY_INTERVAL/1000.0;
+
+    while (atomic_load(&running))
+    {
+        double now = GetSeconds(CLOCK_MONOTONIC);
+
+        if (now >= next)
+        {
+            TelemetrySample sample;
+
+            TakeSample(&sample);
+            WriteSample(&sample);
+            next += TELEMETRY_INTERVAL/1000.0;
+            if (next < now) next = now + TELEMETRY_INTERVAL/1000.0;     // Suspended meanwhile
+            continue;
+        }
+
+        int wait = (int)((next - now)*1000) + 1;
+
+        if (wait > TELEMETRY_WAIT_TIME) wait = TELEMETRY_WAIT_TIME;
+
+#if defined(SUPPORT_METRICS_ENDPOINT)
+        if (listenFd >= 0)
+        {
+            struct pollfd request = { listenFd, POLLIN, 0 };
+
+            if (poll(&request, 1, wait) > 0) ServeMetrics();
+            continue;
+        }
+#endif
+        struct timespec pause = { 0, wait*1000000L };
+
+        nanosleep(&pause, NULL);
+    }
+
+    // Time since the last sample is not lost
+    TelemetrySample sample;
+
+    TakeSample(&sample);
+    if (sample.time > previous.time) WriteSample(&sample);
+
+    return NULL;
+}
+
+// Quotes and control characters would break JSON and label values
+static void SetName(int board, const char *name)
+{
+    int length = 0;
+
+    for (; (name[length] != '\0') && (length < TELEMETRY_NAME_SIZE - 1); length++)
+    {
+        char c = name[length];
+
+        names[board][length] = ((c == '"') || (c == '\\') || ((unsigned char)c < ' '))? '_' : c;
+    }
+
+    names[board][length] = '\0';
+}
+
+static void TakeSample(TelemetrySample *sample)
+{
+    sample->time = GetSeconds(CLOCK_MONOTONIC);
+
+    for (int b = 0; b < TELEMETRY_BOARDS; b++)
+    {
+        const TelemetryBoard *counters = &telemetryCounters.board[b];
+
+        sample->pieces[b] = atomic_load_explicit(&counters->pieces, memory_order_relaxed);
+        sample->lines[b] = atomic_load_explicit(&counters->lines, memory_order_relaxed);
+        sample->rotations[b] = atomic_load_explicit(&counters->rotations, memory_order_relaxed);
+        sample->games[b] = atomic_load_explicit(&counters->games, memory_order_relaxed);
+        sample->stackHeight[b] = atomic_load_explicit(&counters->stackHeight, memory_order_relaxed);
+        sample->maxStackHeight[b] = atomic_load_explicit(&counters->maxStackHeight, memory_order_relaxed);
+        sample->pauseTime[b] = atomic_load_explicit(&counters->pauseTime, memory_order_relaxed);
+    }
+
+    sample->frames = atomic_load_explicit(&telemetryCounters.frames, memory_order_relaxed);
+    sample->frameTime = atomic_load_explicit(&telemetryCounters.frameTime, memory_order_relaxed);
+    for (int i = 0; i < TELEMETRY_BUCKETS; i++) sample->frameBuckets[i] = atomic_load_explicit(&telemetryCounters.frameBuckets[i], memory_order_relaxed);
+}
+
+// Rates over the time since the previous sample, one JSON line and the Prometheus text, only
+// the text with rates of 0 for the previous sample itself
+static void WriteSample(const TelemetrySample *sample)
+{
+    static const double quantiles[3] = { 0.5, 0.9, 0.99 };
+    static char line[METRICS_SIZE];
+    unsigned int buckets[TELEMETRY_BUCKETS];
+    unsigned int frames = sample->frames - previous.frames;
+    double seconds = sample->time - previous.time;
+    double percentiles[3];
+    double maxFrameTime = 0;
+    int lineSize = 0;
+
+    if (seconds < 0) return;
+
+    for (int i = 0; i < TELEMETRY_BUCKETS; i++)
+    {
+        buckets[i] = sample->frameBuckets[i] - previous.frameBuckets[i];
+        if (buckets[i] > 0) maxFrameTime = (i + 1)*TELEMETRY_BUCKET_TIME/1000.0;
+    }
+
+    for (int q = 0; q < 3; q++) percentiles[q] = GetFramePercentile(buckets, frames, quantiles[q]);
+
+    AppendText(line, &lineSize, METRICS_SIZE, "{\"time\":%.3f,\"seconds\":%.3f,\"frames\":%u,\"frame_ms\":{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f},\"boards\":[",
+               GetSeconds(CLOCK_REALTIME), seconds, frames, percentiles[0], percentiles[1], percentiles[2], maxFrameTime);
+
+    double values[METRIC_FAMILIES][TELEMETRY_BOARDS];
+    char labels[TELEMETRY_BOARDS][64];
+
+    for (int b = 0; b < boardCount; b++)
+    {
+        int g = firstBoard + b;
+        unsigned int pieces = sample->pieces[g] - previous.pieces[g];
+        unsigned int lines = sample->lines[g] - previous.lines[g];
+        unsigned int rotations = sample->rotations[g] - previous.rotations[g];
+        double piecesPerSecond = (seconds > 0)? pieces/seconds : 0;
+        double linesPerMinute = (seconds > 0)? 60*lines/seconds : 0;
+        double rotationsPerPiece = (pieces > 0)? (double)rotations/pieces : 0;
+        double pauseSeconds = sample->pauseTime[g]/1e6;
+
+        AppendText(line, &lineSize, METRICS_SIZE, "%s{\"board\":%d,\"name\":\"%s\",\"pieces\":%u,\"lines\":%u,\"games\":%u,\"pieces_per_second\":%.3f,"
+                   "\"lines_per_minute\":%.2f,\"rotations_per_piece\":%.2f,\"stack_height\":%u,\"max_stack_height\":%u,\"pause_seconds\":%.3f}",
+                   (b > 0)? "," : "", b, names[g], sample->pieces[g], sample->lines[g], sample->games[g], piecesPerSecond,
+                   linesPerMinute, rotationsPerPiece, sample->stackHeight[g], sample->maxStackHeight[g], pauseSeconds);
+
+        // In the order of the families
+        values[0][b] = sample->pieces[g];
+        values[1][b] = sample->lines[g];
+        values[2][b] = sample->rotations[g];
+        values[3][b] = sample->games[g];
+        values[4][b] = pauseSeconds;
+        values[5][b] = piecesPerSecond;
+        values[6][b] = linesPerMinute;
+        values[7][b] = rotationsPerPiece;
+        values[8][b] = sample->stackHeight[g];
+        values[9][b] = sample->maxStackHeight[g];
+        snprintf(labels[b], sizeof(labels[b]), "{board=\"%d\",player=\"%s\"}", b, names[g]);
+    }
+
+    AppendText(line, &lineSize, METRICS_SIZE, "]}\n");
+
+    // Every family is one group, its help and type first
+    metricsSize = 0;
+    for (int f = 0; f < METRIC_FAMILIES; f++)
+    {
+        AppendText(metrics, &metricsSize, METRICS_SIZE, "# HELP %s %s\n# TYPE %s %s\n", families[f].name, families[f].help, families[f].name, families[f].type);
+        for (int b = 0; b < boardCount; b++) AppendText(metrics, &metricsSize, METRICS_SIZE, "%s%s %.*f\n", families[f].name, labels[b], families[f].decimals, values[f][b]);
+    }
+
+    AppendText(metrics, &metricsSize, METRICS_SIZE,
+               "# HELP tetris42_frame_time_seconds Frame to frame time, quantiles over the last sample.\n# TYPE tetris42_frame_time_seconds summary\n");
+    for (int q = 0; q < 3; q++) AppendText(metrics, &metricsSize, METRICS_SIZE, "tetris42_frame_time_seconds{quantile=\"%g\"} %.6f\n", quantiles[q], percentiles[q]/1000);
+    AppendText(metrics, &metricsSize, METRICS_SIZE, "tetris42_frame_time_seconds_sum %.6f\ntetris42_frame_time_seconds_count %u\n",
+               sample->frameTime/1e6, sample->frames);
+
+    if ((file != NULL) && (seconds > 0))
+    {
+        fputs(line, file);
+        fflush(file);
+    }
+
+    if (sample != &previous) previous = *sample;
+}
+
+// Upper bound of the bucket the fraction of frames reaches, in milliseconds
+static double GetFramePercentile(const unsigned int *buckets, unsigned int frames, double fraction)
+{
+    unsigned long long target = (unsigned long long)(fraction*frames + 0.5);
+    unsigned long long count = 0;
+
+    if (frames == 0) return 0;
+    if (target < 1) target = 1;
+
+    for (int i = 0; i < TELEMETRY_BUCKETS; i++)
+    {
+        count += buckets[i];
+        if (count >= target) return (i + 1)*TELEMETRY_BUCKET_TIME/1000.0;
+    }
+
+    return TELEMETRY_BUCKETS*TELEMETRY_BUCKET_TIME/1000.0;
+}
+
+static double GetSeconds(clockid_t clockId)
+{
+    struct timespec now;
+
+    clock_gettime(clockId, &now);
+
+    return now.tv_sec + now.tv_nsec/1e9;
+}
+
+// Text that does not fit is cut, the size stays within capacity
+static void AppendText(char *text, int *size, int capacity, const char *format, ...)
+{
+    va_list arguments;
+
+    va_start(arguments, format);
+    int written = vsnprintf(text + *size, capacity - *size, format, arguments);
+    va_end(arguments);
+
+    if (written > 0) *size = (*size + written < capacity)? *size + written : capacity - 1;
+}
+
+// Answer one scrape with the last sample, any request path gets the metrics
+static void ServeMetrics(void)
+{
+#if defined(SUPPORT_METRICS_ENDPOINT)
+    int fd = accept(listenFd, NULL, NULL);
+
+    if (fd < 0) return;
+
+    struct pollfd request = { fd, POLLIN, 0 };
+    char header[256];
+    char buffer[1024];
+
+    // Whatever arrived of the request is read, clients do not wait for a reply to finish sending
+    if (poll(&request, 1, TELEMETRY_WAIT_TIME) > 0) (void)recv(fd, buffer, sizeof(buffer), 0);
+
+    int headerSize = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %d\r\nConnection: close\r\n\r\n", metricsSize);
+
+    if (send(fd, header, headerSize, SEND_FLAGS) == headerSize) (void)send(fd, metrics, metricsSize, SEND_FLAGS);
+
+    close(fd);
+#endif
+}
@@ -0,0 +1,105 @@
+/*******************************************************************************************
+*
+*   tetris42 - match telemetry
+*
+*   The game only bumps per board counters and a frame time histogram, with plain loads
+*   and stores as it is their single writer: a few instructions per event and none on
+*   frames without one. A background thread samples them every second and turns the
+*   differences into rates (pieces per second, lines per minute, turns per piece), stack
+*   heights, pause time and frame time percentiles.
+*
+*   Every sample is appended as one JSON line to a file, and served in the Prometheus text
+*   format on 127.0.0.1 (not on Windows). Not available in the browser.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define TELEMETRY_BOARDS            4
+#define TELEMETRY_INTERVAL          1000        // Milliseconds between samples
+#define TELEMETRY_BUCKET_TIME       125         // Microseconds of frame time per histogram bucket
+#define TELEMETRY_BUCKETS           400         // The last one holds frames of 50 ms and longer
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+// Written by the game only, totals since the start
+typedef struct TelemetryBoard {
+    atomic_uint pieces;                 // Locked
+    atomic_uint lines;
+    atomic_uint rotations;
+    atomic_uint games;                  // Ended
+    atomic_uint stackHeight;            // Rows up to the highest full square
+    atomic_uint maxStackHeight;         // Of the game played
+    atomic_ullong pauseTime;            // Microseconds
+} TelemetryBoard;
+
+typedef struct TelemetryCounters {
+    TelemetryBoard board[TELEMETRY_BOARDS];
+    atomic_uint frames;
+    atomic_uint frameBuckets[TELEMETRY_BUCKETS];
+    atomic_ullong frameTime;            // Microseconds
+} TelemetryCounters;
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+extern TelemetryCounters telemetryCounters;
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+bool InitTelemetry(const char *fileName, int port, int firstBoard, int boardCount, const char *const *names);  // File or port may be NULL and 0, names of all boards
+void UnloadTelemetry(void);                 // Writes the last sample
+
+// Game side, board is the game's board index
+static inline void AddTelemetry(atomic_uint *counter, unsigned int value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static inline void CountTelemetryPiece(int board, unsigned int stackHeight)
+{
+    TelemetryBoard *counters = &telemetryCounters.board[board];
+
+    AddTelemetry(&counters->pieces, 1);
+    atomic_store_explicit(&counters->stackHeight, stackHeight, memory_order_relaxed);
+    if (stackHeight > atomic_load_explicit(&counters->maxStackHeight, memory_order_relaxed))
+        atomic_store_explicit(&counters->maxStackHeight, stackHeight, memory_order_relaxed);
+}
+
+static inline void CountTelemetryLines(int board, unsigned int lines, unsigned int stackHeight)
+{
+    AddTelemetry(&telemetryCounters.board[board].lines, lines);
+    atomic_store_explicit(&telemetryCounters.board[board].stackHeight, stackHeight, memory_order_relaxed);
+}
+
+static inline void CountTelemetryRotation(int board)
+{
+    AddTelemetry(&telemetryCounters.board[board].rotations, 1);
+}
+
+static inline void StartTelemetryGame(int board)
+{
+    atomic_store_explicit(&telemetryCounters.board[board].stackHeight, 0, memory_order_relaxed);
+    atomic_store_explicit(&telemetryCounters.board[board].maxStackHeight, 0, memory_order_relaxed);
+}
+
+static inline void CountTelemetryGame(int board)
+{
+    AddTelemetry(&telemetryCounters.board[board].games, 1);
+}
+
+// Frame to frame time, paused boards (bit per board) add it to their pause time
+void CountTelemetryFrame(double frameTime, unsigned int pausedBoards);
+
+#endif // TELEMETRY_H
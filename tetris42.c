@@ -14,6 +14,20 @@
 ********************************************************************************************/
 
 #include "raylib.h"
+#include "tetris42.h"
+#include "pieces.h"
+#include "zobrist.h"
+#include "hint.h"
+#include "layout.h"
+#include "render.h"
+#include "hud.h"
+#include "screen.h"
+#include "export.h"
+#include "spectator.h"
+#include "snapshot.h"
+#include "telemetry.h"
+#include "pacing.h"
+#include "stress.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -28,23 +42,58 @@
 //----------------------------------------------------------------------------------
 // Some Defines
 //----------------------------------------------------------------------------------
-// #define SQUARE_SIZE             20
-
-#define GRID_HORIZONTAL_SIZE    12
-#define GRID_VERTICAL_SIZE      20
+#define NAME_SIZE               20
 
-#define LATERAL_SPEED           10
-#define TURNING_SPEED           12
-#define FAST_FALL_AWAIT_COUNTER 30
+// Internal resolution when not given, the window is fitted to the monitor with this aspect
+#define DEFAULT_SCREEN_WIDTH    1920
+#define DEFAULT_SCREEN_HEIGHT   1080
+#define HINT_CACHE_SIZE         16      // Megabytes of searched positions
 
-#define FADING_TIME             33
+#define SNAPSHOT_FILE           "tetris42.snapshot"
+#define MATCH_VERSION           1       // Bump with every change of MatchState
 
-#define NAME_SIZE               20
+// HUD labels besides the ones of every board
+#define PAUSE_LABEL             (HUD_LABELS - 1)
+#define WINNER_LABEL            (HUD_LABELS - 2)
+#define GAME_OVER_LABEL         3       // After the board labels of render.c
 
 //----------------------------------------------------------------------------------
 // Types and Structures Definition
 //----------------------------------------------------------------------------------
-typedef enum GridSquare { EMPTY, MOVING, FULL, BLOCK, FADING } GridSquare;
+// Nothing changes on screen while paused or while every board waits for ENTER
+typedef enum LoopState { LOOP_ACTIVE = 0, LOOP_PAUSED, LOOP_IDLE, LOOP_STATES } LoopState;
+
+// Everything a match needs to go on after a restart, saved at lock events
+typedef struct MatchState {
+    unsigned long long piecesChecksum;  // Piece set the match is played with
+    int players;
+    unsigned int tick;
+    int gravitySpeed;
+    char title[8*NAME_SIZE];
+    char player[4][NAME_SIZE];
+    GridSquare grid[4][GRID_HORIZONTAL_SIZE][GRID_VERTICAL_SIZE];
+    int pieceType[4];
+    int pieceRotation[4];
+    int incomingType[4];
+    int piecePositionX[4];
+    int piecePositionY[4];
+    unsigned long long positionHash[4];
+    unsigned long long randomSeed;
+    unsigned long long randomState[4];
+    bool gameOver[4];
+    bool beginPlay[4];
+    bool pieceActive[4];
+    bool detection[4];
+    bool lineToDelete[4];
+    int level[4];
+    int lines[4];
+    int gravityMovementCounter[4];
+    int lateralMovementCounter[4];
+    int turnMovementCounter[4];
+    int fastFallMovementCounter[4];
+    int fadeLineCounter[4];
+    Color fadingColor[4];
+} MatchState;
 
 //------------------------------------------------------------------------------------
 // Global Variables Declaration
@@ -52,22 +101,54 @@ typedef enum GridSquare { EMPTY, MOVING, FULL, BLOCK, FADING } GridSquare;
 char player [4][NAME_SIZE] = {"FOR ", "FOR ", "FOR ", "FOR "};
 char title [8 * NAME_SIZE] = "Tetris ";
 
-int screenWidth;
-int screenHeight;
+int screenWidth = DEFAULT_SCREEN_WIDTH;        // Internal resolution, all drawing uses it
+int screenHeight = DEFAULT_SCREEN_HEIGHT;
+static ScreenScaling scaling = SCALING_SMOOTH;
 
-static int SQUARE_SIZE;
 int MAX_PLAYERS = 2;
 static int Gr = 0;
-int masterOffsetX = 0;
-int masterOffsetY = 0;
+
+// Board tiles for the current screen size
+static BoardTile tiles[4];
+static int layoutWidth = 0;
+static int layoutHeight = 0;
 
 static bool gameOver [4] = {false, false, false, false};
 static bool pause = false;
+static bool hints = false;          // Outline the best placement of the falling piece
+static bool exportBoards = false;   // Publish board states to shared memory
+static bool spectate = false;       // Write the spectator stream
+static unsigned int tick = 0;       // Frames played
+static bool snapshots = false;      // Save the match at lock events
+static bool lockEvent = false;      // A piece locked this frame
+static unsigned long long piecesChecksum = 0;
+static bool telemetry = false;      // Count events for the telemetry thread
+static bool stress = false;         // Bots play every board
+static bool headless = false;       // Stress run without a window
+static BoardInput input[4] = { 0 }; // Of the current frame
+
+// Time spent in every loop state, to compare power use
+static LoopState loopState = LOOP_ACTIVE;
+static double stateCpuTime[LOOP_STATES] = { 0 };
+static double stateWallTime[LOOP_STATES] = { 0 };
+static clock_t lastCpuTime = 0;
+static double lastWallTime = 0;
 
 // Matrices
 static GridSquare grid [4][GRID_HORIZONTAL_SIZE][GRID_VERTICAL_SIZE];
-static GridSquare piece [4][4][4];
-static GridSquare incomingPiece [4][4][4];
+
+// Pieces are indexes into the piece set tables
+static PieceSet pieceSet;
+static int pieceType [4] = {0, 0, 0, 0};
+static int pieceRotation [4] = {0, 0, 0, 0};
+static int incomingType [4] = {-1, -1, -1, -1};
+
+// Zobrist hash of locked squares, active piece and incoming piece, updated with every change
+static unsigned long long positionHash [4] = {0, 0, 0, 0};
+
+// Piece sequence of every board, saved with the match so it goes on the same after a restart
+static unsigned long long randomSeed = 0;
+static unsigned long long randomState [4] = {0, 0, 0, 0};
 
 // Theese variables keep track of the active piece position
 static int piecePositionX[4] = {0, 0, 0, 0};
@@ -102,9 +183,13 @@ static int gravitySpeed = 30;
 //------------------------------------------------------------------------------------
 static void InitGame(void);         // Initialize game
 static void UpdateGame(void);       // Update game (one frame)
-static void DrawGame(Color C1, Color C2, Color C3);         // Draw game (one frame)
+static void DrawGame(BoardTile tile, Color C1, Color C2, Color C3);    // Draw game (one frame)
 static void UnloadGame(void);       // Unload game
 static void UpdateDrawFrame(void);  // Update and Draw (one frame)
+static void UpdateFrame(void);      // Update every board (one frame)
+static void DrawFrame(void);        // Draw every board (one frame)
+static void UpdateLoopState(void);  // Wait for input instead of redrawing when idle
+static void ReportLoopStates(void); // Print CPU time per minute of every state
 
 // Additional module functions
 static bool Createpiece();
@@ -112,28 +197,70 @@ static void GetRandompiece();
 static void ResolveFallingMovement(bool *detection, bool *pieceActive, int Gr);
 static bool ResolveLateralMovement();
 static bool ResolveTurnMovement();
+static void ReadBoardInput(void);
 static void CheckDetection(bool *detection, int Gr);
 static void CheckCompletion(bool *lineToDelete, int Gr);
 static int DeleteCompleteLines();
+static unsigned long long HashGridRows(int first, int last);
+static unsigned long long HashActivePiece(void);
+static void GetGridBoard(Board *board);
+static int GetStackHeight(void);
+static void CaptureBoardState(BoardState *state);
+static int GetBoardRandomValue(int min, int max);
+static void SaveMatch(void);
+static void RestoreMatch(const MatchState *match);
 
 //------------------------------------------------------------------------------------
 // Program main entry point
 //------------------------------------------------------------------------------------
 int main(int argc, char *argv[])
 {
+    const char *piecesFile = NULL;
+    const char *spectatorTarget = NULL;
+    const char *snapshotFile = NULL;
+    const char *telemetryFile = NULL;
+    int metricsPort = 0;
+    float stressMinutes = 0;
+    PacingMode pacing = PACING_CLASSIC;
+    float frameDelay = PACING_AUTO_DELAY;
+    bool resume = false;
+    char *names[4];
+    int nameCount = 0;
+
+    // Options start with "--", the rest are player names
+    for (int a = 1; a < argc; a++)
+    {
+        if ((strcmp(argv[a], "--pieces") == 0) && (a + 1 < argc)) piecesFile = argv[++a];
+        else if (strcmp(argv[a], "--hint") == 0) hints = true;
+        else if (strcmp(argv[a], "--shm") == 0) exportBoards = true;
+        else if ((strcmp(argv[a], "--spectate") == 0) && (a + 1 < argc)) spectatorTarget = argv[++a];
+        else if ((strcmp(argv[a], "--snapshot") == 0) && (a + 1 < argc)) snapshotFile = argv[++a];
+        else if (strcmp(argv[a], "--resume") == 0) resume = true;
+        else if ((strcmp(argv[a], "--telemetry") == 0) && (a + 1 < argc)) telemetryFile = argv[++a];
+        else if ((strcmp(argv[a], "--metrics-port") == 0) && (a + 1 < argc)) metricsPort = atoi(argv[++a]);
+        else if ((strcmp(argv[a], "--stress") == 0) && (a + 1 < argc)) stressMinutes = (float)atof(argv[++a]);
+        else if (strcmp(argv[a], "--headless") == 0) headless = true;
+        else if (strcmp(argv[a], "--low-latency") == 0) pacing = PACING_LOW_LATENCY;
+        else if ((strcmp(argv[a], "--frame-delay") == 0) && (a + 1 < argc)) frameDelay = (float)atof(argv[++a]);
+        else if ((strcmp(argv[a], "--resolution") == 0) && (a + 1 < argc)) sscanf(argv[++a], "%dx%d", &screenWidth, &screenHeight);
+        else if ((strcmp(argv[a], "--scale") == 0) && (a + 1 < argc)) scaling = (strcmp(argv[++a], "integer") == 0)? SCALING_INTEGER : SCALING_SMOOTH;
+        else if (nameCount < 4) names[nameCount++] = argv[a];
+    }
+
 #if defined PLAYERS
     MAX_PLAYERS=PLAYERS;
+    (void)names;
 #else
-    if (argc < 3)
+    if (nameCount < 2)
     {
         MAX_PLAYERS = 1;
     }
     else
     {
-        MAX_PLAYERS = argc - 1;
+        MAX_PLAYERS = nameCount;
         for (int p = 0; p < MAX_PLAYERS; p++)
         {
-            strcat(title, argv[p + 1]);
+            strcat(title, names[p]);
             if (p < MAX_PLAYERS - 1)
             {
                 strcat(title, " vs ");
@@ -142,15 +269,94 @@ int main(int argc, char *argv[])
     }
 #endif // defined PLAYERS
 
-    screenWidth = 1920; // GetMonitorWidth(0); // <-- BUG: Returns always 0
-    screenHeight = screenWidth / 1.7777;
-    if (MAX_PLAYERS > 2)
+    // Piece tables are generated once, before the first piece is drawn
+    if (piecesFile != NULL)
     {
-        SQUARE_SIZE = screenWidth / 80;
+        if (!LoadPieceSet(&pieceSet, piecesFile))
+        {
+            printf("Can not load pieces from %s.\n", piecesFile);
+            return 1;
+        }
     }
-    else
+    else if (!LoadPieceSet(&pieceSet, PIECES_FILE) &&
+             !LoadPieceSet(&pieceSet, TextFormat("%s%s", GetApplicationDirectory(), PIECES_FILE)))
+    {
+        LoadDefaultPieceSet(&pieceSet);
+    }
+
+    InitZobrist();
+
+    // Matches resume only with the same pieces
+    char piecesText[PIECES_TEXT_SIZE];
+    int piecesLength = SavePieceSetToMemory(&pieceSet, piecesText, sizeof(piecesText));
+
+    if (piecesLength < 0)
+    {
+        printf("Piece set definition is too long.\n");
+        return 1;
+    }
+
+    piecesChecksum = GetSnapshotChecksum(piecesText, piecesLength, 0);
+    randomSeed = (unsigned long long)time(NULL) ^ ((unsigned long long)clock() << 32);
+
+    // Players of a resumed match come from the snapshot
+    static MatchState match;
+    clock_t resumeStart = clock();
+
+    if (resume)
+    {
+        if (snapshotFile == NULL) snapshotFile = SNAPSHOT_FILE;
+
+        if (!LoadSnapshot(snapshotFile, MATCH_VERSION, &match, sizeof(MatchState)) || (match.piecesChecksum != piecesChecksum) ||
+            (match.players < 1) || (match.players > 4))
+        {
+            printf("No match to resume in %s with these pieces.\n", snapshotFile);
+            return 1;
+        }
+#if defined PLAYERS
+        if (match.players != MAX_PLAYERS)
+        {
+            printf("Match in %s has %d players.\n", snapshotFile, match.players);
+            return 1;
+        }
+#endif
+        MAX_PLAYERS = match.players;
+    }
+
+#if defined(PLATFORM_WEB)
+    hints = false;      // No search thread in the browser
+    telemetryFile = NULL;
+    metricsPort = 0;
+    stressMinutes = 0;
+    headless = false;
+#else
+    if (hints) hints = InitHints(&pieceSet, HINT_CACHE_SIZE);
+#endif
+
+    if (exportBoards && !InitExport(EXPORT_NAME, MAX_PLAYERS))
+    {
+        printf("Can not export boards to shared memory %s.\n", EXPORT_NAME);
+        exportBoards = false;
+    }
+
+    if (spectatorTarget != NULL)
     {
-        SQUARE_SIZE = screenWidth / 40;
+        spectate = InitSpectator(spectatorTarget, &pieceSet, MAX_PLAYERS);
+        if (!spectate) printf("Can not write the spectator stream to %s.\n", spectatorTarget);
+    }
+
+    if (headless && (stressMinutes <= 0))
+    {
+        printf("Headless runs need --stress <minutes>.\n");
+        return 1;
+    }
+
+    stress = (stressMinutes > 0);
+
+    if ((screenWidth < 64) || (screenHeight < 64))
+    {
+        printf("Resolution %dx%d is too small.\n", screenWidth, screenHeight);
+        return 1;
     }
 
     if (1 == MAX_PLAYERS)
@@ -160,13 +366,13 @@ int main(int argc, char *argv[])
 #ifdef PLAYERS
         snprintf(player[Gr], NAME_SIZE, "FOR PLAYER %d", Gr);
 #else
-        if (argc == 1)
+        if (nameCount == 0)
         {
             strcpy(player[Gr], "");
         }
         else
         {
-            strncat(player[Gr], argv[argc - 1], NAME_SIZE);
+            strncat(player[Gr], names[nameCount - 1], NAME_SIZE);
         }
 #endif
     }
@@ -179,31 +385,106 @@ int main(int argc, char *argv[])
 #ifdef PLAYERS
         sprintf(player[Gr], "FOR PLAYER %d", Gr + 1);
 #else
-        strcat(player[Gr], argv[p + 1]);
+        if (!resume) strcat(player[Gr], names[p]);     // Resumed names come from the snapshot, fewer may be given
 #endif
         }
     }
+
+    if (resume)
+    {
+        RestoreMatch(&match);
+
+        // Search starts over for pieces already falling
+        for (int p = 0; p < 4; p++)
+        {
+            if (!hints || gameOver[p] || !pieceActive[p]) continue;
+
+            Board board;
+            PiecePosition start = { pieceType[p], pieceRotation[p], piecePositionX[p], piecePositionY[p] };
+
+            Gr = p;
+            GetGridBoard(&board);
+            RequestHint(p, &board, start, incomingType[p]);
+        }
+        Gr = (1 == MAX_PLAYERS)? 1 : 0;
+
+        printf("Match resumed from %s at frame %u in %.2f ms.\n", snapshotFile, tick, (double)(clock() - resumeStart)*1000/CLOCKS_PER_SEC);
+    }
+
+    // Names are final once the match is set up or restored, the thread starts with them
+    if ((telemetryFile != NULL) || (metricsPort > 0))
+    {
+        const char *boardNames[4] = { player[0] + 4, player[1] + 4, player[2] + 4, player[3] + 4 };
+
+        telemetry = InitTelemetry(telemetryFile, metricsPort, (1 == MAX_PLAYERS)? 1 : 0, MAX_PLAYERS, boardNames);
+        if (!telemetry) printf("Can not start telemetry to %s, port %d.\n", (telemetryFile != NULL)? telemetryFile : "no file", metricsPort);
+    }
+
+    if ((snapshotFile != NULL) && !(snapshots = OpenSnapshot(snapshotFile, MATCH_VERSION, sizeof(MatchState))))
+    {
+        printf("Can not save snapshots to %s.\n", snapshotFile);
+    }
+
+    // Boards update as fast as they can, nothing is drawn
+    if (headless)
+    {
+        InitStress(&pieceSet, stressMinutes);
+
+        while (!IsStressOver())
+        {
+            BeginStressFrame();
+            UpdateFrame();
+            EndStressFrame();
+        }
+
+        bool passed = ReportStress();
+
+        UnloadGame();
+
+        return passed? 0 : 1;
+    }
+
     SetTraceLogLevel(LOG_ERROR);
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     // Initialization (Note windowTitle is unused on Android)
     InitWindow(screenWidth, screenHeight, title);
+
+    // Monitor size is only known once the window is open, frames are scaled to any window size
+    FitWindowToMonitor(screenWidth, screenHeight);
+    if (!InitScreen(screenWidth, screenHeight, scaling))
+    {
+        printf("Can not create a %dx%d render target.\n", screenWidth, screenHeight);
+        CloseWindow();
+        return 1;
+    }
+    bool passed = true;
 #if defined(PLATFORM_WEB)
     emscripten_set_main_loop(UpdateDrawFrame, 60, 1);
 #else
-    SetTargetFPS(60);
+    InitPacing(pacing, 60, frameDelay);
+    if (stress) InitStress(&pieceSet, stressMinutes);
     //--------------------------------------------------------------------------------------
 
     // Main game loop
-    while (!WindowShouldClose())    // Detect window close button or ESC key
+    while (!WindowShouldClose() && !(stress && IsStressOver()))    // Detect window close button or ESC key
     {
         // Update and Draw
         //----------------------------------------------------------------------------------
+        BeginPacedFrame();
+        if (stress) BeginStressFrame();
         UpdateDrawFrame();
+        if (stress) EndStressFrame();
+        EndPacedFrame();
         //----------------------------------------------------------------------------------
     }
+
+    ReportLoopStates();
+    ReportPacing();
+    if (stress) passed = ReportStress();
 #endif
     char winner[6 * NAME_SIZE] = "THE WINNER";
 
-    if (MAX_PLAYERS > 1)
+    if ((MAX_PLAYERS > 1) && !stress)
     {
         // Descending sort winner(s)
         for (int i = 0; i < MAX_PLAYERS-1; i++)
@@ -246,9 +527,10 @@ int main(int argc, char *argv[])
             }
         }
         printf("%s\n", winner);
-        BeginDrawing();
-        DrawText(winner, GetScreenWidth()/2 - MeasureText(winner, 50)/2, GetScreenHeight()/3 - 50, 50, RED);
-        EndDrawing();
+        BeginScreen();
+        DrawHudTextCentered(WINNER_LABEL, winner, screenWidth/2, screenHeight/3 - 50, 50, RED);
+        EndScreen();
+        EndPacedFrame();
         WaitTime(5.0);
     }
     // De-Initialization
@@ -258,7 +540,7 @@ int main(int argc, char *argv[])
     CloseWindow();        // Close window and OpenGL context
     //--------------------------------------------------------------------------------------
 
-    return 0;
+    return passed? 0 : 1;
 }
 
 //--------------------------------------------------------------------------------------
@@ -303,14 +585,18 @@ void InitGame(void)
         }
     }
 
-    // Initialize incoming piece matrices
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j< 4; j++)
-        {
-            incomingPiece[Gr][i][j] = EMPTY;
-        }
-    }
+    // Initialize incoming piece
+    pieceRotation[Gr] = 0;
+    incomingType[Gr] = -1;
+
+    // Empty grid without pieces hashes to 0
+    positionHash[Gr] = 0;
+
+    // Every game of a board gets its own piece sequence
+    randomSeed += 0x9e3779b97f4a7c15ull;
+    randomState[Gr] = randomSeed ^ ((unsigned long long)Gr << 56);
+
+    if (telemetry) StartTelemetryGame(Gr);
 }
 
 // Update game (one frame)
@@ -318,7 +604,7 @@ void UpdateGame(void)
 {
     if (!gameOver[Gr])
     {
-        if (IsKeyPressed('P')) pause = !pause;
+        if (input[Gr].pausePressed) pause = !pause;
 
         if (!pause)
         {
@@ -340,61 +626,17 @@ void UpdateGame(void)
                     lateralMovementCounter[Gr]++;
                     turnMovementCounter[Gr]++;
 
-                    if (Gr == 1)
-                    {
-                        // We make sure to move if we've pressed the key this frame
-                        if (IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_RIGHT)) lateralMovementCounter[Gr] = LATERAL_SPEED;
-                        if (IsKeyPressed(KEY_UP)) turnMovementCounter[Gr] = TURNING_SPEED;
-
-                        // Fall down
-                        if (IsKeyDown(KEY_DOWN) && (fastFallMovementCounter[Gr] >= FAST_FALL_AWAIT_COUNTER))
-                        {
-                            // We make sure the piece is going to fall this frame
-                            gravityMovementCounter[Gr] += gravitySpeed;
-                        }
-                    }
-
-                    if (Gr == 0)
-                    {
-                        // We make sure to move if we've pressed the key this frame
-                        if (IsKeyPressed(KEY_A) || IsKeyPressed(KEY_D)) lateralMovementCounter[Gr] = LATERAL_SPEED;
-                        if (IsKeyPressed(KEY_W)) turnMovementCounter[Gr] = TURNING_SPEED;
-
-                        // Fall down
-                        if (IsKeyDown(KEY_S) && (fastFallMovementCounter[Gr] >= FAST_FALL_AWAIT_COUNTER))
-                        {
-                            // We make sure the piece is going to fall this frame
-                            gravityMovementCounter[Gr] += gravitySpeed;
-                        }
-                    }
+                    // We make sure to move if we've pressed the key this frame
+                    if (input[Gr].movePressed) lateralMovementCounter[Gr] = LATERAL_SPEED;
+                    if (input[Gr].turnPressed) turnMovementCounter[Gr] = TURNING_SPEED;
 
-                    if (Gr == 2)
+                    // Fall down
+                    if (input[Gr].fastFall && (fastFallMovementCounter[Gr] >= FAST_FALL_AWAIT_COUNTER))
                     {
-                        // We make sure to move if we've pressed the key this frame
-                        if (IsGamepadButtonPressed(0, 8) || IsGamepadButtonPressed(0, 6)) lateralMovementCounter[Gr] = LATERAL_SPEED;
-                        if (IsGamepadButtonPressed(0, 5)) turnMovementCounter[Gr] = TURNING_SPEED;
-
-                        // Fall down
-                        if (IsGamepadButtonDown(0, 7) && (fastFallMovementCounter[Gr] >= FAST_FALL_AWAIT_COUNTER))
-                        {
-                            // We make sure the piece is going to fall this frame
-                            gravityMovementCounter[Gr] += gravitySpeed;
-                        }
+                        // We make sure the piece is going to fall this frame
+                        gravityMovementCounter[Gr] += gravitySpeed;
                     }
 
-                    if (Gr == 3)
-                    {
-                        // We make sure to move if we've pressed the key this frame
-                        if (IsGamepadButtonPressed(1, 8) || IsGamepadButtonPressed(1, 6)) lateralMovementCounter[Gr] = LATERAL_SPEED;
-                        if (IsGamepadButtonPressed(1, 5)) turnMovementCounter[Gr] = TURNING_SPEED;
-
-                        // Fall down
-                        if (IsGamepadButtonDown(1, 7) && (fastFallMovementCounter[Gr] >= FAST_FALL_AWAIT_COUNTER))
-                        {
-                            // We make sure the piece is going to fall this frame
-                            gravityMovementCounter[Gr] += gravitySpeed;
-                        }
-                    }
                     if (gravityMovementCounter[Gr] >= gravitySpeed)
                     {
                         // Basic falling movement
@@ -437,7 +679,8 @@ void UpdateGame(void)
                 }
                 if (gameOver[Gr] == true)
                 {
-                    printf("Player %s reached %d lines.\n", player[Gr]+4, lines[Gr]);
+                    if (!stress) printf("Player %s reached %d lines.\n", player[Gr]+4, lines[Gr]);
+                    if (telemetry) CountTelemetryGame(Gr);
                 }
 
             }
@@ -457,13 +700,14 @@ void UpdateGame(void)
                     lineToDelete[Gr] = false;
 
                     lines[Gr] += deletedLines;
+                    if (telemetry) CountTelemetryLines(Gr, deletedLines, GetStackHeight());
                 }
             }
         }
     }
     else
     {
-        if (IsKeyPressed(KEY_ENTER))
+        if (input[Gr].restartPressed)
         {
             InitGame();
             gameOver[Gr] = false;
@@ -472,114 +716,74 @@ void UpdateGame(void)
 }
 
 // Draw game (one frame)
-void DrawGame(Color C1, Color C2, Color C3)
+void DrawGame(BoardTile tile, Color C1, Color C2, Color C3)
 {
         if (!gameOver[Gr])
         {
-            // Draw gameplay area
-            Vector2 offset;
-            offset.x = screenWidth/2 - (GRID_HORIZONTAL_SIZE*SQUARE_SIZE/2) - 50 + masterOffsetX;
-            offset.y = screenHeight/2 - ((GRID_VERTICAL_SIZE - 1)*SQUARE_SIZE/2) + SQUARE_SIZE*2 + masterOffsetY;
-
-            offset.y -= 2*SQUARE_SIZE;
-
-            int controller = offset.x;
-
-            for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+            BoardView view = { 0 };
+
+            view.id = Gr;
+            view.grid = grid[Gr];
+            view.incoming = (incomingType[Gr] >= 0)? &pieceSet.type[incomingType[Gr]].rotation[0] : NULL;
+            view.boxSize = (pieceSet.maxSize > 4)? pieceSet.maxSize : 4;      // Box fits the largest piece of the set
+            view.name = player[Gr];
+            view.lines = lines[Gr];
+            view.wallColor = C1;
+            view.fullColor = C2;
+            view.movingColor = C3;
+            view.fadingColor = fadingColor[Gr];
+
+            // Outline the best placement found so far, it gets better while the piece falls
+            PiecePosition hint;
+
+            if (hints && pieceActive[Gr] && GetHint(Gr, &hint, NULL))
             {
-                for (int i = 0; i < GRID_HORIZONTAL_SIZE; i++)
-                {
-                    // Draw each square of the grid
-                    if (grid[Gr][i][j] == EMPTY)
-                    {
-                        DrawLine(offset.x, offset.y, offset.x + SQUARE_SIZE, offset.y, C1 );
-                        DrawLine(offset.x, offset.y, offset.x, offset.y + SQUARE_SIZE, C1 );
-                        DrawLine(offset.x + SQUARE_SIZE, offset.y, offset.x + SQUARE_SIZE, offset.y + SQUARE_SIZE, C1 );
-                        DrawLine(offset.x, offset.y + SQUARE_SIZE, offset.x + SQUARE_SIZE, offset.y + SQUARE_SIZE, C1 );
-                        offset.x += SQUARE_SIZE;
-                    }
-                    else if (grid[Gr][i][j] == FULL)
-                    {
-                        DrawRectangle(offset.x, offset.y, SQUARE_SIZE, SQUARE_SIZE, C2);
-                        offset.x += SQUARE_SIZE;
-                    }
-                    else if (grid[Gr][i][j] == MOVING)
-                    {
-                        DrawRectangle(offset.x, offset.y, SQUARE_SIZE, SQUARE_SIZE, C3);
-                        offset.x += SQUARE_SIZE;
-                    }
-                    else if (grid[Gr][i][j] == BLOCK)
-                    {
-                        DrawRectangle(offset.x, offset.y, SQUARE_SIZE, SQUARE_SIZE, C1);
-                        offset.x += SQUARE_SIZE;
-                    }
-                    else if (grid[Gr][i][j] == FADING)
-                    {
-                        DrawRectangle(offset.x, offset.y, SQUARE_SIZE, SQUARE_SIZE, fadingColor[Gr]);
-                        offset.x += SQUARE_SIZE;
-                    }
-                }
-
-                offset.x = controller;
-                offset.y += SQUARE_SIZE;
-            }
-
-            // Draw incoming piece (semi hardcoded)
-            int offsetY = 4;
-            if (MAX_PLAYERS > 2)
-            {
-                offsetY = 15;
-            }
-            offset.x = screenWidth/2 + (GRID_HORIZONTAL_SIZE*SQUARE_SIZE/2) + masterOffsetX;
-            offset.y = offsetY * SQUARE_SIZE + masterOffsetY;
-
-            int controler = offset.x;
-
-            for (int j = 0; j < 4; j++)
-            {
-                for (int i = 0; i < 4; i++)
-                {
-                    if (incomingPiece[Gr][i][j] == EMPTY)
-                    {
-                        DrawLine(offset.x, offset.y, offset.x + SQUARE_SIZE, offset.y, C1 );
-                        DrawLine(offset.x, offset.y, offset.x, offset.y + SQUARE_SIZE, C1 );
-                        DrawLine(offset.x + SQUARE_SIZE, offset.y, offset.x + SQUARE_SIZE, offset.y + SQUARE_SIZE, C1 );
-                        DrawLine(offset.x, offset.y + SQUARE_SIZE, offset.x + SQUARE_SIZE, offset.y + SQUARE_SIZE, C1 );
-                        offset.x += SQUARE_SIZE;
-                    }
-                    else if (incomingPiece[Gr][i][j] == MOVING)
-                    {
-                        DrawRectangle(offset.x, offset.y, SQUARE_SIZE, SQUARE_SIZE, C2);
-                        offset.x += SQUARE_SIZE;
-                    }
-                }
-
-                offset.x = controler;
-                offset.y += SQUARE_SIZE;
+                view.hint = &pieceSet.type[hint.type].rotation[hint.rotation];
+                view.hintX = hint.x;
+                view.hintY = hint.y;
             }
 
-            DrawText(player[Gr], offset.x, offset.y - 6*SQUARE_SIZE, SQUARE_SIZE/2, GRAY);
-            DrawText("INCOMING:", offset.x, offset.y - 5*SQUARE_SIZE, SQUARE_SIZE/2, GRAY);
-            DrawText(TextFormat("LINES:   %04i", lines[Gr]), offset.x, offset.y + 20, SQUARE_SIZE/2, GRAY);
+            DrawBoard(&view, tile);
 
-            if (pause) DrawText("GAME PAUSED", screenWidth/2 - MeasureText("GAME PAUSED", 40)/2, screenHeight/2 - 40, 40, GRAY);
+            if (pause) DrawHudTextCentered(PAUSE_LABEL, "GAME PAUSED", screenWidth/2, screenHeight/2 - 40, 40, GRAY);
         }
-        else DrawText("PRESS [ENTER] TO PLAY AGAIN", GetScreenWidth()/2 - MeasureText("PRESS [ENTER] TO PLAY AGAIN", 20)/2, GetScreenHeight()/2 - 50, 20, GRAY);
+        else
+        {
+            int fontSize = (tile.squareSize < 20)? tile.squareSize : 20;
 
+            DrawHudTextCentered(Gr*HUD_BOARD_LABELS + GAME_OVER_LABEL, "PRESS [ENTER] TO PLAY AGAIN", tile.x + TILE_WIDTH*tile.squareSize/2,
+                                tile.y + TILE_HEIGHT*tile.squareSize/2 - fontSize, fontSize, GRAY);
+        }
 }
 
 // Unload game variables
 void UnloadGame(void)
 {
     // TODO: Unload all dynamic loaded data (textures, sounds, models...)
+    if (hints) UnloadHints();
+    if (exportBoards) UnloadExport();
+    if (spectate) UnloadSpectator();
+    if (snapshots) CloseSnapshot();
+    if (telemetry) UnloadTelemetry();
+    UnloadHud();
+    UnloadScreen();
 }
 
 // Update and Draw (one frame)
 void UpdateDrawFrame(void)
+{
+    UpdateFrame();
+    DrawFrame();
+    UpdateLoopState();
+}
+
+// Update every board (one frame), also headless
+void UpdateFrame(void)
 {
     if (1 == MAX_PLAYERS)
     {
         Gr = 1;
+        ReadBoardInput();
         UpdateGame();
     }
     else
@@ -587,60 +791,135 @@ void UpdateDrawFrame(void)
         for (int p = 0; p < MAX_PLAYERS; p++)
         {
             Gr = p;
+            ReadBoardInput();
             UpdateGame();
         }
         Gr = 0;
     }
 
+    tick++;
+
+    // Saved after the whole frame, so every board is at a frame boundary
+    if (lockEvent && snapshots) SaveMatch();
+    lockEvent = false;
+
+    // Boards are captured in screen order once per frame for overlays and spectators
+
+    if (exportBoards || spectate)
+    {
+        BoardState states[4];
 
-    BeginDrawing();
+        for (int b = 0; b < MAX_PLAYERS; b++)
+        {
+            Gr = (1 == MAX_PLAYERS)? 1 : b;
+            CaptureBoardState(&states[b]);
+            if (exportBoards) PublishBoardState(b, &states[b]);
+        }
+        Gr = 0;
+
+        if (exportBoards) PublishTick(tick);
+        if (spectate) RecordSpectator(states);
+    }
+}
+
+// Draw every board (one frame)
+void DrawFrame(void)
+{
+    BeginScreen();
 
     ClearBackground(RAYWHITE);
 
-    if (2 == MAX_PLAYERS)
+    // Boards are tiled again only when the screen size changes
+    if ((layoutWidth != screenWidth) || (layoutHeight != screenHeight))
     {
-        masterOffsetX = -580;
-        DrawGame(SKYBLUE, BLUE, DARKBLUE);
-        Gr++;
-        masterOffsetX = 400;
+        int squareSize = LayoutBoards(MAX_PLAYERS, screenWidth, screenHeight, tiles);
+
+        layoutWidth = screenWidth;
+        layoutHeight = screenHeight;
+
+        // Glyphs are baked once for every HUD text size
+        UnloadHud();
+        LoadHudFont((tiles[0].detail == DETAIL_FULL)? squareSize/2 : squareSize);
+        LoadHudFont((squareSize < 20)? squareSize : 20);
+        LoadHudFont(40);
+        LoadHudFont(50);
     }
-    else if (2 < MAX_PLAYERS)
+
+    Color colors[4][3] = {
+        { SKYBLUE, BLUE, DARKBLUE },
+        { PURPLE, VIOLET, DARKPURPLE },
+        { GREEN, LIME, DARKGREEN },
+        { BEIGE, BROWN, DARKBROWN }
+    };
+
+    // Single player plays on the second board
+    for (int t = 0; t < MAX_PLAYERS; t++)
     {
-        masterOffsetY = -255;
-        masterOffsetX = -580;
-        DrawGame(SKYBLUE, BLUE, DARKBLUE);
-        Gr++;
-        masterOffsetX = 400;
+        Gr = (1 == MAX_PLAYERS)? 1 : t;
+        DrawGame(tiles[t], colors[Gr][0], colors[Gr][1], colors[Gr][2]);
     }
+    Gr = 0;
 
-    DrawGame(PURPLE, VIOLET, DARKPURPLE);
+    //     DrawGame(LIGHTGRAY, GRAY, DARKGRAY);
 
-    if (2 < MAX_PLAYERS)
+    EndScreen();
+}
+
+// Wait for input instead of redrawing when idle, time of every frame counts for the state it ran in
+void UpdateLoopState(void)
+{
+    clock_t cpuTime = clock();
+    double wallTime = GetTime();
+
+    if (lastCpuTime != 0)
     {
-        Gr++;
-        masterOffsetY = 246;
-        if (3 == MAX_PLAYERS)
-        {
-            masterOffsetX = 0;
-        }
-        else
-        {
-            masterOffsetX = -580;
-        }
-        DrawGame(GREEN, LIME, DARKGREEN);
-        if (4 == MAX_PLAYERS)
+        stateCpuTime[loopState] += (double)(cpuTime - lastCpuTime)/CLOCKS_PER_SEC;
+        stateWallTime[loopState] += wallTime - lastWallTime;
+
+        // Boards still playing count the frame as pause time
+        if (telemetry)
         {
-            Gr++;
-            masterOffsetX = 400;
-            DrawGame(BEIGE, BROWN, DARKBROWN);
+            unsigned int pausedBoards = 0;
+
+            for (int p = 0; pause && (p < 4); p++)
+            {
+                if (!gameOver[p]) pausedBoards |= 1u << p;
+            }
+
+            CountTelemetryFrame(wallTime - lastWallTime, pausedBoards & (((1 == MAX_PLAYERS)? 0x2u : (1u << MAX_PLAYERS) - 1)));
         }
+    }
 
+    lastCpuTime = cpuTime;
+    lastWallTime = wallTime;
+
+    bool allOver = true;
+
+    for (int p = (1 == MAX_PLAYERS)? 1 : 0; p < ((1 == MAX_PLAYERS)? 2 : MAX_PLAYERS); p++)
+    {
+        if (!gameOver[p]) allOver = false;
     }
 
-    //     DrawGame(LIGHTGRAY, GRAY, DARKGRAY);
+    LoopState state = allOver? LOOP_IDLE : (pause? LOOP_PAUSED : LOOP_ACTIVE);
+
+#if !defined(PLATFORM_WEB)
+    // Polling input sleeps until the next key, mouse or window event
+    if ((state != LOOP_ACTIVE) && (loopState == LOOP_ACTIVE)) EnableEventWaiting();
+    else if ((state == LOOP_ACTIVE) && (loopState != LOOP_ACTIVE)) DisableEventWaiting();
+#endif
 
-    EndDrawing();
+    loopState = state;
+}
 
+// Print CPU time per minute of every state
+void ReportLoopStates(void)
+{
+    static const char *names[LOOP_STATES] = { "active", "paused", "idle" };
+
+    for (int s = 0; s < LOOP_STATES; s++)
+    {
+        if (stateWallTime[s] > 0) printf("CPU time %-6s %6.2f s/min over %.1f s\n", names[s], 60*stateCpuTime[s]/stateWallTime[s], stateWallTime[s]);
+    }
 }
 
 //--------------------------------------------------------------------------------------
@@ -648,9 +927,6 @@ void UpdateDrawFrame(void)
 //--------------------------------------------------------------------------------------
 static bool Createpiece()
 {
-    piecePositionX[Gr] = (int)((GRID_HORIZONTAL_SIZE - 4)/2);
-    piecePositionY[Gr] = 0;
-
     // If the game is starting and you are going to create the first piece, we create an extra one
     if (beginPlay[Gr])
     {
@@ -659,75 +935,47 @@ static bool Createpiece()
     }
 
     // We assign the incoming piece to the actual piece
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j< 4; j++)
-        {
-            piece[Gr][i][j] = incomingPiece[Gr][i][j];
-        }
-    }
+    pieceType[Gr] = incomingType[Gr];
+    pieceRotation[Gr] = 0;
+
+    piecePositionX[Gr] = (GRID_HORIZONTAL_SIZE - pieceSet.type[pieceType[Gr]].size)/2;
+    piecePositionY[Gr] = 0;
 
     // We assign a random piece to the incoming one
     GetRandompiece();
 
-    // Assign the piece to the grid
-    for (int i = piecePositionX[Gr]; i < piecePositionX[Gr] + 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            if (piece[Gr][i - (int)piecePositionX[Gr]][j] == MOVING) grid[Gr][i][j] = MOVING;
-        }
-    }
+    // Assign the piece to the grid, full squares under it are lost
+    const PieceRotation *rotation = &pieceSet.type[pieceType[Gr]].rotation[0];
 
-    return true;
-}
+    positionHash[Gr] ^= HashGridRows(rotation->minY, rotation->maxY);
 
-static void GetRandompiece()
-{
-    int last_piece = 6;
-    int random_waight = lines[Gr] + 223;
-
-    // Depending on nr. of lines completed increase possibilities of receive advanced piece after 100 lines
-    if (GetRandomValue(0, random_waight) > 300)
+    for (int s = 0; s < rotation->squares; s++)
     {
-        last_piece = 21;
+        grid[Gr][piecePositionX[Gr] + rotation->x[s]][rotation->y[s]] = MOVING;
     }
-    int random = GetRandomValue(0, last_piece);
 
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            incomingPiece[Gr][i][j] = EMPTY;
-        }
-    }
+    positionHash[Gr] ^= HashGridRows(rotation->minY, rotation->maxY) ^ HashActivePiece();
 
-    switch (random)
+    // Search starts over for the new piece, in the background, stress bots search right away
+    if (hints || stress)
     {
-        case 0: { incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][2] = MOVING; } break;    //Cube
-        case 1: { incomingPiece[Gr][1][0] = MOVING; incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][2] = MOVING; } break;    //L
-        case 2: { incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][0] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][2][2] = MOVING; } break;    //L inversa
-        case 3: { incomingPiece[Gr][0][1] = MOVING; incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][3][1] = MOVING; } break;    //Recta
-        case 4: { incomingPiece[Gr][1][0] = MOVING; incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][1] = MOVING; } break;    //Creu tallada
-        case 5: { incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][3][2] = MOVING; } break;    //S
-        case 6: { incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][3][1] = MOVING; } break;    //S inversa
-
-        case 7: { incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][3][2] = MOVING; incomingPiece[Gr][0][1] = MOVING; } break;    //S big
-        case 8: { incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][3][1] = MOVING; incomingPiece[Gr][0][2] = MOVING; } break;    //S big inversa
-        case 9: { incomingPiece[Gr][1][0] = MOVING; incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][0][1] = MOVING; } break;    //-L
-        case 10: { incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][0] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][3][1] = MOVING; } break;    //-L inversa
-        case 11: { incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][0] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][3][2] = MOVING; } break;    //T
-        case 12: { incomingPiece[Gr][1][0] = MOVING; incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][3][2] = MOVING;} break;    //L big
-        case 13: { incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][3][2] = MOVING;} break;    //Factory
-        case 14: { incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][2][3] = MOVING;} break;    //Factory inversa
-        case 15: { incomingPiece[Gr][1][0] = MOVING; incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][3] = MOVING; incomingPiece[Gr][1][3] = MOVING; } break;    //L long
-        case 16: { incomingPiece[Gr][1][3] = MOVING; incomingPiece[Gr][2][0] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][2][3] = MOVING; } break;    //L long inversa
-        case 17: { incomingPiece[Gr][1][0] = MOVING; incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; } break;    //I
-        case 18: { incomingPiece[Gr][1][0] = MOVING; incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][2][0] = MOVING; } break;    //U
-        case 19: { incomingPiece[Gr][1][0] = MOVING; incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][0][1] = MOVING; } break;    //+
-        case 20: { incomingPiece[Gr][1][0] = MOVING; incomingPiece[Gr][1][1] = MOVING; incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][1][3] = MOVING; } break;    //f
-        case 21: { incomingPiece[Gr][1][2] = MOVING; incomingPiece[Gr][2][0] = MOVING; incomingPiece[Gr][2][1] = MOVING; incomingPiece[Gr][2][2] = MOVING; incomingPiece[Gr][2][3] = MOVING; } break;    //f inversa
+        Board board;
+        PiecePosition start = { pieceType[Gr], 0, piecePositionX[Gr], 0 };
+
+        GetGridBoard(&board);
+        if (hints) RequestHint(Gr, &board, start, incomingType[Gr]);
+        if (stress) PlanStressPiece(Gr, &board, start, incomingType[Gr]);
     }
+
+    return true;
+}
+
+static void GetRandompiece()
+{
+    // Depending on nr. of lines completed the later tiers of the piece set increase possibilities of receive advanced piece
+    if (incomingType[Gr] >= 0) positionHash[Gr] ^= HashQueue(0, incomingType[Gr]);
+    incomingType[Gr] = GetRandomPieceType(&pieceSet, lines[Gr], GetBoardRandomValue);
+    positionHash[Gr] ^= HashQueue(0, incomingType[Gr]);
 }
 
 static void ResolveFallingMovement(bool *detection, bool *pieceActive, int Gr)
@@ -735,6 +983,12 @@ static void ResolveFallingMovement(bool *detection, bool *pieceActive, int Gr)
     // If we finished moving this piece, we stop it
     if (*(detection + Gr))
     {
+        const PieceRotation *rotation = &pieceSet.type[pieceType[Gr]].rotation[pieceRotation[Gr]];
+        int top = piecePositionY[Gr] + rotation->minY;
+        int bottom = piecePositionY[Gr] + rotation->maxY;
+
+        positionHash[Gr] ^= HashGridRows(top, bottom) ^ HashActivePiece();
+
         for (int j = GRID_VERTICAL_SIZE - 2; j >= 0; j--)
         {
             for (int i = 1; i < GRID_HORIZONTAL_SIZE - 1; i++)
@@ -747,6 +1001,11 @@ static void ResolveFallingMovement(bool *detection, bool *pieceActive, int Gr)
                 }
             }
         }
+
+        lockEvent = true;
+        if (telemetry) CountTelemetryPiece(Gr, GetStackHeight());
+
+        positionHash[Gr] ^= HashGridRows(top, bottom);
     }
     else    // We move down the piece
     {
@@ -762,7 +1021,9 @@ static void ResolveFallingMovement(bool *detection, bool *pieceActive, int Gr)
             }
         }
 
+        positionHash[Gr] ^= HashActivePiece();
         piecePositionY[Gr]++;
+        positionHash[Gr] ^= HashActivePiece();
     }
 }
 
@@ -771,11 +1032,7 @@ static bool ResolveLateralMovement()
     bool collision = false;
 
     // Piece movement
-    if ((IsKeyDown(KEY_LEFT) && Gr == 1)
-        || (IsKeyDown(KEY_A) && Gr == 0)
-        || (IsGamepadButtonPressed(0, 8) && Gr == 2)
-        || (IsGamepadButtonPressed(1, 8) && Gr == 3)
-    ) // Move left
+    if (input[Gr].left) // Move left
     {
         // Check if is possible to move to left
         for (int j = GRID_VERTICAL_SIZE - 2; j >= 0; j--)
@@ -806,14 +1063,13 @@ static bool ResolveLateralMovement()
                 }
             }
 
+            // Position still moves in the frame the piece locked, with nothing to move
+            if (pieceActive[Gr]) positionHash[Gr] ^= HashActivePiece();
             piecePositionX[Gr]--;
+            if (pieceActive[Gr]) positionHash[Gr] ^= HashActivePiece();
         }
     }
-    else if ((IsKeyDown(KEY_RIGHT) && Gr == 1)
-            || (IsKeyDown(KEY_D) && Gr == 0)
-            || (IsGamepadButtonPressed(0, 6) && Gr == 2)
-            || (IsGamepadButtonPressed(1, 6) && Gr == 3)
-    )  // Move right
+    else if (input[Gr].right)  // Move right
     {
         // Check if is possible to move to right
         for (int j = GRID_VERTICAL_SIZE - 2; j >= 0; j--)
@@ -848,7 +1104,9 @@ static bool ResolveLateralMovement()
                 }
             }
 
+            if (pieceActive[Gr]) positionHash[Gr] ^= HashActivePiece();
             piecePositionX[Gr]++;
+            if (pieceActive[Gr]) positionHash[Gr] ^= HashActivePiece();
         }
     }
 
@@ -858,105 +1116,28 @@ static bool ResolveLateralMovement()
 static bool ResolveTurnMovement()
 {
     // Input for turning the piece
-    if ( (IsKeyDown(KEY_UP) && Gr == 1)
-       || (IsKeyDown(KEY_W) && Gr == 0)
-       || (IsGamepadButtonPressed(0, 5) && Gr == 2)
-       || (IsGamepadButtonPressed(1, 5) && Gr == 3)
-    )
+    if (input[Gr].turn)
     {
-        GridSquare aux;
+        const PieceType *type = &pieceSet.type[pieceType[Gr]];
+        int turn = (pieceRotation[Gr] + 1)%PIECE_ROTATIONS;
         bool checker = false;
 
-        // Check all turning possibilities
-        if ((grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr]] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr]][piecePositionY[Gr]] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr]][piecePositionY[Gr]] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr] + 3] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr]] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr]] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr]][piecePositionY[Gr] + 3] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr] + 3] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr] + 3] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr]][piecePositionY[Gr]] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr]][piecePositionY[Gr] + 3] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr]][piecePositionY[Gr] + 3] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr]] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr]][piecePositionY[Gr] + 2] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr]][piecePositionY[Gr] + 2] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr] + 1] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr]] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr]] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr] + 3] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr] + 1] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr] + 1] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr]][piecePositionY[Gr] + 2] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr] + 3] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr] + 3] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr]] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr]][piecePositionY[Gr] + 1] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr]][piecePositionY[Gr] + 1] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr] + 2] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr]] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr]] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr] + 3] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr] + 2] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 3][piecePositionY[Gr] + 2] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr]][piecePositionY[Gr] + 1] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr] + 3] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr] + 3] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr] + 1] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr] + 2] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr] + 2] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr] + 1] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr] + 1] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr] + 1] != MOVING)) checker = true;
-
-        if ((grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr] + 2] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr] + 1] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr] + 1] != MOVING)) checker = true;
+        // Check all squares of the turned piece, it can only turn into empty or moving squares
+        for (int s = 0; s < type->rotation[turn].squares; s++)
+        {
+            int i = piecePositionX[Gr] + type->rotation[turn].x[s];
+            int j = piecePositionY[Gr] + type->rotation[turn].y[s];
 
-        if ((grid[Gr][piecePositionX[Gr] + 1][piecePositionY[Gr] + 2] == MOVING) &&
-            (grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr] + 2] != EMPTY) &&
-            (grid[Gr][piecePositionX[Gr] + 2][piecePositionY[Gr] + 2] != MOVING)) checker = true;
+            if ((i < 0) || (i >= GRID_HORIZONTAL_SIZE) || (j >= GRID_VERTICAL_SIZE) ||
+                ((grid[Gr][i][j] != EMPTY) && (grid[Gr][i][j] != MOVING))) checker = true;
+        }
 
         if (!checker)
         {
-            aux = piece[Gr][0][0];
-            piece[Gr][0][0] = piece[Gr][3][0];
-            piece[Gr][3][0] = piece[Gr][3][3];
-            piece[Gr][3][3] = piece[Gr][0][3];
-            piece[Gr][0][3] = aux;
-
-            aux = piece[Gr][1][0];
-            piece[Gr][1][0] = piece[Gr][3][1];
-            piece[Gr][3][1] = piece[Gr][2][3];
-            piece[Gr][2][3] = piece[Gr][0][2];
-            piece[Gr][0][2] = aux;
-
-            aux = piece[Gr][2][0];
-            piece[Gr][2][0] = piece[Gr][3][2];
-            piece[Gr][3][2] = piece[Gr][1][3];
-            piece[Gr][1][3] = piece[Gr][0][1];
-            piece[Gr][0][1] = aux;
-
-            aux = piece[Gr][1][1];
-            piece[Gr][1][1] = piece[Gr][2][1];
-            piece[Gr][2][1] = piece[Gr][2][2];
-            piece[Gr][2][2] = piece[Gr][1][2];
-            piece[Gr][1][2] = aux;
+            if (pieceActive[Gr]) positionHash[Gr] ^= HashActivePiece();
+            pieceRotation[Gr] = turn;
+            if (pieceActive[Gr]) positionHash[Gr] ^= HashActivePiece();
+            if (telemetry) CountTelemetryRotation(Gr);
         }
 
         for (int j = GRID_VERTICAL_SIZE - 2; j >= 0; j--)
@@ -970,23 +1151,73 @@ static bool ResolveTurnMovement()
             }
         }
 
-        for (int i = piecePositionX[Gr]; i < piecePositionX[Gr] + 4; i++)
+        const PieceRotation *rotation = &type->rotation[pieceRotation[Gr]];
+        int top = piecePositionY[Gr] + rotation->minY;
+        int bottom = piecePositionY[Gr] + rotation->maxY;
+
+        // In the frame the piece locked this stamps over its own full squares
+        positionHash[Gr] ^= HashGridRows(top, bottom);
+
+        // Squares of a piece that left the grid are not stamped
+        for (int s = 0; s < rotation->squares; s++)
         {
-            for (int j = piecePositionY[Gr]; j < piecePositionY[Gr] + 4; j++)
-            {
-                if (piece[Gr][i - piecePositionX[Gr]][j - piecePositionY[Gr]] == MOVING)
-                {
-                    grid[Gr][i][j] = MOVING;
-                }
-            }
+            int i = piecePositionX[Gr] + rotation->x[s];
+            int j = piecePositionY[Gr] + rotation->y[s];
+
+            if ((i >= 0) && (i < GRID_HORIZONTAL_SIZE) && (j >= 0) && (j < GRID_VERTICAL_SIZE)) grid[Gr][i][j] = MOVING;
         }
 
+        positionHash[Gr] ^= HashGridRows(top, bottom);
+
         return true;
     }
 
     return false;
 }
 
+// Keys of the first two boards and gamepads of the others, or the stress bot, once per frame
+static void ReadBoardInput(void)
+{
+    BoardInput *board = &input[Gr];
+
+    if (stress)
+    {
+        PiecePosition piece = { pieceType[Gr], pieceRotation[Gr], piecePositionX[Gr], piecePositionY[Gr] };
+
+        GetStressInput(Gr, piece, pieceActive[Gr], gameOver[Gr], board);
+        return;
+    }
+
+    board->pausePressed = IsKeyPressed('P');
+    board->restartPressed = IsKeyPressed(KEY_ENTER);
+
+    if (Gr < 2)
+    {
+        int left = (Gr == 0)? KEY_A : KEY_LEFT;
+        int right = (Gr == 0)? KEY_D : KEY_RIGHT;
+        int turn = (Gr == 0)? KEY_W : KEY_UP;
+
+        board->movePressed = IsKeyPressed(left) || IsKeyPressed(right);
+        board->turnPressed = IsKeyPressed(turn);
+        board->left = IsKeyDown(left);
+        board->right = IsKeyDown(right);
+        board->turn = IsKeyDown(turn);
+        board->fastFall = IsKeyDown((Gr == 0)? KEY_S : KEY_DOWN);
+    }
+    else
+    {
+        // Gamepad buttons move and turn only in the frame they went down
+        int gamepad = Gr - 2;
+
+        board->left = IsGamepadButtonPressed(gamepad, 8);
+        board->right = IsGamepadButtonPressed(gamepad, 6);
+        board->turn = IsGamepadButtonPressed(gamepad, 5);
+        board->movePressed = board->left || board->right;
+        board->turnPressed = board->turn;
+        board->fastFall = IsGamepadButtonDown(gamepad, 7);
+    }
+}
+
 static void CheckDetection(bool *detection, int Gr)
 {
     for (int j = GRID_VERTICAL_SIZE - 2; j >= 0; j--)
@@ -1034,6 +1265,9 @@ static int DeleteCompleteLines()
 {
     int deletedLines = 0;
 
+    // Lines above the deleted ones move, so all rows are hashed again
+    positionHash[Gr] ^= HashGridRows(0, GRID_VERTICAL_SIZE - 2);
+
     // Erase the completed line
     for (int j = GRID_VERTICAL_SIZE - 2; j >= 0; j--)
     {
@@ -1065,5 +1299,186 @@ static int DeleteCompleteLines()
         }
     }
 
+    positionHash[Gr] ^= HashGridRows(0, GRID_VERTICAL_SIZE - 2);
+
     return deletedLines;
 }
+
+// Hash locked squares of grid rows, fading lines are still locked squares
+static unsigned long long HashGridRows(int first, int last)
+{
+    unsigned long long hash = 0;
+
+    // Rows of a piece off the grid are left out
+    if (first < 0) first = 0;
+    if (last > GRID_VERTICAL_SIZE - 1) last = GRID_VERTICAL_SIZE - 1;
+
+    for (int j = first; j <= last; j++)
+    {
+        unsigned int row = 0;
+
+        for (int i = 1; i < GRID_HORIZONTAL_SIZE - 1; i++)
+        {
+            if ((grid[Gr][i][j] == FULL) || (grid[Gr][i][j] == FADING)) row |= (1u << i);
+        }
+
+        hash ^= HashRow(j, row);
+    }
+
+    return hash;
+}
+
+static void GetGridBoard(Board *board)
+{
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+    {
+        board->rows[j] = 0;
+
+        for (int i = 0; i < GRID_HORIZONTAL_SIZE; i++)
+        {
+            if ((grid[Gr][i][j] != EMPTY) && (grid[Gr][i][j] != MOVING)) board->rows[j] |= (1u << i);
+        }
+    }
+
+    board->hash = HashBoard(board);
+}
+
+// Rows from the floor up to the highest full square
+static int GetStackHeight(void)
+{
+    for (int j = 0; j < GRID_VERTICAL_SIZE - 1; j++)
+    {
+        for (int i = 1; i < GRID_HORIZONTAL_SIZE - 1; i++)
+        {
+            if (grid[Gr][i][j] == FULL) return GRID_VERTICAL_SIZE - 1 - j;
+        }
+    }
+
+    return 0;
+}
+
+// Plain copy of the board for other processes
+static void CaptureBoardState(BoardState *state)
+{
+    memset(state, 0, sizeof(BoardState));
+
+    state->tick = tick;
+    state->lines = lines[Gr];
+    state->level = level[Gr];
+    state->gameOver = gameOver[Gr];
+    state->paused = pause;
+    state->pieceType = pieceActive[Gr]? pieceType[Gr] : -1;
+    state->pieceRotation = pieceRotation[Gr];
+    state->pieceX = piecePositionX[Gr];
+    state->pieceY = piecePositionY[Gr];
+    state->incomingType = incomingType[Gr];
+    state->hash = positionHash[Gr];
+    snprintf(state->name, BOARD_NAME_SIZE, "%s", player[Gr]);
+
+    if (incomingType[Gr] >= 0)
+    {
+        const PieceType *incoming = &pieceSet.type[incomingType[Gr]];
+
+        state->incomingSize = incoming->size;
+        for (int j = 0; j < incoming->size; j++) state->incomingRows[j] = incoming->rotation[0].rowMask[j];
+    }
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+    {
+        for (int i = 0; i < GRID_HORIZONTAL_SIZE; i++) state->grid[j][i] = grid[Gr][i][j];
+    }
+}
+
+// SplitMix64 step of the board's own state
+static int GetBoardRandomValue(int min, int max)
+{
+    if (max < min)
+    {
+        int swap = max;
+        max = min;
+        min = swap;
+    }
+
+    unsigned long long z = (randomState[Gr] += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+    z ^= z >> 31;
+
+    return min + (int)(z%((unsigned long long)max - min + 1));
+}
+
+static void SaveMatch(void)
+{
+    static MatchState match;
+
+    memset(&match, 0, sizeof(MatchState));
+    match.piecesChecksum = piecesChecksum;
+    match.players = MAX_PLAYERS;
+    match.tick = tick;
+    match.gravitySpeed = gravitySpeed;
+    match.randomSeed = randomSeed;
+    memcpy(match.title, title, sizeof(title));
+    memcpy(match.player, player, sizeof(player));
+    memcpy(match.grid, grid, sizeof(grid));
+    memcpy(match.pieceType, pieceType, sizeof(pieceType));
+    memcpy(match.pieceRotation, pieceRotation, sizeof(pieceRotation));
+    memcpy(match.incomingType, incomingType, sizeof(incomingType));
+    memcpy(match.piecePositionX, piecePositionX, sizeof(piecePositionX));
+    memcpy(match.piecePositionY, piecePositionY, sizeof(piecePositionY));
+    memcpy(match.positionHash, positionHash, sizeof(positionHash));
+    memcpy(match.randomState, randomState, sizeof(randomState));
+    memcpy(match.gameOver, gameOver, sizeof(gameOver));
+    memcpy(match.beginPlay, beginPlay, sizeof(beginPlay));
+    memcpy(match.pieceActive, pieceActive, sizeof(pieceActive));
+    memcpy(match.detection, detection, sizeof(detection));
+    memcpy(match.lineToDelete, lineToDelete, sizeof(lineToDelete));
+    memcpy(match.level, level, sizeof(level));
+    memcpy(match.lines, lines, sizeof(lines));
+    memcpy(match.gravityMovementCounter, gravityMovementCounter, sizeof(gravityMovementCounter));
+    memcpy(match.lateralMovementCounter, lateralMovementCounter, sizeof(lateralMovementCounter));
+    memcpy(match.turnMovementCounter, turnMovementCounter, sizeof(turnMovementCounter));
+    memcpy(match.fastFallMovementCounter, fastFallMovementCounter, sizeof(fastFallMovementCounter));
+    memcpy(match.fadeLineCounter, fadeLineCounter, sizeof(fadeLineCounter));
+    memcpy(match.fadingColor, fadingColor, sizeof(fadingColor));
+
+    SaveSnapshot(&match);
+}
+
+// Pieces and players are checked when the snapshot is loaded
+static void RestoreMatch(const MatchState *match)
+{
+    tick = match->tick;
+    gravitySpeed = match->gravitySpeed;
+    randomSeed = match->randomSeed;
+    memcpy(title, match->title, sizeof(title));
+    memcpy(player, match->player, sizeof(player));
+    memcpy(grid, match->grid, sizeof(grid));
+    memcpy(pieceType, match->pieceType, sizeof(pieceType));
+    memcpy(pieceRotation, match->pieceRotation, sizeof(pieceRotation));
+    memcpy(incomingType, match->incomingType, sizeof(incomingType));
+    memcpy(piecePositionX, match->piecePositionX, sizeof(piecePositionX));
+    memcpy(piecePositionY, match->piecePositionY, sizeof(piecePositionY));
+    memcpy(positionHash, match->positionHash, sizeof(positionHash));
+    memcpy(randomState, match->randomState, sizeof(randomState));
+    memcpy(gameOver, match->gameOver, sizeof(gameOver));
+    memcpy(beginPlay, match->beginPlay, sizeof(beginPlay));
+    memcpy(pieceActive, match->pieceActive, sizeof(pieceActive));
+    memcpy(detection, match->detection, sizeof(detection));
+    memcpy(lineToDelete, match->lineToDelete, sizeof(lineToDelete));
+    memcpy(level, match->level, sizeof(level));
+    memcpy(lines, match->lines, sizeof(lines));
+    memcpy(gravityMovementCounter, match->gravityMovementCounter, sizeof(gravityMovementCounter));
+    memcpy(lateralMovementCounter, match->lateralMovementCounter, sizeof(lateralMovementCounter));
+    memcpy(turnMovementCounter, match->turnMovementCounter, sizeof(turnMovementCounter));
+    memcpy(fastFallMovementCounter, match->fastFallMovementCounter, sizeof(fastFallMovementCounter));
+    memcpy(fadeLineCounter, match->fadeLineCounter, sizeof(fadeLineCounter));
+    memcpy(fadingColor, match->fadingColor, sizeof(fadingColor));
+}
+
+static unsigned long long HashActivePiece(void)
+{
+    PiecePosition position = { pieceType[Gr], pieceRotation[Gr], piecePositionX[Gr], piecePositionY[Gr] };
+
+    return HashFallingPiece(position);
+}
@@ -0,0 +1,43 @@
+/*******************************************************************************************
+*
+*   tetris42 - game rules shared by the game and the tools
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef TETRIS42_H
+#define TETRIS42_H
+
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define GRID_HORIZONTAL_SIZE    12
+#define GRID_VERTICAL_SIZE      20
+
+#define LATERAL_SPEED           10
+#define TURNING_SPEED           12
+#define FAST_FALL_AWAIT_COUNTER 30
+
+#define FADING_TIME             33
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef enum GridSquare { EMPTY, MOVING, FULL, BLOCK, FADING } GridSquare;
+
+// Controls of a board in one frame, read from its keys or gamepad or given by a bot
+typedef struct BoardInput {
+    bool movePressed;                   // Left or right went down, moves in this frame
+    bool turnPressed;                   // Turns in this frame
+    bool left;                          // Held keys, gamepad buttons only in the frame they went down
+    bool right;
+    bool turn;
+    bool fastFall;                      // Held
+    bool pausePressed;
+    bool restartPressed;                // After the game is over
+} BoardInput;
+
+#endif // TETRIS42_H
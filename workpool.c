@@ -0,0 +1,230 @@
+/*******************************************************************************************
+*
+*   tetris42 - work-stealing thread pool
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#if defined(__linux__)
+    #define _GNU_SOURCE         // pthread_setaffinity_np()
+#elif !defined(_WIN32)
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "workpool.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+    #include <sched.h>
+#endif
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static void *WorkerThread(void *data);
+static WorkItem *TakeWork(WorkDeque *deque);
+static WorkItem *StealWork(WorkDeque *deque);
+static void Nap(double seconds);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+bool InitWorkPool(WorkPool *pool, int workers, WorkPoll poll, void *data, bool pin)
+{
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if ((workers < 1) || (workers > MAX_WORKERS)) return false;
+
+    pool->workers = workers;
+    pool->poll = poll;
+    pool->data = data;
+    pool->deques = (WorkDeque *)calloc(workers, sizeof(WorkDeque));
+    pool->stats = (WorkerStats *)calloc(workers, sizeof(WorkerStats));
+
+    if ((pool->deques == NULL) || (pool->stats == NULL))
+    {
+        free(pool->deques);
+        free(pool->stats);
+        return false;
+    }
+
+    for (int w = 0; w < workers; w++)
+    {
+        pool->deques[w].pool = pool;
+        pool->deques[w].owner = w;
+        atomic_init(&pool->deques[w].top, 0);
+        atomic_init(&pool->deques[w].bottom, 0);
+        atomic_init(&pool->stats[w].cpu, (pin && (cores > 0))? w%cores : -1);
+    }
+
+    atomic_store(&pool->running, true);
+
+    for (int w = 0; w < workers; w++)
+    {
+        if (pthread_create(&pool->threads[w], NULL, WorkerThread, &pool->deques[w]) != 0)
+        {
+            pool->workers = w;
+            UnloadWorkPool(pool);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Chase-Lev push, the new bottom publishes the item
+bool PushWork(WorkPool *pool, int worker, WorkItem *item)
+{
+    WorkDeque *deque = &pool->deques[worker];
+    long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+    if (bottom - top >= WORK_DEQUE_SIZE) return false;
+
+    atomic_store_explicit(&deque->items[bottom & (WORK_DEQUE_SIZE - 1)], item, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+
+    return true;
+}
+
+void UnloadWorkPool(WorkPool *pool)
+{
+    atomic_store(&pool->running, false);
+
+    for (int w = 0; w < pool->workers; w++) pthread_join(pool->threads[w], NULL);
+
+    free(pool->deques);
+    free(pool->stats);
+    pool->deques = NULL;
+    pool->stats = NULL;
+}
+
+double GetWorkTime(void)
+{
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return time.tv_sec + time.tv_nsec/1e9;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static void *WorkerThread(void *data)
+{
+    WorkDeque *deque = (WorkDeque *)data;
+    WorkPool *pool = deque->pool;
+    int worker = deque->owner;
+    WorkerStats *stats = &pool->stats[worker];
+    int victim = worker;
+
+#if defined(__linux__)
+    int cpu = atomic_load(&stats->cpu);
+
+    if (cpu >= 0)
+    {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) atomic_store(&stats->cpu, -1);
+    }
+#else
+    atomic_store(&stats->cpu, -1);
+#endif
+
+    while (atomic_load_explicit(&pool->running, memory_order_relaxed))
+    {
+        WorkItem *item = TakeWork(deque);
+        double wait = 0;
+
+        if (item == NULL)
+        {
+            wait = pool->poll(pool, worker);
+            item = TakeWork(deque);
+        }
+
+        // Victims in turn, so thieves spread over the busy workers
+        for (int v = 1; (item == NULL) && (v < pool->workers); v++)
+        {
+            victim = (victim + 1)%pool->workers;
+            if (victim == worker) victim = (victim + 1)%pool->workers;
+
+            item = StealWork(&pool->deques[victim]);
+            if (item != NULL) atomic_store_explicit(&stats->steals, atomic_load_explicit(&stats->steals, memory_order_relaxed) + 1, memory_order_relaxed);
+        }
+
+        if (item == NULL)
+        {
+            Nap((wait < WORK_IDLE_NAP)? wait : WORK_IDLE_NAP);
+            continue;
+        }
+
+        double start = GetWorkTime();
+
+        item->run(item, worker);
+
+        unsigned long long busyTime = (unsigned long long)((GetWorkTime() - start)*1e9);
+
+        atomic_store_explicit(&stats->busyTime, atomic_load_explicit(&stats->busyTime, memory_order_relaxed) + busyTime, memory_order_relaxed);
+        atomic_store_explicit(&stats->items, atomic_load_explicit(&stats->items, memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+// Chase-Lev take, races a thief only for the last item
+static WorkItem *TakeWork(WorkDeque *deque)
+{
+    long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    WorkItem *item = NULL;
+
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    long long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top <= bottom)
+    {
+        item = atomic_load_explicit(&deque->items[bottom & (WORK_DEQUE_SIZE - 1)], memory_order_relaxed);
+
+        if (top == bottom)
+        {
+            if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) item = NULL;
+            atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        }
+    }
+    else atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+
+    return item;
+}
+
+// Chase-Lev steal, NULL when empty or another thief won
+static WorkItem *StealWork(WorkDeque *deque)
+{
+    long long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+    atomic_thread_fence(memory_order_seq_cst);
+
+    long long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (top >= bottom) return NULL;
+
+    WorkItem *item = atomic_load_explicit(&deque->items[top & (WORK_DEQUE_SIZE - 1)], memory_order_relaxed);
+
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) return NULL;
+
+    return item;
+}
+
+static void Nap(double seconds)
+{
+    struct timespec time = { 0, (long)(seconds*1e9) };
+
+    if (seconds > 0) nanosleep(&time, NULL);
+}
@@ -0,0 +1,83 @@
+/*******************************************************************************************
+*
+*   tetris42 - work-stealing thread pool
+*
+*   Every worker owns a Chase-Lev deque: it pushes and takes its own items at the bottom
+*   without locks, idle workers steal from the top of the others with one compare and
+*   swap, so a worker stuck with long items hands the rest to the idle ones. Items are
+*   not created by items here but released by a poll function a worker calls whenever its
+*   deque runs empty, for the server the lobbies whose tick is due.
+*
+*   Workers are pinned one per core on Linux and count the time spent running items, the
+*   utilization of the core they run on.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define WORK_DEQUE_SIZE         4096        // Items a worker holds, a power of two
+#define WORK_IDLE_NAP           50e-6       // Seconds an idle worker sleeps at most before it looks again
+#define MAX_WORKERS             256
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct WorkItem WorkItem;
+typedef struct WorkPool WorkPool;
+
+// Embedded in what it runs for, runs on the worker that took it
+struct WorkItem {
+    void (*run)(WorkItem *item, int worker);
+};
+
+typedef struct WorkDeque {
+    WorkPool *pool;
+    int owner;
+    atomic_llong top;                   // Thieves take here
+    char padding[64];                   // Keeps thieves off the owner's cache line
+    atomic_llong bottom;                // The owner pushes and takes here
+    _Atomic(WorkItem *) items[WORK_DEQUE_SIZE];
+} WorkDeque;
+
+// Written by the worker only
+typedef struct WorkerStats {
+    atomic_ullong busyTime;                 // Nanoseconds running items
+    atomic_ullong items;
+    atomic_ullong steals;                   // Items taken from other workers
+    atomic_int cpu;                         // Pinned to, -1 when not
+    char padding[64];                       // Workers write on their own cache lines
+} WorkerStats;
+
+// Called by a worker with an empty deque: push due items with PushWork() on its own deque,
+// return seconds until the next one is due
+typedef double (*WorkPoll)(WorkPool *pool, int worker);
+
+struct WorkPool {
+    int workers;
+    WorkDeque *deques;
+    WorkerStats *stats;
+    WorkPoll poll;
+    void *data;                             // Of the poll function
+    atomic_bool running;
+    pthread_t threads[MAX_WORKERS];
+};
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+bool InitWorkPool(WorkPool *pool, int workers, WorkPoll poll, void *data, bool pin);  // Starts the workers
+bool PushWork(WorkPool *pool, int worker, WorkItem *item);  // On the worker's own thread, false when its deque is full
+void UnloadWorkPool(WorkPool *pool);                        // Stops the workers after their current items
+double GetWorkTime(void);                                   // Monotonic seconds
+
+#endif // WORKPOOL_H
@@ -0,0 +1,122 @@
+/*******************************************************************************************
+*
+*   tetris42 - Zobrist position hashing and shared position cache
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#include "zobrist.h"
+
+#include <stdlib.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define ZOBRIST_SEED            0x7465747269733432ULL      // "tetris42"
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+unsigned long long zobristRow[GRID_VERTICAL_SIZE][ZOBRIST_ROW_SIZE];
+unsigned long long zobristType[MAX_PIECE_TYPES];
+unsigned long long zobristRotation[PIECE_ROTATIONS];
+unsigned long long zobristX[BOARD_POSITION_WIDTH];
+unsigned long long zobristY[GRID_VERTICAL_SIZE];
+unsigned long long zobristQueue[ZOBRIST_QUEUE_SIZE][MAX_PIECE_TYPES];
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration (local)
+//------------------------------------------------------------------------------------
+static unsigned long long SplitMix64(unsigned long long *state);
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition
+//--------------------------------------------------------------------------------------
+// Generate keys, call once before hashing
+void InitZobrist(void)
+{
+    unsigned long long state = ZOBRIST_SEED;
+
+    for (int j = 0; j < GRID_VERTICAL_SIZE; j++)
+    {
+        // Empty rows add nothing, so an empty grid hashes to 0
+        zobristRow[j][0] = 0;
+        for (int m = 1; m < ZOBRIST_ROW_SIZE; m++) zobristRow[j][m] = SplitMix64(&state);
+    }
+
+    for (int t = 0; t < MAX_PIECE_TYPES; t++) zobristType[t] = SplitMix64(&state);
+    for (int r = 0; r < PIECE_ROTATIONS; r++) zobristRotation[r] = SplitMix64(&state);
+    for (int x = 0; x < BOARD_POSITION_WIDTH; x++) zobristX[x] = SplitMix64(&state);
+    for (int y = 0; y < GRID_VERTICAL_SIZE; y++) zobristY[y] = SplitMix64(&state);
+
+    for (int s = 0; s < ZOBRIST_QUEUE_SIZE; s++)
+    {
+        for (int t = 0; t < MAX_PIECE_TYPES; t++) zobristQueue[s][t] = SplitMix64(&state);
+    }
+}
+
+// Hash all locked rows from scratch
+unsigned long long HashBoard(const Board *board)
+{
+    unsigned long long hash = 0;
+
+    for (int j = 0; j < BOARD_PLAYABLE_ROWS; j++) hash ^= HashRow(j, board->rows[j]);
+
+    return hash;
+}
+
+bool InitPositionCache(PositionCache *cache, size_t megabytes)
+{
+    size_t entries = 1;
+
+    // Largest power of two of 16 byte entries that fits
+    while (entries*2*16 <= megabytes*1024*1024) entries *= 2;
+
+    cache->entries = calloc(entries*2, sizeof(unsigned long long));
+    cache->mask = entries - 1;
+
+    return (cache->entries != NULL);
+}
+
+void UnloadPositionCache(PositionCache *cache)
+{
+    free((void *)cache->entries);
+    cache->entries = NULL;
+    cache->mask = 0;
+}
+
+// Always replace, a torn entry from two threads fails the key check on probe
+void StorePosition(PositionCache *cache, unsigned long long key, unsigned long long data)
+{
+    _Atomic unsigned long long *entry = &cache->entries[(key & cache->mask)*2];
+
+    atomic_store_explicit(&entry[0], key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&entry[1], data, memory_order_relaxed);
+}
+
+bool ProbePosition(PositionCache *cache, unsigned long long key, unsigned long long *data)
+{
+    _Atomic unsigned long long *entry = &cache->entries[(key & cache->mask)*2];
+    unsigned long long check = atomic_load_explicit(&entry[0], memory_order_relaxed);
+    unsigned long long value = atomic_load_explicit(&entry[1], memory_order_relaxed);
+
+    if ((value == 0) || ((check ^ value) != key)) return false;
+
+    *data = value;
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Module Functions Definition (local)
+//--------------------------------------------------------------------------------------
+static unsigned long long SplitMix64(unsigned long long *state)
+{
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
@@ -0,0 +1,92 @@
+/*******************************************************************************************
+*
+*   tetris42 - Zobrist position hashing and shared position cache
+*
+*   A position hash is the XOR of one random key per locked row content, one per active
+*   piece type, turn, column and row, and one per queued piece and queue slot. Every change
+*   (move, lock, line deletion) swaps only the keys it touches. Keys come from a fixed
+*   seed, so the same position hashes the same in every process and every run.
+*
+*   The position cache is a fixed-size table of (key ^ data, data) pairs written with
+*   relaxed atomics: threads share it without locks and torn entries fail the key check.
+*
+*   Copyright (c) 2023 Tadej Panjtar (@tpanj)
+*
+********************************************************************************************/
+
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include "engine.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+//----------------------------------------------------------------------------------
+// Some Defines
+//----------------------------------------------------------------------------------
+#define ZOBRIST_QUEUE_SIZE      16      // Queued pieces with their own keys
+#define ZOBRIST_ROW_SIZE        (1 << (GRID_HORIZONTAL_SIZE - 2))
+
+//----------------------------------------------------------------------------------
+// Types and Structures Definition
+//----------------------------------------------------------------------------------
+typedef struct PositionCache {
+    _Atomic unsigned long long *entries;    // Pairs of key ^ data and data
+    size_t mask;                            // Number of entries minus one
+} PositionCache;
+
+//------------------------------------------------------------------------------------
+// Global Variables Declaration
+//------------------------------------------------------------------------------------
+extern unsigned long long zobristRow[GRID_VERTICAL_SIZE][ZOBRIST_ROW_SIZE];
+extern unsigned long long zobristType[MAX_PIECE_TYPES];
+extern unsigned long long zobristRotation[PIECE_ROTATIONS];
+extern unsigned long long zobristX[BOARD_POSITION_WIDTH];
+extern unsigned long long zobristY[GRID_VERTICAL_SIZE];
+extern unsigned long long zobristQueue[ZOBRIST_QUEUE_SIZE][MAX_PIECE_TYPES];
+
+//------------------------------------------------------------------------------------
+// Module Functions Declaration
+//------------------------------------------------------------------------------------
+void InitZobrist(void);                                     // Generate keys, call once before hashing
+unsigned long long HashBoard(const Board *board);           // Hash all locked rows from scratch
+
+bool InitPositionCache(PositionCache *cache, size_t megabytes);
+void UnloadPositionCache(PositionCache *cache);
+void StorePosition(PositionCache *cache, unsigned long long key, unsigned long long data);  // Data 0 reads as a miss
+bool ProbePosition(PositionCache *cache, unsigned long long key, unsigned long long *data);
+
+// Key of the locked squares of a row, row as a Board row mask, empty rows have key 0
+static inline unsigned long long HashRow(int j, unsigned int row)
+{
+    return zobristRow[j][(row >> 1) & (ZOBRIST_ROW_SIZE - 1)];
+}
+
+// Key of the active piece
+static inline unsigned long long HashPiece(PiecePosition position)
+{
+    return zobristType[position.type] ^ zobristRotation[position.rotation] ^
+           zobristX[position.x + PIECE_MAX_SIZE] ^ zobristY[position.y];
+}
+
+// Key of the game's falling piece, which keeps moving off the grid once all its squares went
+// into a wall, its position wraps around the tables then
+static inline unsigned long long HashFallingPiece(PiecePosition position)
+{
+    int x = (position.x + PIECE_MAX_SIZE)%BOARD_POSITION_WIDTH;
+    int y = position.y%GRID_VERTICAL_SIZE;
+
+    position.x = ((x < 0)? x + BOARD_POSITION_WIDTH : x) - PIECE_MAX_SIZE;
+    position.y = (y < 0)? y + GRID_VERTICAL_SIZE : y;
+
+    return HashPiece(position);
+}
+
+// Key of a queued piece, slot 0 is the incoming piece
+static inline unsigned long long HashQueue(int slot, int type)
+{
+    return zobristQueue[slot][type];
+}
+
+#endif // ZOBRIST_H